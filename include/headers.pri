@@ -80,6 +80,8 @@ HEADER_CLASSES += ../include/TDatabaseContext
 HEADER_CLASSES += ../include/TDatabaseContextThread
 HEADER_CLASSES += ../include/TWebSocketSession
 HEADER_CLASSES += ../include/TRedis
+HEADER_CLASSES += ../include/TRedisPipeline
+HEADER_CLASSES += ../include/TLz4Compressor
 HEADER_CLASSES += ../include/TSqlJoin
 HEADER_CLASSES += ../include/THazardPtrManager
 HEADER_CLASSES += ../include/TAtomic
@@ -178,7 +180,10 @@ HEADER_FILES += tsystembus.h
 HEADER_FILES += tprocessinfo.h
 HEADER_FILES += twebsocketsession.h
 HEADER_FILES += tredis.h
+HEADER_FILES += tredispipeline.h
+HEADER_FILES += tlz4compressor.h
 HEADER_FILES += tsqljoin.h
+HEADER_FILES += tsqlschemacache.h
 HEADER_FILES += thazardptrmanager.h
 HEADER_FILES += tatomic.h
 HEADER_FILES += tatomicptr.h
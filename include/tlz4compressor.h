@@ -0,0 +1 @@
+#include "../src/tlz4compressor.h"
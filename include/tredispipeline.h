@@ -0,0 +1 @@
+#include "../src/tredispipeline.h"
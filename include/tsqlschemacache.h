@@ -0,0 +1 @@
+#include "../src/tsqlschemacache.h"
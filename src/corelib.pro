@@ -112,6 +112,14 @@ HEADERS += tsqldatabase.h
 SOURCES += tsqldatabase.cpp
 HEADERS += tsqldatabasepool.h
 SOURCES += tsqldatabasepool.cpp
+HEADERS += tsqluserconnectioncache.h
+SOURCES += tsqluserconnectioncache.cpp
+HEADERS += tsqlstatementcache.h
+SOURCES += tsqlstatementcache.cpp
+HEADERS += tsqlschemacache.h
+SOURCES += tsqlschemacache.cpp
+HEADERS += tclientcertificatecache.h
+SOURCES += tclientcertificatecache.cpp
 HEADERS += tsqlobject.h
 SOURCES += tsqlobject.cpp
 HEADERS += tsqlormapperiterator.h
@@ -207,6 +215,7 @@ SOURCES += tfilelogger.cpp
 HEADERS += tabstractlogstream.h
 SOURCES += tabstractlogstream.cpp
 HEADERS += tsharedmemorylogstream.h
+HEADERS += tsharedmemorylogring.h
 SOURCES += tsharedmemorylogstream.cpp
 HEADERS += tbasiclogstream.h
 SOURCES += tbasiclogstream.cpp
@@ -246,16 +255,25 @@ HEADERS += tredisdriver.h
 SOURCES += tredisdriver.cpp
 HEADERS += tredis.h
 SOURCES += tredis.cpp
+HEADERS += tredispipeline.h
+HEADERS += tredismultiplexer.h
+SOURCES += tredispipeline.cpp
+SOURCES += tredismultiplexer.cpp
 HEADERS += tfileaiologger.h
 SOURCES += tfileaiologger.cpp
 HEADERS += tfileaiowriter.h
 SOURCES += tfileaiowriter.cpp
+HEADERS += tlogringbuffer.h
 HEADERS += tscheduler.h
 SOURCES += tscheduler.cpp
 HEADERS += tapplicationscheduler.h
 SOURCES += tapplicationscheduler.cpp
 HEADERS += tappsettings.h
 SOURCES += tappsettings.cpp
+HEADERS += tsettingssnapshot.h
+SOURCES += tsettingssnapshot.cpp
+HEADERS += tclock.h
+SOURCES += tclock.cpp
 HEADERS += tabstractwebsocket.h
 SOURCES += tabstractwebsocket.cpp
 HEADERS += twebsocket.h
@@ -314,6 +332,8 @@ HEADERS += treactcomponent.h
 SOURCES += treactcomponent.cpp
 HEADERS += tcache.h
 SOURCES += tcache.cpp
+HEADERS += tlz4compressor.h
+SOURCES += tlz4compressor.cpp
 HEADERS += tcachefactory.h
 SOURCES += tcachefactory.cpp
 HEADERS += tcachestore.h
@@ -324,6 +344,10 @@ HEADERS += tcachemongostore.h
 SOURCES += tcachemongostore.cpp
 HEADERS += tcacheredisstore.h
 SOURCES += tcacheredisstore.cpp
+HEADERS += tcachememorystore.h
+SOURCES += tcachememorystore.cpp
+HEADERS += tcachetieredstore.h
+SOURCES += tcachetieredstore.cpp
 SOURCES += tactioncontroller_qt5.cpp
 HEADERS += toauth2client.h
 SOURCES += toauth2client.cpp
@@ -375,6 +399,8 @@ linux-* {
   SOURCES += tepollwebsocket.cpp
   SOURCES += tprocessinfo_linux.cpp
   SOURCES += tthreadapplicationserver_linux.cpp
+  HEADERS += tcachesharedmemorystore.h
+  SOURCES += tcachesharedmemorystore.cpp
 }
 macx {
   SOURCES += tprocessinfo_macx.cpp
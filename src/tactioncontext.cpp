@@ -9,6 +9,7 @@
 #include "thttpsocket.h"
 #include "tpublisher.h"
 #include "tsessionmanager.h"
+#include "tsettingssnapshot.h"
 #include "tsystemglobal.h"
 #include "turlroute.h"
 #include <QHostAddress>
@@ -25,8 +26,6 @@
 #include <TSessionStore>
 #include <TWebApplication>
 
-#include <openssl/pem.h>
-
 /*!
   \class TActionContext
   \brief The TActionContext class is the base class of contexts for
@@ -61,10 +60,7 @@ void TActionContext::execute(THttpRequest &request, int sid)
     static const qint64 LimitRequestBodyBytes = Tf::appSettings()->value(Tf::LimitRequestBody, 0).toLongLong();
     static const uint ListenPort = Tf::appSettings()->value(Tf::ListenPort).toUInt();
     static const bool EnableCsrfProtectionModuleFlag = Tf::appSettings()->value(Tf::EnableCsrfProtectionModule, true).toBool();
-    static const bool SessionAutoIdRegeneration = Tf::appSettings()->value(Tf::SessionAutoIdRegeneration).toBool();
-    static const QString SessionCookiePath = Tf::appSettings()->value(Tf::SessionCookiePath).toString().trimmed();
-    static const QString SessionCookieDomain = Tf::appSettings()->value(Tf::SessionCookieDomain).toString().trimmed();
-    static const QByteArray SessionCookieSameSite = Tf::appSettings()->value(Tf::SessionCookieSameSite).toByteArray().trimmed();
+    const TSettingsSnapshot &settings = TSettingsSnapshot::current();  // stays the same during the request
 
     THttpResponseHeader responseHeader;
 
@@ -80,7 +76,7 @@ void TActionContext::execute(THttpRequest &request, int sid)
             firstLine += ' ';
             firstLine += reqHeader.path();
             firstLine += QStringLiteral(" HTTP/%1.%2").arg(reqHeader.majorVersion()).arg(reqHeader.minorVersion()).toLatin1();
-            accessLogger.setTimestamp(QDateTime::currentDateTime());
+            accessLogger.setTimestamp(Tf::accessLogTimestamp());
             accessLogger.setRequest(firstLine);
             accessLogger.setRemoteHost((ListenPort > 0) ? originatingClientAddress().toString().toLatin1() : QByteArrayLiteral("(unix)"));
         }
@@ -132,7 +128,7 @@ void TActionContext::execute(THttpRequest &request, int sid)
             // Session
             if (currController->sessionEnabled()) {
                 TSession session;
-                QByteArray sessionId = httpReq->cookie(TSession::sessionName());
+                QByteArray sessionId = httpReq->cookie(settings.session.name);
                 if (!sessionId.isEmpty()) {
                     // Finds a session
                     session = TSessionManager::instance().findSession(sessionId);
@@ -153,10 +149,11 @@ void TActionContext::execute(THttpRequest &request, int sid)
             }
 
             if (currController->sessionEnabled()) {
-                if (SessionAutoIdRegeneration || currController->session().id().isEmpty()) {
+                if (settings.session.autoIdRegeneration || currController->session().id().isEmpty()) {
                     TSessionManager::instance().remove(currController->session().sessionId);  // Removes the old session
                     // Re-generate session ID
                     currController->session().sessionId = TSessionManager::instance().generateId();
+                    currController->session().setModified();  // stored under the new ID
                     tSystemDebug("Re-generate session ID: %s", currController->session().sessionId.data());
                 }
                 // Sets CSRF protection information
@@ -164,54 +161,24 @@ void TActionContext::execute(THttpRequest &request, int sid)
             }
 
             // Database Transaction
+            resetReadRouting();
             if (method != Tf::Options ) {
-            for (int databaseId = 0; databaseId < Tf::app()->sqlDatabaseSettingsCount(); ++databaseId) {
+            for (int databaseId = 0; databaseId < settings.sqlDatabases.count(); ++databaseId) {
                     tSystemDebug("Database Id Transaction: %d", databaseId);
-                    auto dbSettings = Tf::app()->sqlDatabaseSettings(databaseId);
-                    auto commonNameHeader = dbSettings.value("commonName").toByteArray();
-                    if (!commonNameHeader.isEmpty()) {
+                    const auto &dbSettings = settings.sqlDatabases[databaseId];
+                    const auto &commonNameHeader = dbSettings.commonNameHeader;
+                    if (dbSettings.isCertAuthEnabled()) {
     
                         auto commonName = reqHeader.rawHeader(commonNameHeader);
-                        tSystemDebug("commonNameHeader: |%s|", commonNameHeader.toStdString().c_str());
+                        tSystemDebug("commonNameHeader: |%s|", commonNameHeader.data());
                         if (commonName.isEmpty()) {
                             throw ClientErrorException(Tf::BadRequest, __FILE__, __LINE__);
                         }
-                        tSystemDebug("commonName: |%s|", commonName.toStdString().c_str());
-    
-                        QString certPath = QString("%1/%2_crt.pem").arg(
-                                dbSettings.value("certDir").toString(),
-                                commonName.constData());
-                        tSystemDebug("certPath: %s", certPath.toStdString().c_str());
-    
-                        QFileInfo certInfo(certPath);
-    
-                        auto diffTime = QDateTime::currentDateTime().toSecsSinceEpoch() - certInfo.lastModified().toSecsSinceEpoch();
-                        tSystemDebug("Age: %lld - %lld = %lld", QDateTime::currentDateTime().toSecsSinceEpoch(),
-                                certInfo.lastModified().toSecsSinceEpoch(),
-                                diffTime);
-    
-                        if (!certInfo.exists() || diffTime > 60) {
-                            tSystemDebug("Certificate file being generated");
-                            auto userCertificate = QByteArray::fromBase64(
-                                    reqHeader.rawHeader(dbSettings.value("userCertificate").toByteArray()));
-                            if (userCertificate.isEmpty()) {
-                                throw ClientErrorException(Tf::BadRequest, __FILE__, __LINE__);
-                            }
-    
-                            const auto *data = (const unsigned char *) userCertificate.constData();
-                            unsigned int length = userCertificate.length();
-                            X509 *x509 = d2i_X509(nullptr, &data, length);
-    
-                            FILE *fdCert = fopen(certPath.toStdString().c_str(), "w");
-                            if (fdCert == nullptr) {
-                                throw TfException("fopen certificate failed", __FILE__, __LINE__);
-                            } else {
-                                if (PEM_write_X509(fdCert, x509) == 0) {
-                                    throw TfException("PEM_write_X509 failed", __FILE__, __LINE__);
-                                }
-                                fclose(fdCert);
-                            }
-                        }
+                        tSystemDebug("commonName: |%s|", commonName.data());
+
+                        // The certificate is registered and the user connection
+                        // checked out when the action uses the database first
+                        setUserCertificate(databaseId, reqHeader.rawHeader(dbSettings.userCertificateHeader));
                         setTransactionEnabled(currController->transactionEnabled(), databaseId, commonName.constData());
                     }
                     else {
@@ -241,21 +208,15 @@ void TActionContext::execute(THttpRequest &request, int sid)
 
                     // Session store
                     if (currController->sessionEnabled()) {
+                        // An unmodified session is only touched
                         bool stored = TSessionManager::instance().store(currController->session());
                         if (Q_LIKELY(stored)) {
-                            static const int SessionCookieMaxAge = ([]() -> int {
-                                QString maxagestr = Tf::appSettings()->value(Tf::SessionCookieMaxAge).toString().trimmed();
-                                if (!maxagestr.isEmpty()) {
-                                    return maxagestr.toInt();
-                                } else {
-                                    return Tf::appSettings()->value(Tf::SessionLifeTime).toInt();
-                                }
-                            }());
-
-                            currController->addCookie(TSession::sessionName(), currController->session().id(), SessionCookieMaxAge,
-                                SessionCookiePath, SessionCookieDomain, false, true, SessionCookieSameSite);
+                            const auto &ss = settings.session;
+                            currController->addCookie(ss.name, currController->session().id(), ss.cookieMaxAge,
+                                ss.cookiePath, ss.cookieDomain, false, true, ss.cookieSameSite);
 
-                            // Commits a transaction for session
+                            // Commits a transaction for session, if the store
+                            // has used the database
                             commitTransactions();
 
                         } else {
@@ -5,6 +5,7 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclock.h"
 #include "tsessionmanager.h"
 #include "ttextview.h"
 #include <QCryptographicHash>
@@ -163,7 +164,7 @@ bool TActionController::addCookie(const QByteArray &name, const QByteArray &valu
     TCookie cookie(name, value);
     cookie.setMaxAge(maxAge);
     if (maxAge > 0) {
-        cookie.setExpirationDate(QDateTime::currentDateTime().addSecs(maxAge));  // For IE11
+        cookie.setExpirationDate(TClock::currentDateTime().addSecs(maxAge));  // For IE11
     }
     cookie.setPath(path);
     cookie.setDomain(domain);
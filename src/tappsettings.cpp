@@ -57,6 +57,8 @@ public:
         insert(Tf::SessionGcMaxLifeTime, "Session.GcMaxLifeTime");
         insert(Tf::SessionSecret, "Session.Secret");
         insert(Tf::SessionCsrfProtectionKey, "Session.CsrfProtectionKey");
+        insert(Tf::SessionCompressionThreshold, "Session.CompressionThreshold");
+        insert(Tf::SessionCompressionDictionary, "Session.CompressionDictionary");
         insert(Tf::MPMThreadMaxAppServers, "MPM.thread.MaxAppServers");
         insert(Tf::MPMThreadMaxThreadsPerAppServer, "MPM.thread.MaxThreadsPerAppServer");
         insert(Tf::MPMEpollMaxAppServers, "MPM.epoll.MaxAppServers");
@@ -66,6 +68,8 @@ public:
         insert(Tf::AccessLogFilePath, "AccessLog.FilePath");
         insert(Tf::AccessLogLayout, "AccessLog.Layout");
         insert(Tf::AccessLogDateTimeFormat, "AccessLog.DateTimeFormat");
+        insert(Tf::LogWriterBufferSize, "LogWriter.BufferSize");
+        insert(Tf::LogWriterOverflowPolicy, "LogWriter.OverflowPolicy");
         insert(Tf::ActionMailerDeliveryMethod, "ActionMailer.DeliveryMethod");
         insert(Tf::ActionMailerCharacterSet, "ActionMailer.CharacterSet");
         insert(Tf::ActionMailerDelayedDelivery, "ActionMailer.DelayedDelivery");
@@ -84,6 +88,10 @@ public:
         insert(Tf::CacheBackend, "Cache.Backend");
         insert(Tf::CacheGcProbability, "Cache.GcProbability");
         insert(Tf::CacheEnableCompression, "Cache.EnableCompression");
+        insert(Tf::CacheLocalCacheSize, "Cache.LocalCacheSize");
+        insert(Tf::CacheLocalCacheTimeout, "Cache.LocalCacheTimeout");
+        insert(Tf::CacheCompressionThreshold, "Cache.CompressionThreshold");
+        insert(Tf::CacheCompressionHcThreshold, "Cache.CompressionHcThreshold");
     }
 };
 Q_GLOBAL_STATIC(AttributeMap, attributeMap)
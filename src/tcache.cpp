@@ -7,9 +7,64 @@
 
 #include "tcachefactory.h"
 #include "tcachestore.h"
-#include <TAppSettings>
+#include "tclock.h"
+#include "tlz4compressor.h"
+#include "tsettingssnapshot.h"
+#include "tsystemglobal.h"
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QtEndian>
 #include <TCache>
 #include <TWebApplication>
+#include <future>
+
+constexpr int LOCK_TIMEOUT = 10;  // seconds
+constexpr int LOCK_POLLING_INTERVAL = 50;  // msecs
+
+namespace {
+QMutex flightMutex;
+QHash<QByteArray, std::shared_future<QByteArray>> flights;  // computations in progress
+
+
+// Prepends the time until which the value is fresh
+QByteArray pack(const QByteArray &value, qint64 freshUntil)
+{
+    QByteArray data(sizeof(qint64), Qt::Uninitialized);
+    qToBigEndian<qint64>(freshUntil, data.data());
+    return data + value;
+}
+
+
+bool unpack(const QByteArray &data, QByteArray &value, qint64 &freshUntil)
+{
+    if (data.size() < (int)sizeof(qint64)) {
+        return false;
+    }
+    freshUntil = qFromBigEndian<qint64>(data.constData());
+    value = data.mid(sizeof(qint64));
+    return true;
+}
+
+
+TLz4Compressor compressor()
+{
+    const auto &settings = TSettingsSnapshot::current().cache;
+    return TLz4Compressor(settings.compressionThreshold, settings.compressionHcThreshold);
+}
+
+
+void finishFlight(const QByteArray &key, std::promise<QByteArray> &promise, const QByteArray &value)
+{
+    {
+        QMutexLocker locker(&flightMutex);
+        flights.remove(key);
+    }
+    promise.set_value(value);
+}
+
+}  // namespace
 
 /*!
   \class TCache
@@ -18,8 +73,7 @@
 
 TCache::TCache()
 {
-    static int CacheGcProbability = TAppSettings::instance()->value(Tf::CacheGcProbability, 0).toInt();
-    _gcDivisor = CacheGcProbability;
+    _gcDivisor = TSettingsSnapshot::current().cache.gcProbability;
 
     if (Tf::app()->cacheEnabled()) {
         _cache = TCacheFactory::create(Tf::app()->cacheBackend());
@@ -28,6 +82,9 @@ TCache::TCache()
                 tError() << "Failed to open cache. Check the settings of cache.ini.";
                 TCacheFactory::destroy(Tf::app()->cacheBackend(), _cache);
                 _cache = nullptr;
+            } else {
+                // The memory store compresses large values by itself
+                _compression = compressionEnabled() && _cache->dbType() != TCacheStore::Memory;
             }
         }
     } else {
@@ -53,20 +110,91 @@ bool TCache::set(const QByteArray &key, const QByteArray &value, int seconds)
     bool ret = false;
 
     if (_cache) {
-        if (compressionEnabled()) {
-            ret = _cache->set(key, Tf::lz4Compress(value), seconds);
+        if (_compression) {
+            ret = _cache->set(key, compressor().compress(value), seconds);
         } else {
             ret = _cache->set(key, value, seconds);
         }
+        collectGarbage(1);
+    }
+    return ret;
+}
 
-        // GC
-        if (_gcDivisor > 0 && Tf::random(1, _gcDivisor) == 1) {
-            _cache->gc();
+/*!
+  Stores all the items of the \a values in one call to the backend and
+  sets their timeout after a given number of \a seconds.
+ */
+bool TCache::setMulti(const QMap<QByteArray, QByteArray> &values, int seconds)
+{
+    bool ret = false;
+
+    if (_cache) {
+        if (_compression) {
+            QMap<QByteArray, QByteArray> compressed;
+            for (auto it = values.begin(); it != values.end(); ++it) {
+                compressed.insert(it.key(), compressor().compress(it.value()));
+            }
+            ret = _cache->setMulti(compressed, seconds);
+        } else {
+            ret = _cache->setMulti(values, seconds);
         }
+        collectGarbage(values.count());
     }
     return ret;
 }
 
+/*!
+  Returns the values associated with the \a keys in one call to the
+  backend; the keys not found are not contained.
+ */
+QMap<QByteArray, QByteArray> TCache::getMulti(const QByteArrayList &keys)
+{
+    QMap<QByteArray, QByteArray> values;
+
+    if (_cache) {
+        values = _cache->getMulti(keys);
+        if (_compression) {
+            for (auto it = values.begin(); it != values.end(); ++it) {
+                it.value() = compressor().uncompress(it.value());
+            }
+        }
+    }
+    return values;
+}
+
+/*!
+  Removes the items that have the \a keys in one call to the backend.
+ */
+void TCache::removeMulti(const QByteArrayList &keys)
+{
+    if (_cache) {
+        _cache->removeMulti(keys);
+    }
+}
+
+/*!
+  Starts the GC at a rate of once per Cache.GcProbability writes, counted
+  per thread so that a write takes no lock.
+ */
+void TCache::collectGarbage(int writes)
+{
+    static thread_local int countdown = 0;
+
+    if (_gcDivisor <= 0) {
+        return;
+    }
+
+    if (countdown <= 0) {
+        countdown = Tf::random(1, _gcDivisor * 2 - 1);  // _gcDivisor writes on average
+        return;
+    }
+
+    countdown -= writes;
+    if (countdown <= 0) {
+        _cache->gc();
+    }
+}
+
 /*!
   Returns the value associated with the \a key.
  */
@@ -76,13 +204,100 @@ QByteArray TCache::get(const QByteArray &key)
 
     if (_cache) {
         value = _cache->get(key);
-        if (compressionEnabled()) {
-            value = Tf::lz4Uncompress(value);
+        if (_compression) {
+            value = compressor().uncompress(value);
         }
     }
     return value;
 }
 
+/*!
+  Returns the value associated with the \a key, or computes it by calling
+  \a compute and stores it with the timeout of \a seconds if not cached.
+  While a thread computes the value, the other threads of the process
+  asking for the same key wait for its result instead of computing it too.
+
+  If \a staleSeconds is greater than 0, the value is kept for that many
+  seconds beyond the timeout, during which it is returned as is while one
+  thread computes the new value. If \a crossProcessLock is true, only one
+  process computes the value at a time, as far as the backend supports
+  locking (Redis); the others wait for the value or return the stale one.
+
+  The values are stored with a header; read them with getOrCompute() only.
+  The exception thrown by \a compute is thrown to all the waiting threads.
+ */
+QByteArray TCache::getOrCompute(const QByteArray &key, int seconds, const std::function<QByteArray()> &compute, int staleSeconds, bool crossProcessLock)
+{
+    QByteArray value;
+    qint64 freshUntil = 0;
+    bool found = unpack(get(key), value, freshUntil);
+
+    if (found && freshUntil > TClock::currentMSecsSinceEpoch()) {
+        return value;
+    }
+
+    // Joins the computation in progress in this process
+    std::promise<QByteArray> promise;
+    std::shared_future<QByteArray> future;
+    {
+        QMutexLocker locker(&flightMutex);
+        auto it = flights.constFind(key);
+        if (it != flights.constEnd()) {
+            future = it.value();
+        } else {
+            flights.insert(key, promise.get_future().share());
+        }
+    }
+
+    if (future.valid()) {
+        return (found) ? value : future.get();  // stale while revalidating
+    }
+
+    bool locked = false;
+    try {
+        if (crossProcessLock && _cache) {
+            locked = _cache->lock(key, LOCK_TIMEOUT);
+            if (!locked) {
+                if (found) {
+                    // Another process is computing it
+                    finishFlight(key, promise, value);
+                    return value;
+                }
+
+                // Waits for the value of another process
+                for (int i = 0; i < LOCK_TIMEOUT * 1000 / LOCK_POLLING_INTERVAL; ++i) {
+                    QThread::msleep(LOCK_POLLING_INTERVAL);
+                    if (unpack(get(key), value, freshUntil)) {
+                        finishFlight(key, promise, value);
+                        return value;
+                    }
+                }
+                tSystemWarn("Timed out waiting for the cache lock: %s", key.data());
+            }
+        }
+
+        value = compute();
+        freshUntil = TClock::currentMSecsSinceEpoch() + seconds * 1000LL;
+        set(key, pack(value, freshUntil), seconds + qMax(staleSeconds, 0));
+    } catch (...) {
+        if (locked) {
+            _cache->unlock(key);
+        }
+        {
+            QMutexLocker locker(&flightMutex);
+            flights.remove(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    if (locked) {
+        _cache->unlock(key);
+    }
+    finishFlight(key, promise, value);
+    return value;
+}
+
 /*!
   Removes the item that have the \a key from the cache.
  */
@@ -106,6 +321,5 @@ void TCache::clear()
 
 bool TCache::compressionEnabled()
 {
-    static bool compression = Tf::appSettings()->value(Tf::CacheEnableCompression, true).toBool();
-    return compression;
+    return TSettingsSnapshot::current().cache.enableCompression;
 }
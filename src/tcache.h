@@ -1,5 +1,8 @@
 #pragma once
+#include <QByteArrayList>
+#include <QMap>
 #include <TGlobal>
+#include <functional>
 
 class TCacheStore;
 
@@ -11,14 +14,21 @@ public:
 
     bool set(const QByteArray &key, const QByteArray &value, int seconds);
     QByteArray get(const QByteArray &key);
+    QMap<QByteArray, QByteArray> getMulti(const QByteArrayList &keys);
+    bool setMulti(const QMap<QByteArray, QByteArray> &values, int seconds);
+    void removeMulti(const QByteArrayList &keys);
+    QByteArray getOrCompute(const QByteArray &key, int seconds, const std::function<QByteArray()> &compute, int staleSeconds = 0, bool crossProcessLock = false);
     void remove(const QByteArray &key);
     void clear();
 
     static bool compressionEnabled();
 
 private:
+    void collectGarbage(int writes);
+
     TCacheStore *_cache {nullptr};
     int _gcDivisor {0};
+    bool _compression {false};
 
     T_DISABLE_COPY(TCache)
     T_DISABLE_MOVE(TCache)
@@ -1,7 +1,12 @@
 #include "tcachefactory.h"
+#include "tcachememorystore.h"
 #include "tcachemongostore.h"
 #include "tcacheredisstore.h"
 #include "tcachesqlitestore.h"
+#include "tcachetieredstore.h"
+#ifdef Q_OS_LINUX
+#include "tcachesharedmemorystore.h"
+#endif
 #include "tsystemglobal.h"
 #include <QDir>
 #include <TAppSettings>
@@ -10,6 +15,8 @@ namespace {
 QString SQLITE_CACHE_KEY;
 QString MONGO_CACHE_KEY;
 QString REDIS_CACHE_KEY;
+QString MEMORY_CACHE_KEY;
+QString SHAREDMEMORY_CACHE_KEY;
 }
 
 
@@ -20,7 +27,11 @@ QStringList TCacheFactory::keys()
     QStringList ret;
     ret << SQLITE_CACHE_KEY
         << MONGO_CACHE_KEY
-        << REDIS_CACHE_KEY;
+        << REDIS_CACHE_KEY
+        << MEMORY_CACHE_KEY;
+#ifdef Q_OS_LINUX
+    ret << SHAREDMEMORY_CACHE_KEY;
+#endif
     return ret;
 }
 
@@ -37,10 +48,20 @@ TCacheStore *TCacheFactory::create(const QString &key)
         ptr = new TCacheMongoStore;
     } else if (k == REDIS_CACHE_KEY) {
         ptr = new TCacheRedisStore;
+    } else if (k == MEMORY_CACHE_KEY) {
+        ptr = new TCacheMemoryStore;
+#ifdef Q_OS_LINUX
+    } else if (k == SHAREDMEMORY_CACHE_KEY) {
+        ptr = new TCacheSharedMemoryStore;
+#endif
     } else {
         tSystemError("Not found cache store: %s", qPrintable(key));
     }
 
+    // Reads through the cache in the process
+    if (ptr && ptr->dbType() != TCacheStore::Memory && TCacheTieredStore::isEnabled()) {
+        ptr = new TCacheTieredStore(ptr);
+    }
     return ptr;
 }
 
@@ -56,6 +77,8 @@ void TCacheFactory::destroy(const QString &key, TCacheStore *store)
         delete store;
     } else if (k == REDIS_CACHE_KEY) {
         delete store;
+    } else if (k == MEMORY_CACHE_KEY) {
+        delete store;
     } else {
         delete store;
     }
@@ -74,6 +97,12 @@ QMap<QString, QVariant> TCacheFactory::defaultSettings(const QString &key)
         settings = TCacheMongoStore().defaultSettings();
     } else if (k == REDIS_CACHE_KEY) {
         settings = TCacheRedisStore().defaultSettings();
+    } else if (k == MEMORY_CACHE_KEY) {
+        settings = TCacheMemoryStore().defaultSettings();
+#ifdef Q_OS_LINUX
+    } else if (k == SHAREDMEMORY_CACHE_KEY) {
+        settings = TCacheSharedMemoryStore().defaultSettings();
+#endif
     } else {
         // Invalid key
     }
@@ -101,6 +130,10 @@ bool TCacheFactory::loadCacheKeys()
         SQLITE_CACHE_KEY = TCacheSQLiteStore().key().toLower();
         MONGO_CACHE_KEY = TCacheMongoStore().key().toLower();
         REDIS_CACHE_KEY = TCacheRedisStore().key().toLower();
+        MEMORY_CACHE_KEY = TCacheMemoryStore().key().toLower();
+#ifdef Q_OS_LINUX
+        SHAREDMEMORY_CACHE_KEY = TCacheSharedMemoryStore().key().toLower();
+#endif
         return true;
     }();
     return done;
@@ -0,0 +1,410 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tcachememorystore.h"
+#include "tclock.h"
+#include "tsystemglobal.h"
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <TCache>
+#include <TWebApplication>
+#include <list>
+
+/*!
+  \class TCacheMemoryStore
+  \brief The TCacheMemoryStore class stores the items in the memory of the
+  process; all the threads share them.
+
+  The items are distributed over shards, each guarded by its own mutex,
+  so that threads rarely contend. Each shard keeps its items in LRU order
+  within its part of the memory budget (MaxMemorySize in MB). When the
+  budget is exceeded, a new item is admitted only if it has been used
+  more frequently than the LRU victim (TinyLFU), so that one-off items
+  do not flush hot ones. The frequencies are estimated by a count-min
+  sketch that is halved periodically.
+  Values smaller than CompressionThreshold bytes are stored as is.
+*/
+
+namespace {
+
+constexpr int SHARD_COUNT = 64;  // power of 2
+constexpr int ENTRY_OVERHEAD = 64;  // approximate bytes of bookkeeping per item
+
+struct Entry {
+    QByteArray key;
+    QByteArray value;
+    qint64 expire {0};  // msecs of the monotonic clock
+    bool compressed {false};
+
+    qint64 size() const { return key.size() + value.size() + ENTRY_OVERHEAD; }
+};
+
+using EntryList = std::list<Entry>;
+
+
+// Count-min sketch of 4 rows
+class FrequencySketch {
+public:
+    void resize(int capacity)
+    {
+        int width = 64;
+        while (width < capacity) {
+            width <<= 1;
+        }
+        table.fill(0, width * 4);
+        mask = width - 1;
+        sampleSize = qMax(width * 10, 1024);
+        additions = 0;
+    }
+
+    void increment(uint hash)
+    {
+        bool added = false;
+        for (int i = 0; i < 4; ++i) {
+            uchar &counter = table[i * (mask + 1) + index(hash, i)];
+            if (counter < 15) {
+                counter++;
+                added = true;
+            }
+        }
+
+        if (added && ++additions >= sampleSize) {
+            age();
+        }
+    }
+
+    int frequency(uint hash) const
+    {
+        int freq = 15;
+        for (int i = 0; i < 4; ++i) {
+            freq = qMin(freq, (int)table[i * (mask + 1) + index(hash, i)]);
+        }
+        return freq;
+    }
+
+    void clear() { table.fill(0); additions = 0; }
+
+private:
+    int index(uint hash, int row) const
+    {
+        static const uint seeds[] = {0x9E3779B1u, 0x85EBCA77u, 0xC2B2AE3Du, 0x27D4EB2Fu};
+        uint h = (hash ^ (hash >> 16)) * seeds[row];
+        return (h >> 8) & mask;
+    }
+
+    void age()
+    {
+        for (auto &counter : table) {
+            counter >>= 1;
+        }
+        additions /= 2;
+    }
+
+    QVector<uchar> table;
+    uint mask {0};
+    int sampleSize {0};
+    int additions {0};
+};
+
+
+class Shard {
+public:
+    QMutex mutex;
+    EntryList lru;  // most recently used first
+    QHash<QByteArray, EntryList::iterator> index;
+    FrequencySketch sketch;
+    qint64 bytes {0};
+    qint64 capacity {0};
+
+    void erase(QHash<QByteArray, EntryList::iterator>::iterator it)
+    {
+        bytes -= it.value()->size();
+        lru.erase(it.value());
+        index.erase(it);
+    }
+
+    void removeAll()
+    {
+        index.clear();
+        lru.clear();
+        sketch.clear();
+        bytes = 0;
+    }
+};
+
+
+}  // namespace
+
+
+class TCacheMemoryStore::Table {
+public:
+    Shard shards[SHARD_COUNT];
+    int compressionThreshold {-1};  // -1: no compression
+
+    Table(qint64 maxMemorySize, int threshold) :
+        compressionThreshold(threshold)
+    {
+        qint64 capacity = qMax(maxMemorySize / SHARD_COUNT, (qint64)ENTRY_OVERHEAD);
+        for (auto &shard : shards) {
+            shard.capacity = capacity;
+            shard.sketch.resize(qMin(capacity / 256, (qint64)(1 << 20)));  // assumes 256 bytes per item
+        }
+    }
+
+    Shard &shard(uint hash) { return shards[(hash >> 7) & (SHARD_COUNT - 1)]; }
+};
+
+
+TCacheMemoryStore::TCacheMemoryStore(const QByteArray &table) :
+    _name(table)
+{
+}
+
+
+bool TCacheMemoryStore::open()
+{
+    const QVariantMap settings = (Tf::app()) ? Tf::app()->cacheSettings() : QVariantMap();
+    qint64 maxSize = settings.value("MaxMemorySize", 64).toLongLong() * 1024 * 1024;
+    int threshold = TCache::compressionEnabled() ? settings.value("CompressionThreshold", 4096).toInt() : -1;
+    return open(maxSize, threshold);
+}
+
+/*!
+  Opens the table of the store, creating it with the memory budget of
+  \a maxMemorySize bytes on the first call in the process. Values of
+  \a compressionThreshold bytes or more are compressed; -1 disables it.
+ */
+bool TCacheMemoryStore::open(qint64 maxMemorySize, int compressionThreshold)
+{
+    static QMutex mutex;
+    static QMap<QByteArray, Table *> tables;
+
+    if (!_table) {
+        QMutexLocker locker(&mutex);
+        Table *&table = tables[_name];
+        if (!table) {
+            table = new Table(maxMemorySize, compressionThreshold);
+            tSystemDebug("Memory cache created: %s MaxMemorySize:%lld CompressionThreshold:%d", _name.data(), maxMemorySize, compressionThreshold);
+        }
+        _table = table;
+    }
+    return true;
+}
+
+
+void TCacheMemoryStore::close()
+{
+}
+
+
+QByteArray TCacheMemoryStore::get(const QByteArray &key)
+{
+    if (Q_UNLIKELY(!_table)) {
+        return QByteArray();
+    }
+
+    const uint hash = qHash(key);
+    Shard &shard = _table->shard(hash);
+    QByteArray value;
+    bool compressed = false;
+    {
+        QMutexLocker locker(&shard.mutex);
+        shard.sketch.increment(hash);
+
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            return QByteArray();
+        }
+
+        auto entry = it.value();
+        if (entry->expire <= TClock::monotonicMSecs()) {
+            shard.erase(it);
+            return QByteArray();
+        }
+
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+        value = entry->value;  // implicitly shared
+        compressed = entry->compressed;
+    }
+    return (compressed) ? Tf::lz4Uncompress(value) : value;
+}
+
+
+bool TCacheMemoryStore::set(const QByteArray &key, const QByteArray &value, int seconds)
+{
+    if (Q_UNLIKELY(!_table)) {
+        return false;
+    }
+
+    if (seconds <= 0) {
+        remove(key);
+        return false;
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.expire = TClock::monotonicMSecs() + seconds * 1000LL;
+
+    // Compresses outside of the lock
+    if (_table->compressionThreshold >= 0 && value.size() >= _table->compressionThreshold) {
+        entry.value = Tf::lz4Compress(value);
+        entry.compressed = true;
+    } else {
+        entry.value = value;
+    }
+
+    const uint hash = qHash(key);
+    Shard &shard = _table->shard(hash);
+    EntryList evicted;  // destroyed after unlocking
+    QMutexLocker locker(&shard.mutex);
+    shard.sketch.increment(hash);
+
+    auto it = shard.index.find(key);
+    const bool resident = (it != shard.index.end());
+
+    if (entry.size() > shard.capacity) {
+        if (resident) {
+            shard.erase(it);  // not to leave the old value
+        }
+        return false;  // too large
+    }
+
+    // Decides the victims before changing anything, so that a value not
+    // admitted leaves the shard as it was. The new value of a resident
+    // key replaces the old one without admission.
+    const qint64 now = TClock::monotonicMSecs();
+    const int frequency = shard.sketch.frequency(hash);
+    qint64 bytes = shard.bytes - ((resident) ? it.value()->size() : 0);
+    int victims = 0;
+    for (auto victim = shard.lru.end(); bytes + entry.size() > shard.capacity;) {
+        --victim;
+        if (resident && victim == it.value()) {
+            continue;
+        }
+        if (!resident && victim->expire > now && shard.sketch.frequency(qHash(victim->key)) > frequency) {
+            return false;  // not admitted
+        }
+        bytes -= victim->size();
+        victims++;
+    }
+
+    if (resident) {
+        shard.erase(it);
+    }
+    while (victims-- > 0) {
+        auto victim = std::prev(shard.lru.end());
+        shard.bytes -= victim->size();
+        shard.index.remove(victim->key);
+        evicted.splice(evicted.begin(), shard.lru, victim);
+    }
+
+    shard.bytes += entry.size();
+    shard.lru.push_front(std::move(entry));
+    shard.index.insert(key, shard.lru.begin());
+    return true;
+}
+
+
+bool TCacheMemoryStore::remove(const QByteArray &key)
+{
+    if (Q_UNLIKELY(!_table)) {
+        return false;
+    }
+
+    Shard &shard = _table->shard(qHash(key));
+    QMutexLocker locker(&shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return false;
+    }
+    shard.erase(it);
+    return true;
+}
+
+
+void TCacheMemoryStore::clear()
+{
+    if (Q_UNLIKELY(!_table)) {
+        return;
+    }
+
+    for (auto &shard : _table->shards) {
+        QMutexLocker locker(&shard.mutex);
+        shard.removeAll();
+    }
+}
+
+/*!
+  Removes the expired items.
+ */
+void TCacheMemoryStore::gc()
+{
+    if (Q_UNLIKELY(!_table)) {
+        return;
+    }
+
+    const qint64 now = TClock::monotonicMSecs();
+
+    for (auto &shard : _table->shards) {
+        QMutexLocker locker(&shard.mutex);
+        for (auto it = shard.index.begin(); it != shard.index.end();) {
+            if (it.value()->expire <= now) {
+                shard.bytes -= it.value()->size();
+                shard.lru.erase(it.value());
+                it = shard.index.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+/*!
+  Returns the number of the items, including expired ones not removed yet.
+ */
+int TCacheMemoryStore::count() const
+{
+    if (Q_UNLIKELY(!_table)) {
+        return 0;
+    }
+
+    int cnt = 0;
+    for (auto &shard : _table->shards) {
+        QMutexLocker locker(&shard.mutex);
+        cnt += shard.index.count();
+    }
+    return cnt;
+}
+
+/*!
+  Returns the approximate number of bytes the items use.
+ */
+qint64 TCacheMemoryStore::memorySize() const
+{
+    if (Q_UNLIKELY(!_table)) {
+        return 0;
+    }
+
+    qint64 size = 0;
+    for (auto &shard : _table->shards) {
+        QMutexLocker locker(&shard.mutex);
+        size += shard.bytes;
+    }
+    return size;
+}
+
+
+QMap<QString, QVariant> TCacheMemoryStore::defaultSettings() const
+{
+    QMap<QString, QVariant> settings {
+        {"MaxMemorySize", 64},
+        {"CompressionThreshold", 4096},
+    };
+    return settings;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "tcachestore.h"
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TCacheMemoryStore : public TCacheStore {
+public:
+    virtual ~TCacheMemoryStore() { }
+
+    QString key() const override { return QLatin1String("memory"); }
+    DbType dbType() const override { return Memory; }
+    bool open() override;
+    void close() override;
+
+    QByteArray get(const QByteArray &key) override;
+    bool set(const QByteArray &key, const QByteArray &value, int seconds) override;
+    bool remove(const QByteArray &key) override;
+    void clear() override;
+    void gc() override;
+    QMap<QString, QVariant> defaultSettings() const override;
+
+    int count() const;
+    qint64 memorySize() const;
+
+protected:
+    TCacheMemoryStore(const QByteArray &table = QByteArray());
+    bool open(qint64 maxMemorySize, int compressionThreshold);
+
+private:
+    class Table;
+    QByteArray _name;
+    Table *_table {nullptr};
+
+    friend class TCacheFactory;
+    friend class TCacheTieredStore;
+};
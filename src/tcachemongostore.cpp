@@ -6,12 +6,23 @@
  */
 
 #include "tcachemongostore.h"
+#include "tclock.h"
 #include <QDateTime>
 #include <TMongoQuery>
 
 constexpr auto COL = "cache";
 
 
+static QStringList toStringList(const QByteArrayList &keys)
+{
+    QStringList list;
+    for (auto &key : keys) {
+        list << QString(key);
+    }
+    return list;
+}
+
+
 TCacheMongoStore::TCacheMongoStore()
 {
 }
@@ -31,7 +42,7 @@ void TCacheMongoStore::close()
 QByteArray TCacheMongoStore::get(const QByteArray &key)
 {
     TMongoQuery mongo(Tf::KvsEngine::CacheKvs, COL);
-    qint64 current = QDateTime::currentMSecsSinceEpoch() / 1000;
+    qint64 current = TClock::currentSecsSinceEpoch();
 
     QVariantMap cri {{"k", QString(key)}};
     QVariantMap doc = mongo.findOne(cri);
@@ -49,7 +60,7 @@ bool TCacheMongoStore::set(const QByteArray &key, const QByteArray &value, int s
 {
     TMongoQuery mongo(Tf::KvsEngine::CacheKvs, COL);
 
-    qint64 expire = QDateTime::currentMSecsSinceEpoch() / 1000 + seconds;
+    qint64 expire = TClock::currentSecsSinceEpoch() + seconds;
     QVariantMap doc {{"k", QString(key)}, {"v", value}, {"t", expire}};
     QVariantMap cri {{"k", QString(key)}};
     return mongo.update(cri, doc, true);
@@ -75,7 +86,7 @@ void TCacheMongoStore::clear()
 void TCacheMongoStore::gc()
 {
     TMongoQuery mongo(Tf::KvsEngine::CacheKvs, COL);
-    qint64 current = QDateTime::currentMSecsSinceEpoch() / 1000;
+    qint64 current = TClock::currentSecsSinceEpoch();
 
     QVariantMap lte {{"$lte", current}};
     QVariantMap cri {{"t", lte}};
@@ -83,6 +94,66 @@ void TCacheMongoStore::gc()
 }
 
 
+/*!
+  Finds the values of the \a keys with one $in query.
+ */
+QMap<QByteArray, QByteArray> TCacheMongoStore::getMulti(const QByteArrayList &keys)
+{
+    QMap<QByteArray, QByteArray> values;
+    if (keys.isEmpty()) {
+        return values;
+    }
+
+    TMongoQuery mongo(Tf::KvsEngine::CacheKvs, COL);
+    qint64 current = TClock::currentSecsSinceEpoch();
+
+    QVariantMap in {{"$in", toStringList(keys)}};
+    QVariantMap cri {{"k", in}};
+    if (mongo.find(cri)) {
+        while (mongo.next()) {
+            QVariantMap doc = mongo.value();
+            if (doc.value("t").toLongLong() > current) {
+                values.insert(doc.value("k").toString().toUtf8(), doc.value("v").toByteArray());
+            }
+        }
+    }
+    return values;
+}
+
+/*!
+  Replaces the items of the \a values with one delete and one bulk insert.
+ */
+bool TCacheMongoStore::setMulti(const QMap<QByteArray, QByteArray> &values, int seconds)
+{
+    if (values.isEmpty()) {
+        return true;
+    }
+
+    removeMulti(values.keys());
+
+    TMongoQuery mongo(Tf::KvsEngine::CacheKvs, COL);
+    qint64 expire = TClock::currentSecsSinceEpoch() + seconds;
+    QList<QVariantMap> docs;
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        docs << QVariantMap {{"k", QString(it.key())}, {"v", it.value()}, {"t", expire}};
+    }
+    return mongo.insertMulti(docs) == docs.count();
+}
+
+
+int TCacheMongoStore::removeMulti(const QByteArrayList &keys)
+{
+    if (keys.isEmpty()) {
+        return 0;
+    }
+
+    TMongoQuery mongo(Tf::KvsEngine::CacheKvs, COL);
+    QVariantMap in {{"$in", toStringList(keys)}};
+    QVariantMap cri {{"k", in}};
+    return mongo.remove(cri);
+}
+
+
 QMap<QString, QVariant> TCacheMongoStore::defaultSettings() const
 {
     QMap<QString, QVariant> settings {
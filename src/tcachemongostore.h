@@ -17,6 +17,9 @@ public:
     bool remove(const QByteArray &key) override;
     void clear() override;
     void gc() override;
+    QMap<QByteArray, QByteArray> getMulti(const QByteArrayList &keys) override;
+    bool setMulti(const QMap<QByteArray, QByteArray> &values, int seconds) override;
+    int removeMulti(const QByteArrayList &keys) override;
     QMap<QString, QVariant> defaultSettings() const override;
 
 protected:
@@ -6,8 +6,16 @@
  */
 
 #include "tcacheredisstore.h"
+#include "tredisdriver.h"
+#include "tsystemglobal.h"
+#include <QCoreApplication>
 #include <TRedis>
 
+constexpr auto LOCK_SUFFIX = ":lock";
+
+// Deletes the lock only if it still holds the token of its holder
+constexpr auto UNLOCK_SCRIPT = "if redis.call('get', KEYS[1]) == ARGV[1] then return redis.call('del', KEYS[1]) else return 0 end";
+
 
 TCacheRedisStore::TCacheRedisStore()
 {
@@ -57,6 +65,95 @@ void TCacheRedisStore::gc()
 {
 }
 
+/*!
+  Gets the values of the \a keys with MGET.
+ */
+QMap<QByteArray, QByteArray> TCacheRedisStore::getMulti(const QByteArrayList &keys)
+{
+    QMap<QByteArray, QByteArray> values;
+    if (keys.isEmpty()) {
+        return values;
+    }
+
+    TRedis redis(Tf::KvsEngine::CacheKvs);
+    const QByteArrayList list = redis.mget(keys);
+    for (int i = 0; i < list.count() && i < keys.count(); ++i) {
+        if (!list[i].isNull()) {
+            values.insert(keys[i], list[i]);
+        }
+    }
+    return values;
+}
+
+/*!
+  Sets the \a values with SETEX commands pipelined in one round trip.
+ */
+bool TCacheRedisStore::setMulti(const QMap<QByteArray, QByteArray> &values, int seconds)
+{
+    if (values.isEmpty()) {
+        return true;
+    }
+
+    QList<QPair<QByteArray, QByteArray>> list;
+    list.reserve(values.count());
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        list << qMakePair(it.key(), it.value());
+    }
+
+    TRedis redis(Tf::KvsEngine::CacheKvs);
+    return redis.setEx(list, seconds);
+}
+
+
+int TCacheRedisStore::removeMulti(const QByteArrayList &keys)
+{
+    if (keys.isEmpty()) {
+        return 0;
+    }
+
+    TRedis redis(Tf::KvsEngine::CacheKvs);
+    return redis.del(keys);
+}
+
+/*!
+  Acquires the lock of the \a key among the processes, which expires
+  after \a seconds. Returns false if another one holds it. The lock
+  holds a random token, so that unlock() never releases a lock that
+  has expired and been acquired by another one.
+ */
+bool TCacheRedisStore::lock(const QByteArray &key, int seconds)
+{
+    TRedis redis(Tf::KvsEngine::CacheKvs);
+    QByteArray token = QByteArray::number(QCoreApplication::applicationPid()) + ':' + QByteArray::number((qulonglong)Tf::rand64_r(), 16);
+    if (!redis.setNx(key + LOCK_SUFFIX, token, seconds)) {
+        return false;
+    }
+    lockTokens.insert(key, token);
+    return true;
+}
+
+/*!
+  Releases the lock of the \a key acquired by lock(), comparing its
+  token and deleting it in one script on the server.
+ */
+void TCacheRedisStore::unlock(const QByteArray &key)
+{
+    QByteArray token = lockTokens.take(key);
+    if (token.isEmpty()) {
+        return;  // not held
+    }
+
+    TRedis redis(Tf::KvsEngine::CacheKvs);
+    if (!redis.driver()) {
+        return;
+    }
+
+    QVariantList resp;
+    if (!redis.driver()->request({"EVAL", UNLOCK_SCRIPT, "1", key + LOCK_SUFFIX, token}, resp)) {
+        tSystemWarn("Unable to release the cache lock: %s", key.data());
+    }
+}
+
 
 QMap<QString, QVariant> TCacheRedisStore::defaultSettings() const
 {
@@ -1,5 +1,6 @@
 #pragma once
 #include "tcachestore.h"
+#include <QHash>
 #include <TGlobal>
 
 
@@ -17,11 +18,19 @@ public:
     bool remove(const QByteArray &key) override;
     void clear() override;
     void gc() override;
+    QMap<QByteArray, QByteArray> getMulti(const QByteArrayList &keys) override;
+    bool setMulti(const QMap<QByteArray, QByteArray> &values, int seconds) override;
+    int removeMulti(const QByteArrayList &keys) override;
+    bool lock(const QByteArray &key, int seconds) override;
+    void unlock(const QByteArray &key) override;
     QMap<QString, QVariant> defaultSettings() const override;
 
 protected:
     TCacheRedisStore();
 
+private:
+    QHash<QByteArray, QByteArray> lockTokens;  // of the locks held
+
     friend class TCacheFactory;
 };
 
@@ -0,0 +1,726 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tcachesharedmemorystore.h"
+#include "tclock.h"
+#include "tsystemglobal.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <TCache>
+#include <TWebApplication>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*!
+  \class TCacheSharedMemoryStore
+  \brief The TCacheSharedMemoryStore class stores the items in a file
+  mapped into the memory of all the server processes of the host, so
+  that they share the items without any daemon.
+
+  The file is divided into segments, each holding an open-addressing
+  hash table and the items allocated in slabs of chunks of power-of-two
+  sizes. Each segment is guarded by a process-shared robust mutex, which
+  takes no system call unless contended; if a process dies holding it,
+  the next process resets the segment. Each slab class keeps its items
+  in LRU order. When a class runs out of chunks, its least recently used
+  item is evicted, so that items of one size never evict those of
+  another; a class that has no page any more takes the page of the least
+  recently used item of the class holding the most pages. Items larger
+  than the largest chunk (64KB) are not stored.
+*/
+
+namespace {
+
+constexpr quint32 MAGIC = 0x54434D32;  // "TCM2"
+constexpr int SEGMENT_COUNT = 16;
+constexpr int PAGE_SIZE = 64 * 1024;  // slab page
+constexpr int MIN_CHUNK_SHIFT = 6;  // 64 bytes
+constexpr int CLASS_COUNT = 11;  // 64 bytes to 64KB
+constexpr int BYTES_PER_BUCKET = 128;
+constexpr quint32 EMPTY = 0;  // offsets of items are never 0 or 1
+constexpr quint32 TOMBSTONE = 1;
+constexpr quint8 FREE_CLASS = 0xFF;  // of free chunks and pages not carved
+
+struct alignas(64) FileHeader {
+    quint32 magic;
+    quint32 segmentCount;
+    quint64 fileSize;
+    quint64 segmentSize;
+};
+
+struct alignas(64) Segment {
+    pthread_mutex_t mutex;
+    quint32 bucketCount;
+    quint32 pageCount;
+    quint32 itemCount;
+    quint32 dataOffset;  // offsets are from the segment
+    quint32 nextPage;
+    quint32 endOffset;
+    quint32 freeLists[CLASS_COUNT];
+    quint32 lruHeads[CLASS_COUNT];  // most recently used
+    quint32 lruTails[CLASS_COUNT];
+    quint32 classItems[CLASS_COUNT];
+    quint32 classPages[CLASS_COUNT];
+};
+
+struct Bucket {
+    quint32 hash;
+    quint32 offset;
+};
+
+struct Item {
+    enum Flag : quint8 {
+        Compressed = 0x01,
+    };
+
+    quint32 hash;
+    quint8 slabClass;  // FREE_CLASS if the chunk is free
+    quint8 flags;
+    quint16 keyLength;
+    quint32 valueLength;
+    quint32 bucket;  // index in the hash table
+    quint32 prev;  // in the LRU list of the class, or 0
+    quint32 next;  // also links the free chunks
+    qint64 expire;  // secs since epoch
+
+    char *key() { return reinterpret_cast<char *>(this + 1); }
+    char *value() { return key() + keyLength; }
+};
+
+
+inline quint64 hashKey(const QByteArray &key)
+{
+    // FNV-1a, the same in all the processes
+    quint64 h = 0xcbf29ce484222325ULL;
+    for (char c : key) {
+        h = (h ^ (uchar)c) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+
+inline Bucket *buckets(Segment *seg)
+{
+    return reinterpret_cast<Bucket *>(reinterpret_cast<char *>(seg) + sizeof(Segment));
+}
+
+
+inline Item *itemAt(Segment *seg, quint32 offset)
+{
+    return reinterpret_cast<Item *>(reinterpret_cast<char *>(seg) + offset);
+}
+
+
+// Slab classes of the pages, following the hash table
+inline quint8 *pageClasses(Segment *seg)
+{
+    return reinterpret_cast<quint8 *>(buckets(seg) + seg->bucketCount);
+}
+
+
+inline int slabClass(int size)
+{
+    for (int cls = 0; cls < CLASS_COUNT; ++cls) {
+        if (size <= (1 << (cls + MIN_CHUNK_SHIFT))) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
+
+void resetSegment(Segment *seg, quint64 size)
+{
+    seg->bucketCount = qMax<quint32>(size / BYTES_PER_BUCKET, 64);
+    const quint64 tableEnd = sizeof(Segment) + seg->bucketCount * sizeof(Bucket);
+    seg->pageCount = (size > tableEnd) ? (size - tableEnd) / (PAGE_SIZE + 1) : 0;
+    seg->dataOffset = (tableEnd + seg->pageCount + 63) & ~63;
+    if (seg->pageCount > 0 && seg->dataOffset + (quint64)seg->pageCount * PAGE_SIZE > size) {
+        seg->pageCount--;  // by the alignment
+    }
+    seg->itemCount = 0;
+    seg->nextPage = seg->dataOffset;
+    seg->endOffset = seg->dataOffset + seg->pageCount * PAGE_SIZE;
+    std::memset(seg->freeLists, 0, sizeof(seg->freeLists));
+    std::memset(seg->lruHeads, 0, sizeof(seg->lruHeads));
+    std::memset(seg->lruTails, 0, sizeof(seg->lruTails));
+    std::memset(seg->classItems, 0, sizeof(seg->classItems));
+    std::memset(seg->classPages, 0, sizeof(seg->classPages));
+    std::memset(buckets(seg), 0, seg->bucketCount * sizeof(Bucket));
+    std::memset(pageClasses(seg), FREE_CLASS, seg->pageCount);
+}
+
+
+bool initSegment(Segment *seg, quint64 size)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int res = pthread_mutex_init(&seg->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    resetSegment(seg, size);
+    return res == 0;
+}
+
+
+class SegmentLocker {
+public:
+    SegmentLocker(Segment *segment, quint64 size) :
+        seg(segment)
+    {
+        int res = pthread_mutex_lock(&seg->mutex);
+        if (Q_UNLIKELY(res == EOWNERDEAD)) {
+            // The holder died; the segment may be inconsistent
+            tSystemWarn("Shared memory cache: owner died, reset a segment");
+            resetSegment(seg, size);
+            pthread_mutex_consistent(&seg->mutex);
+            res = 0;
+        }
+        locked = (res == 0);
+        if (Q_UNLIKELY(!locked)) {
+            tSystemError("Shared memory cache: lock error:%d  [%s:%d]", res, __FILE__, __LINE__);
+        }
+    }
+
+    ~SegmentLocker()
+    {
+        if (locked) {
+            pthread_mutex_unlock(&seg->mutex);
+        }
+    }
+
+    bool isLocked() const { return locked; }
+
+private:
+    Segment *seg;
+    bool locked {false};
+};
+
+
+void pushFree(Segment *seg, int cls, quint32 offset)
+{
+    Item *chunk = itemAt(seg, offset);
+    chunk->slabClass = FREE_CLASS;
+    chunk->next = seg->freeLists[cls];
+    seg->freeLists[cls] = offset;
+}
+
+
+// Carves the page into chunks of the slab class
+void carve(Segment *seg, quint32 page, int cls)
+{
+    const quint32 chunkSize = 1 << (cls + MIN_CHUNK_SHIFT);
+    const quint32 offset = seg->dataOffset + page * PAGE_SIZE;
+    for (int i = PAGE_SIZE / chunkSize - 1; i >= 0; --i) {
+        pushFree(seg, cls, offset + i * chunkSize);
+    }
+    pageClasses(seg)[page] = cls;
+    seg->classPages[cls]++;
+}
+
+
+// Returns the chunk of the slab class, or 0 if none is free
+quint32 allocate(Segment *seg, int cls)
+{
+    if (!seg->freeLists[cls]) {
+        if (seg->nextPage + PAGE_SIZE > seg->endOffset) {
+            return 0;
+        }
+        carve(seg, (seg->nextPage - seg->dataOffset) / PAGE_SIZE, cls);
+        seg->nextPage += PAGE_SIZE;
+    }
+
+    quint32 offset = seg->freeLists[cls];
+    seg->freeLists[cls] = itemAt(seg, offset)->next;
+    return offset;
+}
+
+
+void lruUnlink(Segment *seg, Item *item)
+{
+    const int cls = item->slabClass;
+    if (item->prev) {
+        itemAt(seg, item->prev)->next = item->next;
+    } else {
+        seg->lruHeads[cls] = item->next;
+    }
+    if (item->next) {
+        itemAt(seg, item->next)->prev = item->prev;
+    } else {
+        seg->lruTails[cls] = item->prev;
+    }
+}
+
+
+void lruPushFront(Segment *seg, quint32 offset)
+{
+    Item *item = itemAt(seg, offset);
+    const int cls = item->slabClass;
+    item->prev = 0;
+    item->next = seg->lruHeads[cls];
+    if (item->next) {
+        itemAt(seg, item->next)->prev = offset;
+    } else {
+        seg->lruTails[cls] = offset;
+    }
+    seg->lruHeads[cls] = offset;
+}
+
+
+void removeAt(Segment *seg, quint32 index)
+{
+    Bucket *bkt = buckets(seg);
+    quint32 offset = bkt[index].offset;
+    Item *item = itemAt(seg, offset);
+    int cls = item->slabClass;
+    lruUnlink(seg, item);
+    pushFree(seg, cls, offset);
+    seg->classItems[cls]--;
+    seg->itemCount--;
+
+    // Empties the trailing tombstones so that probes stay short
+    if (bkt[(index + 1) % seg->bucketCount].offset == EMPTY) {
+        do {
+            bkt[index].offset = EMPTY;
+            index = (index + seg->bucketCount - 1) % seg->bucketCount;
+        } while (bkt[index].offset == TOMBSTONE);
+    } else {
+        bkt[index].offset = TOMBSTONE;
+    }
+}
+
+
+// Moves a page of the class holding the most pages to the slab class,
+// evicting the items in it
+bool reassignPage(Segment *seg, int cls)
+{
+    int donor = -1;
+    for (int c = 0; c < CLASS_COUNT; ++c) {
+        if (c != cls && seg->classPages[c] > 0 && (donor < 0 || seg->classPages[c] > seg->classPages[donor])) {
+            donor = c;
+        }
+    }
+    if (donor < 0) {
+        return false;
+    }
+
+    // The page of the least recently used item, or any of the class
+    quint32 page = 0;
+    if (seg->lruTails[donor]) {
+        page = (seg->lruTails[donor] - seg->dataOffset) / PAGE_SIZE;
+    } else {
+        while (pageClasses(seg)[page] != donor) {
+            page++;
+        }
+    }
+
+    const quint32 begin = seg->dataOffset + page * PAGE_SIZE;
+    const quint32 end = begin + PAGE_SIZE;
+    const quint32 chunkSize = 1 << (donor + MIN_CHUNK_SHIFT);
+    for (quint32 chunk = begin; chunk < end; chunk += chunkSize) {
+        Item *item = itemAt(seg, chunk);
+        if (item->slabClass != FREE_CLASS) {
+            removeAt(seg, item->bucket);
+        }
+    }
+
+    // Takes the chunks of the page out of the free list
+    quint32 *link = &seg->freeLists[donor];
+    while (*link) {
+        if (*link >= begin && *link < end) {
+            *link = itemAt(seg, *link)->next;
+        } else {
+            link = &itemAt(seg, *link)->next;
+        }
+    }
+
+    seg->classPages[donor]--;
+    carve(seg, page, cls);
+    tSystemDebug("Shared memory cache: page moved from class %d to %d", donor, cls);
+    return true;
+}
+
+
+// Frees a chunk of the slab class by evicting its least recently used
+// item; a class without items takes a page of another class. If cls is
+// -1, evicts the least recently used item of the class holding the most.
+bool evict(Segment *seg, int cls)
+{
+    const bool any = (cls < 0);
+    if (any) {
+        for (int c = 0; c < CLASS_COUNT; ++c) {
+            if (cls < 0 || seg->classItems[c] > seg->classItems[cls]) {
+                cls = c;
+            }
+        }
+    }
+
+    if (seg->lruTails[cls]) {
+        removeAt(seg, itemAt(seg, seg->lruTails[cls])->bucket);
+        return true;
+    }
+    return !any && reassignPage(seg, cls);
+}
+
+
+// Returns the bucket index of the key, or -1
+int find(Segment *seg, quint32 hash, const QByteArray &key)
+{
+    Bucket *bkt = buckets(seg);
+    quint32 index = hash % seg->bucketCount;
+
+    for (quint32 i = 0; i < seg->bucketCount; ++i) {
+        const Bucket &b = bkt[index];
+        if (b.offset == EMPTY) {
+            break;
+        }
+        if (b.offset != TOMBSTONE && b.hash == hash) {
+            Item *item = itemAt(seg, b.offset);
+            if (item->keyLength == key.size() && std::memcmp(item->key(), key.constData(), key.size()) == 0) {
+                return index;
+            }
+        }
+        index = (index + 1) % seg->bucketCount;
+    }
+    return -1;
+}
+
+}  // namespace
+
+
+class TCacheSharedMemoryStore::Mapping {
+public:
+    char *address {nullptr};
+    quint64 size {0};
+
+    FileHeader *header() const { return reinterpret_cast<FileHeader *>(address); }
+
+    Segment *segment(int index) const
+    {
+        return reinterpret_cast<Segment *>(address + sizeof(FileHeader) + header()->segmentSize * index);
+    }
+
+    Segment *segment(quint64 hash) const { return segment((int)(hash >> 60) % SEGMENT_COUNT); }
+    quint64 segmentSize() const { return header()->segmentSize; }
+
+    static Mapping *map(const QString &path, quint64 size);
+};
+
+/*!
+  Maps the file \a path of \a size bytes, initializing it if it has not
+  been by another process.
+ */
+TCacheSharedMemoryStore::Mapping *TCacheSharedMemoryStore::Mapping::map(const QString &path, quint64 size)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    int fd = ::open(qPrintable(path), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        tSystemError("Shared memory cache: open error: %s  [%s:%d]", qPrintable(path), __FILE__, __LINE__);
+        return nullptr;
+    }
+
+    ::flock(fd, LOCK_EX);  // excludes the other processes while initializing
+
+    struct stat st;
+    ::fstat(fd, &st);
+    if (st.st_size >= (off_t)sizeof(FileHeader)) {
+        FileHeader existing;
+        if (::pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) && existing.magic == MAGIC && existing.fileSize == (quint64)st.st_size) {
+            size = st.st_size;  // in use by other processes; never truncated
+        }
+    }
+
+    Mapping *mapping = nullptr;
+    if ((quint64)st.st_size == size || ::ftruncate(fd, size) == 0) {
+        void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            mapping = new Mapping;
+            mapping->address = (char *)addr;
+            mapping->size = size;
+        }
+    }
+
+    if (!mapping) {
+        tSystemError("Shared memory cache: map error:%d %s  [%s:%d]", errno, qPrintable(path), __FILE__, __LINE__);
+    } else if (mapping->header()->magic != MAGIC || mapping->header()->fileSize != size) {
+        FileHeader *header = mapping->header();
+        header->magic = 0;
+        header->segmentCount = SEGMENT_COUNT;
+        header->fileSize = size;
+        header->segmentSize = ((size - sizeof(FileHeader)) / SEGMENT_COUNT) & ~(quint64)63;
+
+        for (int i = 0; i < SEGMENT_COUNT; ++i) {
+            initSegment(mapping->segment(i), header->segmentSize);
+        }
+        header->magic = MAGIC;  // initialized
+        tSystemDebug("Shared memory cache initialized: %s size:%lld", qPrintable(path), (qint64)size);
+    }
+
+    ::flock(fd, LOCK_UN);
+    ::close(fd);  // the mapping remains
+    return mapping;
+}
+
+
+TCacheSharedMemoryStore::TCacheSharedMemoryStore()
+{
+}
+
+
+bool TCacheSharedMemoryStore::open()
+{
+    const QVariantMap settings = Tf::app()->cacheSettings();
+    QString path = settings.value("FilePath").toString().trimmed();
+    if (QFileInfo(path).isRelative()) {
+        path = Tf::app()->webRootPath() + path;
+    }
+    return open(path, settings.value("MaxMemorySize").toULongLong() * 1024 * 1024);
+}
+
+/*!
+  Maps the file \a path of \a size bytes on the first call in the
+  process; the size of the file in use by other processes is kept.
+ */
+bool TCacheSharedMemoryStore::open(const QString &path, quint64 size)
+{
+    static QMutex mutex;
+    static QMap<QString, Mapping *> mappings;
+
+    if (_mapping) {
+        return true;
+    }
+
+    QMutexLocker locker(&mutex);
+    Mapping *&mapping = mappings[path];
+    if (!mapping) {
+        size = qBound<quint64>(1024 * 1024, size, SEGMENT_COUNT * (quint64)0xF0000000);
+        mapping = Mapping::map(path, size);
+    }
+    _mapping = mapping;
+    return _mapping;
+}
+
+
+void TCacheSharedMemoryStore::close()
+{
+}
+
+
+QByteArray TCacheSharedMemoryStore::get(const QByteArray &key)
+{
+    if (Q_UNLIKELY(!_mapping)) {
+        return QByteArray();
+    }
+
+    const quint64 hash = hashKey(key);
+    Segment *seg = _mapping->segment(hash);
+    QByteArray value;
+    bool compressed = false;
+    {
+        SegmentLocker locker(seg, _mapping->segmentSize());
+        if (Q_UNLIKELY(!locker.isLocked())) {
+            return QByteArray();
+        }
+
+        int index = find(seg, (quint32)hash, key);
+        if (index < 0) {
+            return QByteArray();
+        }
+
+        Item *item = itemAt(seg, buckets(seg)[index].offset);
+        if (item->expire <= TClock::currentSecsSinceEpoch()) {
+            removeAt(seg, index);
+            return QByteArray();
+        }
+
+        lruUnlink(seg, item);
+        lruPushFront(seg, buckets(seg)[index].offset);
+        value = QByteArray(item->value(), item->valueLength);
+        compressed = item->flags & Item::Compressed;
+    }
+    return (compressed) ? Tf::lz4Uncompress(value) : value;
+}
+
+
+bool TCacheSharedMemoryStore::set(const QByteArray &key, const QByteArray &value, int seconds)
+{
+    if (Q_UNLIKELY(!_mapping) || key.size() > 0xFFFF) {
+        return false;
+    }
+
+    if (seconds <= 0) {
+        remove(key);
+        return false;
+    }
+
+    // Compresses outside of the lock
+    static const int threshold = TCache::compressionEnabled() ? Tf::app()->cacheSettings().value("CompressionThreshold", 4096).toInt() : -1;
+    const bool compress = (threshold >= 0 && value.size() >= threshold);
+    const QByteArray data = (compress) ? Tf::lz4Compress(value) : value;
+
+    const int cls = slabClass(sizeof(Item) + key.size() + data.size());
+    if (cls < 0) {
+        return false;  // too large
+    }
+
+    const quint64 hash = hashKey(key);
+    Segment *seg = _mapping->segment(hash);
+    SegmentLocker locker(seg, _mapping->segmentSize());
+    if (Q_UNLIKELY(!locker.isLocked())) {
+        return false;
+    }
+
+    int index = find(seg, (quint32)hash, key);
+    if (index >= 0) {
+        removeAt(seg, index);
+    }
+
+    // Keeps the load factor of the table at 3/4 or less
+    if (seg->itemCount >= seg->bucketCount / 4 * 3) {
+        evict(seg, -1);
+    }
+
+    quint32 offset = allocate(seg, cls);
+    if (!offset && evict(seg, cls)) {
+        offset = allocate(seg, cls);
+    }
+    if (!offset) {
+        return false;
+    }
+
+    Item *item = itemAt(seg, offset);
+    item->hash = (quint32)hash;
+    item->slabClass = cls;
+    item->flags = (compress) ? Item::Compressed : 0;
+    item->keyLength = key.size();
+    item->valueLength = data.size();
+    item->expire = TClock::currentSecsSinceEpoch() + seconds;
+    std::memcpy(item->key(), key.constData(), key.size());
+    std::memcpy(item->value(), data.constData(), data.size());
+
+    // Takes the first free bucket
+    Bucket *bkt = buckets(seg);
+    quint32 idx = (quint32)hash % seg->bucketCount;
+    while (bkt[idx].offset != EMPTY && bkt[idx].offset != TOMBSTONE) {
+        idx = (idx + 1) % seg->bucketCount;
+    }
+    bkt[idx].hash = (quint32)hash;
+    bkt[idx].offset = offset;
+    item->bucket = idx;
+    lruPushFront(seg, offset);
+    seg->classItems[cls]++;
+    seg->itemCount++;
+    return true;
+}
+
+
+bool TCacheSharedMemoryStore::remove(const QByteArray &key)
+{
+    if (Q_UNLIKELY(!_mapping)) {
+        return false;
+    }
+
+    const quint64 hash = hashKey(key);
+    Segment *seg = _mapping->segment(hash);
+    SegmentLocker locker(seg, _mapping->segmentSize());
+    if (Q_UNLIKELY(!locker.isLocked())) {
+        return false;
+    }
+
+    int index = find(seg, (quint32)hash, key);
+    if (index < 0) {
+        return false;
+    }
+    removeAt(seg, index);
+    return true;
+}
+
+
+void TCacheSharedMemoryStore::clear()
+{
+    if (Q_UNLIKELY(!_mapping)) {
+        return;
+    }
+
+    for (int i = 0; i < SEGMENT_COUNT; ++i) {
+        Segment *seg = _mapping->segment(i);
+        SegmentLocker locker(seg, _mapping->segmentSize());
+        if (locker.isLocked()) {
+            resetSegment(seg, _mapping->segmentSize());
+        }
+    }
+}
+
+/*!
+  Removes the expired items.
+ */
+void TCacheSharedMemoryStore::gc()
+{
+    if (Q_UNLIKELY(!_mapping)) {
+        return;
+    }
+
+    const qint64 now = TClock::currentSecsSinceEpoch();
+
+    for (int i = 0; i < SEGMENT_COUNT; ++i) {
+        Segment *seg = _mapping->segment(i);
+        SegmentLocker locker(seg, _mapping->segmentSize());
+        if (!locker.isLocked()) {
+            continue;
+        }
+
+        Bucket *bkt = buckets(seg);
+        for (quint32 index = 0; index < seg->bucketCount; ++index) {
+            quint32 offset = bkt[index].offset;
+            if (offset != EMPTY && offset != TOMBSTONE && itemAt(seg, offset)->expire <= now) {
+                removeAt(seg, index);
+            }
+        }
+    }
+}
+
+/*!
+  Returns the number of the items in all the processes, including
+  expired ones not removed yet.
+ */
+int TCacheSharedMemoryStore::count() const
+{
+    if (Q_UNLIKELY(!_mapping)) {
+        return 0;
+    }
+
+    int cnt = 0;
+    for (int i = 0; i < SEGMENT_COUNT; ++i) {
+        Segment *seg = _mapping->segment(i);
+        SegmentLocker locker(seg, _mapping->segmentSize());
+        if (locker.isLocked()) {
+            cnt += seg->itemCount;
+        }
+    }
+    return cnt;
+}
+
+
+QMap<QString, QVariant> TCacheSharedMemoryStore::defaultSettings() const
+{
+    QMap<QString, QVariant> settings {
+        {"FilePath", "tmp/cachemap"},
+        {"MaxMemorySize", 64},
+        {"CompressionThreshold", 4096},
+    };
+    return settings;
+}
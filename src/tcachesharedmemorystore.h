@@ -0,0 +1,33 @@
+#pragma once
+#include "tcachestore.h"
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TCacheSharedMemoryStore : public TCacheStore {
+public:
+    virtual ~TCacheSharedMemoryStore() { }
+
+    QString key() const override { return QLatin1String("sharedmemory"); }
+    DbType dbType() const override { return Memory; }
+    bool open() override;
+    void close() override;
+
+    QByteArray get(const QByteArray &key) override;
+    bool set(const QByteArray &key, const QByteArray &value, int seconds) override;
+    bool remove(const QByteArray &key) override;
+    void clear() override;
+    void gc() override;
+    QMap<QString, QVariant> defaultSettings() const override;
+
+    int count() const;
+
+protected:
+    TCacheSharedMemoryStore();
+    bool open(const QString &path, quint64 size);
+
+private:
+    class Mapping;
+    Mapping *_mapping {nullptr};
+
+    friend class TCacheFactory;
+};
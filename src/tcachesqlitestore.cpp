@@ -6,6 +6,7 @@
  */
 
 #include "tcachesqlitestore.h"
+#include "tclock.h"
 #include "tsqlquery.h"
 #include "tsystemglobal.h"
 #include <QByteArray>
@@ -18,6 +19,7 @@ constexpr auto KEY_COLUMN = "k";
 constexpr auto BLOB_COLUMN = "b";
 constexpr auto TIMESTAMP_COLUMN = "t";
 constexpr int PAGESIZE = 4096;
+constexpr int MAX_ROWS_PER_STATEMENT = 300;  // within the limit of 999 host parameters
 
 
 inline QSqlError lastError()
@@ -101,7 +103,7 @@ bool TCacheSQLiteStore::exists(const QByteArray &key)
     int exist = 0;
     TSqlQuery query(Tf::app()->databaseIdForCache());
     QString sql = QStringLiteral("select exists(select 1 from %1 where %2=:name and %3>:ts limit 1)").arg(_table).arg(KEY_COLUMN).arg(TIMESTAMP_COLUMN);
-    qint64 current = QDateTime::currentMSecsSinceEpoch() / 1000;
+    qint64 current = TClock::currentSecsSinceEpoch();
 
     query.prepare(sql);
     query.bind(":name", key);
@@ -117,7 +119,7 @@ QByteArray TCacheSQLiteStore::get(const QByteArray &key)
 {
     QByteArray value;
     qint64 expire = 0;
-    qint64 current = QDateTime::currentMSecsSinceEpoch() / 1000;
+    qint64 current = TClock::currentSecsSinceEpoch();
 
     if (read(key, value, expire)) {
         if (expire <= current) {
@@ -136,7 +138,7 @@ bool TCacheSQLiteStore::set(const QByteArray &key, const QByteArray &value, int
     }
 
     remove(key);
-    qint64 expire = QDateTime::currentMSecsSinceEpoch() / 1000 + seconds;
+    qint64 expire = TClock::currentSecsSinceEpoch() + seconds;
     return write(key, value, expire);
 }
 
@@ -207,6 +209,111 @@ bool TCacheSQLiteStore::remove(const QByteArray &key)
 }
 
 
+/*!
+  Reads the values of the \a keys with one statement per
+  MAX_ROWS_PER_STATEMENT keys.
+ */
+QMap<QByteArray, QByteArray> TCacheSQLiteStore::getMulti(const QByteArrayList &keys)
+{
+    QMap<QByteArray, QByteArray> values;
+    QByteArrayList expired;
+    qint64 current = TClock::currentSecsSinceEpoch();
+
+    for (int i = 0; i < keys.count(); i += MAX_ROWS_PER_STATEMENT) {
+        const QByteArrayList chunk = keys.mid(i, MAX_ROWS_PER_STATEMENT);
+        QString params = QStringLiteral("?,").repeated(chunk.count());
+        params.chop(1);
+
+        TSqlQuery query(Tf::app()->databaseIdForCache());
+        query.prepare(QStringLiteral("select %1,%2,%3 from %4 where %1 in (%5)").arg(KEY_COLUMN, TIMESTAMP_COLUMN, BLOB_COLUMN, _table, params));
+        for (auto &key : chunk) {
+            query.addBind(key);
+        }
+
+        if (!query.exec()) {
+            tSystemError("SQLite error : %s [%s:%d]", qPrintable(lastErrorString()), __FILE__, __LINE__);
+            continue;
+        }
+
+        while (query.next()) {
+            QByteArray key = query.value(0).toByteArray();
+            if (query.value(1).toLongLong() <= current) {
+                expired << key;
+            } else {
+                values.insert(key, query.value(2).toByteArray());
+            }
+        }
+    }
+
+    if (!expired.isEmpty()) {
+        removeMulti(expired);
+    }
+    return values;
+}
+
+/*!
+  Writes the \a values with one delete and one multi-row insert per
+  MAX_ROWS_PER_STATEMENT keys, in the transaction of the request.
+ */
+bool TCacheSQLiteStore::setMulti(const QMap<QByteArray, QByteArray> &values, int seconds)
+{
+    if (seconds <= 0) {
+        return false;
+    }
+
+    const QByteArrayList keys = values.keys();
+    if (removeMulti(keys) < 0) {
+        return false;
+    }
+
+    qint64 expire = TClock::currentSecsSinceEpoch() + seconds;
+    bool ret = true;
+
+    for (int i = 0; i < keys.count(); i += MAX_ROWS_PER_STATEMENT) {
+        const QByteArrayList chunk = keys.mid(i, MAX_ROWS_PER_STATEMENT);
+        QString rows = QStringLiteral("(?,?,?),").repeated(chunk.count());
+        rows.chop(1);
+
+        TSqlQuery query(Tf::app()->databaseIdForCache());
+        query.prepare(QStringLiteral("insert into %1 (%2,%3,%4) values %5").arg(_table, KEY_COLUMN, TIMESTAMP_COLUMN, BLOB_COLUMN, rows));
+        for (auto &key : chunk) {
+            query.addBind(key).addBind(expire).addBind(values.value(key));
+        }
+
+        if (!query.exec()) {
+            tSystemError("SQLite error : %s [%s:%d]", qPrintable(lastErrorString()), __FILE__, __LINE__);
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+
+int TCacheSQLiteStore::removeMulti(const QByteArrayList &keys)
+{
+    int cnt = 0;
+
+    for (int i = 0; i < keys.count(); i += MAX_ROWS_PER_STATEMENT) {
+        const QByteArrayList chunk = keys.mid(i, MAX_ROWS_PER_STATEMENT);
+        QString params = QStringLiteral("?,").repeated(chunk.count());
+        params.chop(1);
+
+        TSqlQuery query(Tf::app()->databaseIdForCache());
+        query.prepare(QStringLiteral("delete from %1 where %2 in (%3)").arg(_table, KEY_COLUMN, params));
+        for (auto &key : chunk) {
+            query.addBind(key);
+        }
+
+        if (!query.exec()) {
+            tSystemError("SQLite error : %s [%s:%d]", qPrintable(lastErrorString()), __FILE__, __LINE__);
+            return -1;
+        }
+        cnt += query.numRowsAffected();
+    }
+    return cnt;
+}
+
+
 void TCacheSQLiteStore::clear()
 {
     removeAll();
@@ -292,7 +399,7 @@ qint64 TCacheSQLiteStore::dbSize()
 
 void TCacheSQLiteStore::gc()
 {
-    int removed = removeOlderThan(1 + QDateTime::currentMSecsSinceEpoch() / 1000);
+    int removed = removeOlderThan(1 + TClock::currentSecsSinceEpoch());
     tSystemDebug("removeOlderThan: %d\n", removed);
 }
 
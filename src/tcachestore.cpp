@@ -1 +1,58 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
 #include "tcachestore.h"
+
+/*!
+  \class TCacheStore
+  \brief The TCacheStore class is the abstract base class of the backends
+  of TCache.
+
+  The multi-key functions of this class process the keys one by one;
+  the backends override them to process the keys in one call.
+*/
+
+/*!
+  Returns the values of the \a keys found in the store, keyed by the keys.
+ */
+QMap<QByteArray, QByteArray> TCacheStore::getMulti(const QByteArrayList &keys)
+{
+    QMap<QByteArray, QByteArray> values;
+    for (auto &key : keys) {
+        QByteArray value = get(key);
+        if (!value.isNull()) {
+            values.insert(key, value);
+        }
+    }
+    return values;
+}
+
+/*!
+  Stores all the \a values with the timeout of \a seconds. Returns true
+  if all of them are stored.
+ */
+bool TCacheStore::setMulti(const QMap<QByteArray, QByteArray> &values, int seconds)
+{
+    bool ret = true;
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        ret &= set(it.key(), it.value(), seconds);
+    }
+    return ret;
+}
+
+/*!
+  Removes the items of the \a keys. Returns the number of the keys removed,
+  or -1 if unknown.
+ */
+int TCacheStore::removeMulti(const QByteArrayList &keys)
+{
+    int cnt = 0;
+    for (auto &key : keys) {
+        cnt += remove(key) ? 1 : 0;
+    }
+    return cnt;
+}
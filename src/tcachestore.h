@@ -1,5 +1,6 @@
 #pragma once
 #include <QByteArray>
+#include <QByteArrayList>
 #include <QMap>
 #include <QVariant>
 #include <TGlobal>
@@ -10,6 +11,7 @@ public:
     enum DbType {
         SQL,
         KVS,
+        Memory,  // memory of the process or the host
         Invalid,
     };
 
@@ -23,6 +25,11 @@ public:
     virtual bool remove(const QByteArray &key) = 0;
     virtual void clear() = 0;
     virtual void gc() = 0;
+    virtual QMap<QByteArray, QByteArray> getMulti(const QByteArrayList &keys);
+    virtual bool setMulti(const QMap<QByteArray, QByteArray> &values, int seconds);
+    virtual int removeMulti(const QByteArrayList &keys);
+    virtual bool lock(const QByteArray &, int) { return true; }  // lock among processes
+    virtual void unlock(const QByteArray &) { }
     virtual QMap<QString, QVariant> defaultSettings() const { return QMap<QString, QVariant>(); }
 };
 
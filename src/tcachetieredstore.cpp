@@ -0,0 +1,251 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tcachetieredstore.h"
+#include "tcachememorystore.h"
+#include "tpublisher.h"
+#include "tsystembus.h"
+#include "tsystemglobal.h"
+#include <TAppSettings>
+#include <QCoreApplication>
+#include <TWebApplication>
+#include <mutex>
+
+constexpr auto LOCAL_TABLE_NAME = "local";
+
+/*!
+  \class TCacheTieredStore
+  \brief The TCacheTieredStore class reads the items through a small
+  cache in the memory of the process (L1) to the cache store configured
+  as backend (L2), so that most reads are served in the process.
+
+  It is used when Cache.LocalCacheSize is set in application.ini.
+  Whenever an item is set or removed, the other server processes are
+  told over the system bus to drop the item from their L1. An item is
+  kept in L1 for Cache.LocalCacheTimeout seconds at most, which bounds
+  the staleness even if a notification is lost.
+*/
+
+namespace {
+
+int localCacheTimeout()
+{
+    static int timeout = qMax(Tf::appSettings()->value(Tf::CacheLocalCacheTimeout, 10).toInt(), 1);
+    return timeout;
+}
+
+}  // namespace
+
+
+TCacheTieredStore::TCacheTieredStore(TCacheStore *store) :
+    _local(new TCacheMemoryStore(LOCAL_TABLE_NAME)),
+    _store(store)
+{
+}
+
+
+TCacheTieredStore::~TCacheTieredStore()
+{
+    delete _local;
+    delete _store;
+}
+
+
+QString TCacheTieredStore::key() const
+{
+    return _store->key();
+}
+
+
+TCacheStore::DbType TCacheTieredStore::dbType() const
+{
+    return _store->dbType();
+}
+
+
+bool TCacheTieredStore::open()
+{
+    static std::once_flag once;
+    std::call_once(once, []() {
+        if (Tf::app()->maxNumberOfAppServers() > 1) {
+            TPublisher::instance();  // receives the notifications of the system bus
+        }
+    });
+
+    qint64 size = Tf::appSettings()->value(Tf::CacheLocalCacheSize).toLongLong() * 1024 * 1024;
+    return _local->open(size, -1) && _store->open();
+}
+
+
+void TCacheTieredStore::close()
+{
+    _store->close();
+    _local->close();
+}
+
+
+QByteArray TCacheTieredStore::get(const QByteArray &key)
+{
+    QByteArray value = _local->get(key);
+    if (value.isNull()) {
+        value = _store->get(key);
+        if (!value.isEmpty()) {
+            _local->set(key, value, localCacheTimeout());
+        }
+    }
+    return value;
+}
+
+
+bool TCacheTieredStore::set(const QByteArray &key, const QByteArray &value, int seconds)
+{
+    bool ret = _store->set(key, value, seconds);
+    if (ret) {
+        _local->set(key, value, qMin(seconds, localCacheTimeout()));
+    } else {
+        _local->remove(key);
+    }
+    broadcast(key);
+    return ret;
+}
+
+
+bool TCacheTieredStore::remove(const QByteArray &key)
+{
+    _local->remove(key);
+    broadcast(key);
+    return _store->remove(key);
+}
+
+
+void TCacheTieredStore::clear()
+{
+    _local->clear();
+    broadcast(QByteArray());
+    _store->clear();
+}
+
+
+void TCacheTieredStore::gc()
+{
+    _local->gc();
+    _store->gc();
+}
+
+
+QMap<QByteArray, QByteArray> TCacheTieredStore::getMulti(const QByteArrayList &keys)
+{
+    QMap<QByteArray, QByteArray> values;
+    QByteArrayList missed;
+
+    for (auto &key : keys) {
+        QByteArray value = _local->get(key);
+        if (value.isNull()) {
+            missed << key;
+        } else {
+            values.insert(key, value);
+        }
+    }
+
+    if (!missed.isEmpty()) {
+        const auto fetched = _store->getMulti(missed);
+        for (auto it = fetched.begin(); it != fetched.end(); ++it) {
+            if (!it.value().isEmpty()) {
+                _local->set(it.key(), it.value(), localCacheTimeout());
+            }
+            values.insert(it.key(), it.value());
+        }
+    }
+    return values;
+}
+
+
+bool TCacheTieredStore::setMulti(const QMap<QByteArray, QByteArray> &values, int seconds)
+{
+    bool ret = _store->setMulti(values, seconds);
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        if (ret) {
+            _local->set(it.key(), it.value(), qMin(seconds, localCacheTimeout()));
+        } else {
+            _local->remove(it.key());
+        }
+        broadcast(it.key());
+    }
+    return ret;
+}
+
+
+int TCacheTieredStore::removeMulti(const QByteArrayList &keys)
+{
+    for (auto &key : keys) {
+        _local->remove(key);
+        broadcast(key);
+    }
+    return _store->removeMulti(keys);
+}
+
+
+bool TCacheTieredStore::lock(const QByteArray &key, int seconds)
+{
+    return _store->lock(key, seconds);
+}
+
+
+void TCacheTieredStore::unlock(const QByteArray &key)
+{
+    _store->unlock(key);
+}
+
+
+QMap<QString, QVariant> TCacheTieredStore::defaultSettings() const
+{
+    return _store->defaultSettings();
+}
+
+/*!
+  Tells the other server processes to drop the item of the \a key from
+  their L1, or all the items if \a key is empty. The message carries the
+  process ID as its target, so that the sender can ignore it.
+ */
+void TCacheTieredStore::broadcast(const QByteArray &key)
+{
+    if (Tf::app()->maxNumberOfAppServers() > 1) {
+        TSystemBus::instance()->send(Tf::CacheInvalidate, QString::number(QCoreApplication::applicationPid()), key);
+    }
+}
+
+/*!
+  Returns true if the L1 cache is enabled in application.ini.
+ */
+bool TCacheTieredStore::isEnabled()
+{
+    static bool enabled = Tf::appSettings()->value(Tf::CacheLocalCacheSize).toInt() > 0;
+    return enabled;
+}
+
+/*!
+  Drops the item of the \a key from L1 of this process, or all the items
+  if \a key is empty; called on a notification of the system bus sent by
+  the process \a senderPid. The notifications of this process itself are
+  ignored, since its L1 already holds the new value.
+ */
+void TCacheTieredStore::invalidate(const QByteArray &key, qint64 senderPid)
+{
+    if (senderPid == QCoreApplication::applicationPid()) {
+        return;
+    }
+
+    TCacheMemoryStore local(LOCAL_TABLE_NAME);
+    qint64 size = Tf::appSettings()->value(Tf::CacheLocalCacheSize).toLongLong() * 1024 * 1024;
+    local.open(size, -1);
+
+    if (key.isEmpty()) {
+        local.clear();
+    } else {
+        local.remove(key);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "tcachestore.h"
+#include <TGlobal>
+
+class TCacheMemoryStore;
+
+
+class T_CORE_EXPORT TCacheTieredStore : public TCacheStore {
+public:
+    virtual ~TCacheTieredStore();
+
+    QString key() const override;
+    DbType dbType() const override;
+    bool open() override;
+    void close() override;
+
+    QByteArray get(const QByteArray &key) override;
+    bool set(const QByteArray &key, const QByteArray &value, int seconds) override;
+    bool remove(const QByteArray &key) override;
+    void clear() override;
+    void gc() override;
+    QMap<QByteArray, QByteArray> getMulti(const QByteArrayList &keys) override;
+    bool setMulti(const QMap<QByteArray, QByteArray> &values, int seconds) override;
+    int removeMulti(const QByteArrayList &keys) override;
+    bool lock(const QByteArray &key, int seconds) override;
+    void unlock(const QByteArray &key) override;
+    QMap<QString, QVariant> defaultSettings() const override;
+
+    static bool isEnabled();
+    static void invalidate(const QByteArray &key, qint64 senderPid);
+
+protected:
+    TCacheTieredStore(TCacheStore *store);
+    void broadcast(const QByteArray &key);
+
+private:
+    TCacheMemoryStore *_local {nullptr};  // L1
+    TCacheStore *_store {nullptr};  // L2
+
+    friend class TCacheFactory;
+    T_DISABLE_COPY(TCacheTieredStore)
+    T_DISABLE_MOVE(TCacheTieredStore)
+};
@@ -0,0 +1,213 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tclientcertificatecache.h"
+#include "tsystemglobal.h"
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+constexpr int MAX_ENTRIES = 1024;
+constexpr int MAX_COMMON_NAME_LENGTH = 64;  // upper bound of X.520
+
+/*!
+  \class TClientCertificateCache
+  \brief The TClientCertificateCache class keeps the client certificates
+  of certificate-authenticated users in memory.
+
+  A certificate received in a request header is parsed only when it
+  differs from the one seen before, detected by its SHA-256 fingerprint.
+  The PEM file needed by the SQL driver is written only when a connection
+  is about to be opened, and only if the certificate has changed since
+  the file was written.
+
+  The common names come from the clients, so at most 1024 certificates
+  are kept; the least recently used one is dropped from memory beyond
+  that, leaving its file as it is.
+*/
+
+/*!
+  Returns true if the \a commonName can be used as a component of a file
+  name: not empty, up to 64 characters, neither "." nor "..", and without
+  path separators or control characters.
+ */
+bool TClientCertificateCache::isValidCommonName(const QString &commonName)
+{
+    if (commonName.isEmpty() || commonName.length() > MAX_COMMON_NAME_LENGTH
+        || commonName == QLatin1String(".") || commonName == QLatin1String("..")) {
+        return false;
+    }
+
+    for (const QChar &c : commonName) {
+        if (c == QLatin1Char('/') || c == QLatin1Char('\\') || c == QLatin1Char(':') || c.category() == QChar::Other_Control) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+  Returns the path of the certificate file of the user \a commonName,
+  which is passed to the SQL driver, or an empty string if the
+  \a commonName is not valid.
+  \sa isValidCommonName()
+ */
+QString TClientCertificateCache::certificatePath(const QString &certDir, const QString &commonName)
+{
+    if (!isValidCommonName(commonName)) {
+        return QString();
+    }
+    return certDir + QLatin1Char('/') + commonName + QLatin1String("_crt.pem");
+}
+
+/*!
+  Registers the base64-encoded DER certificate \a encodedCertificate for
+  the file \a certPath. If \a encodedCertificate is empty, the certificate
+  registered before or the existing file is used. Returns false if no
+  valid certificate is available.
+ */
+bool TClientCertificateCache::update(const QString &certPath, const QByteArray &encodedCertificate)
+{
+    if (certPath.isEmpty()) {
+        return false;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        auto it = index.constFind(certPath);
+        if (it != index.constEnd()) {
+            if (encodedCertificate.isEmpty() || it.value()->encoded == encodedCertificate) {
+                touch(it.value());
+                return true;  // unchanged
+            }
+        } else if (encodedCertificate.isEmpty()) {
+            return QFileInfo::exists(certPath);
+        }
+    }
+
+    QByteArray der = QByteArray::fromBase64(encodedCertificate);
+    if (der.isEmpty()) {
+        return false;
+    }
+
+    QByteArray fingerprint = QCryptographicHash::hash(der, QCryptographicHash::Sha256);
+    std::shared_ptr<X509> certificate;
+    {
+        QMutexLocker locker(&mutex);
+        auto it = index.constFind(certPath);
+        if (it != index.constEnd() && it.value()->fingerprint == fingerprint) {
+            it.value()->encoded = encodedCertificate;
+            touch(it.value());
+            return true;
+        }
+    }
+
+    // Parses outside of the lock
+    const auto *data = (const unsigned char *)der.constData();
+    X509 *x509 = d2i_X509(nullptr, &data, der.length());
+    if (!x509) {
+        tSystemError("Invalid client certificate: %s", qPrintable(certPath));
+        return false;
+    }
+    certificate = std::shared_ptr<X509>(x509, X509_free);
+
+    QMutexLocker locker(&mutex);
+    auto it = index.constFind(certPath);
+    if (it == index.constEnd()) {
+        lru.push_front(Entry {certPath, QByteArray(), QByteArray(), QByteArray(), nullptr});
+        it = index.insert(certPath, lru.begin());
+
+        // Drops the least recently used ones
+        while ((int)lru.size() > MAX_ENTRIES) {
+            index.remove(lru.back().certPath);
+            lru.pop_back();
+        }
+    } else {
+        touch(it.value());
+    }
+
+    Entry &entry = lru.front();
+    entry.encoded = encodedCertificate;
+    entry.fingerprint = fingerprint;
+    entry.certificate = certificate;
+    tSystemDebug("Client certificate updated: %s", qPrintable(certPath));
+    return true;
+}
+
+/*!
+  Writes the certificate registered for \a certPath to the file in PEM
+  format unless the file already holds it. Returns true if the file is
+  up to date.
+ */
+bool TClientCertificateCache::writeFile(const QString &certPath)
+{
+    if (certPath.isEmpty()) {
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    auto it = index.constFind(certPath);
+    if (it == index.constEnd()) {
+        return QFileInfo::exists(certPath);
+    }
+
+    Entry &entry = *it.value();
+    if (entry.writtenFingerprint == entry.fingerprint && QFileInfo::exists(certPath)) {
+        return true;
+    }
+
+    BIO *bio = BIO_new(BIO_s_mem());
+    if (!bio || PEM_write_bio_X509(bio, entry.certificate.get()) == 0) {
+        tSystemError("PEM_write_bio_X509 failed: %s", qPrintable(certPath));
+        BIO_free(bio);
+        return false;
+    }
+
+    char *pem = nullptr;
+    long len = BIO_get_mem_data(bio, &pem);
+
+    // Replaces the file atomically; the driver may be reading it
+    QSaveFile file(certPath);
+    bool res = file.open(QIODevice::WriteOnly) && file.write(pem, len) == len && file.commit();
+    BIO_free(bio);
+
+    if (res) {
+        entry.writtenFingerprint = entry.fingerprint;
+        tSystemDebug("Certificate file written: %s", qPrintable(certPath));
+    } else {
+        tSystemError("Failed to write certificate file: %s", qPrintable(certPath));
+    }
+    return res;
+}
+
+/*!
+  Returns the number of the certificates kept in memory.
+ */
+int TClientCertificateCache::count() const
+{
+    QMutexLocker locker(&mutex);
+    return (int)lru.size();
+}
+
+/*!
+  Marks the entry at \a it as most recently used. The lock must be held.
+ */
+void TClientCertificateCache::touch(std::list<Entry>::iterator it)
+{
+    lru.splice(lru.begin(), lru, it);
+}
+
+
+TClientCertificateCache &TClientCertificateCache::instance()
+{
+    static TClientCertificateCache cache;
+    return cache;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <TGlobal>
+#include <list>
+#include <memory>
+
+typedef struct x509_st X509;
+
+
+class T_CORE_EXPORT TClientCertificateCache {
+public:
+    bool update(const QString &certPath, const QByteArray &encodedCertificate);
+    bool writeFile(const QString &certPath);
+
+    int count() const;
+
+    static bool isValidCommonName(const QString &commonName);
+    static QString certificatePath(const QString &certDir, const QString &commonName);
+    static TClientCertificateCache &instance();
+
+private:
+    struct Entry {
+        QString certPath;
+        QByteArray encoded;  // as received in the header
+        QByteArray fingerprint;
+        QByteArray writtenFingerprint;  // of the file on disk
+        std::shared_ptr<X509> certificate;
+    };
+
+    TClientCertificateCache() { }
+    void touch(std::list<Entry>::iterator it);
+
+    mutable QMutex mutex;
+    std::list<Entry> lru;  // most recently used first
+    QHash<QString, std::list<Entry>::iterator> index;  // keyed by certificate path
+
+    T_DISABLE_COPY(TClientCertificateCache)
+    T_DISABLE_MOVE(TClientCertificateCache)
+};
@@ -0,0 +1,215 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tclock.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
+
+/*!
+  \class TClock
+  \brief The TClock class provides a coarse clock whose values are
+  cached, so that time-zone conversion and date formatting are done at
+  most once per second for the whole process.
+
+  The clock is refreshed by tick(), which the multiplexing server calls
+  on every turn of its event loop. While nothing ticks, e.g. in the
+  thread server model, each read refreshes the clock by itself.
+*/
+
+namespace {
+// Formatted values of a second. A slot is overwritten SLOT_COUNT seconds
+// after it was published, so readers may copy from it without locking.
+constexpr int SLOT_COUNT = 64;
+
+struct ClockSlot {
+    qint64 secs {-1};
+    QDateTime localTime;
+    QByteArray httpDate;
+    QByteArray isoDate;
+};
+
+ClockSlot clockSlots[SLOT_COUNT];
+std::atomic<int> currentSlot {0};
+std::atomic<qint64> wallMSecs {0};
+std::atomic<qint64> monoMSecs {0};
+std::atomic<bool> tickDriven {false};
+QMutex updateMutex;
+
+
+QByteArray formatHttpDate(qint64 secs)
+{
+    static const char *DAY[] = {"Mon, ", "Tue, ", "Wed, ", "Thu, ", "Fri, ", "Sat, ", "Sun, "};
+    static const char *MONTH[] = {"Jan ", "Feb ", "Mar ", "Apr ", "May ", "Jun ", "Jul ", "Aug ", "Sep ", "Oct ", "Nov ", "Dec "};
+
+    const QDateTime utc = QDateTime::fromSecsSinceEpoch(secs, Qt::UTC);
+    const QDate date = utc.date();
+    const QTime time = utc.time();
+
+    QByteArray str;
+    str.reserve(30);
+    str += DAY[date.dayOfWeek() - 1];
+    str += QByteArray::number(date.day()).rightJustified(2, '0');
+    str += ' ';
+    str += MONTH[date.month() - 1];
+    str += QByteArray::number(date.year());
+    str += ' ';
+    str += QByteArray::number(time.hour()).rightJustified(2, '0');
+    str += ':';
+    str += QByteArray::number(time.minute()).rightJustified(2, '0');
+    str += ':';
+    str += QByteArray::number(time.second()).rightJustified(2, '0');
+    str += " GMT";
+    return str;
+}
+
+
+inline void refresh()
+{
+    if (!tickDriven.load(std::memory_order_relaxed)) {
+        TClock::update();
+    }
+}
+
+
+inline const ClockSlot &slot()
+{
+    refresh();
+    return clockSlots[currentSlot.load(std::memory_order_acquire)];
+}
+}
+
+/*!
+  Refreshes the clock; formats the dates again if the second has changed.
+ */
+void TClock::update()
+{
+    static const QElapsedTimer monotonicTimer = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+
+    qint64 msecs = QDateTime::currentMSecsSinceEpoch();  // no time-zone conversion
+    wallMSecs.store(msecs, std::memory_order_relaxed);
+    monoMSecs.store(monotonicTimer.msecsSinceReference(), std::memory_order_relaxed);
+
+    qint64 secs = msecs / 1000;
+    qint64 current = clockSlots[currentSlot.load(std::memory_order_acquire)].secs;
+    if (current == secs) {
+        return;
+    }
+
+    // Another thread formatting the same second is good enough, unless
+    // nothing has been published yet
+    if (current < 0) {
+        updateMutex.lock();
+    } else if (!updateMutex.tryLock()) {
+        return;
+    }
+
+    {
+        int idx = currentSlot.load(std::memory_order_relaxed);
+        if (clockSlots[idx].secs != secs) {
+            idx = (idx + 1) % SLOT_COUNT;
+            auto &next = clockSlots[idx];
+            next.secs = secs;
+            next.localTime = QDateTime::fromSecsSinceEpoch(secs);
+            next.httpDate = formatHttpDate(secs);
+            next.isoDate = next.localTime.toString(Qt::ISODate).toLatin1();
+            currentSlot.store(idx, std::memory_order_release);
+        }
+        updateMutex.unlock();
+    }
+}
+
+/*!
+  Refreshes the clock from the event loop. Once called, readers rely on
+  the ticks instead of refreshing the clock by themselves.
+ */
+void TClock::tick()
+{
+    update();
+    tickDriven.store(true, std::memory_order_relaxed);
+}
+
+/*!
+  Returns the number of milliseconds since the epoch, as of the last tick.
+ */
+qint64 TClock::currentMSecsSinceEpoch()
+{
+    refresh();
+    return wallMSecs.load(std::memory_order_relaxed);
+}
+
+/*!
+  Returns the number of seconds since the epoch, as of the last tick.
+ */
+qint64 TClock::currentSecsSinceEpoch()
+{
+    return currentMSecsSinceEpoch() / 1000;
+}
+
+/*!
+  Returns the current local date and time with a resolution of a second.
+ */
+QDateTime TClock::currentDateTime()
+{
+    return slot().localTime;
+}
+
+/*!
+  Returns the current local date and time with a resolution of a
+  millisecond, as of the last tick, for date-time formats showing the
+  milliseconds. It is converted at most once per millisecond and thread.
+ */
+QDateTime TClock::currentDateTimeMSecs()
+{
+    thread_local qint64 lastMSecs = -1;
+    thread_local QDateTime lastDateTime;
+
+    qint64 msecs = currentMSecsSinceEpoch();
+    if (msecs != lastMSecs) {
+        lastMSecs = msecs;
+        lastDateTime = QDateTime::fromMSecsSinceEpoch(msecs);
+    }
+    return lastDateTime;
+}
+
+/*!
+  Returns the milliseconds of a monotonic clock, for measuring intervals.
+ */
+qint64 TClock::monotonicMSecs()
+{
+    refresh();
+    return monoMSecs.load(std::memory_order_relaxed);
+}
+
+/*!
+  Returns the seconds of a monotonic clock, for tracking idle time.
+ */
+qint64 TClock::monotonicSecs()
+{
+    return monotonicMSecs() / 1000;
+}
+
+/*!
+  Returns the current date in the format of the HTTP Date header,
+  e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+ */
+QByteArray TClock::httpDate()
+{
+    return slot().httpDate;
+}
+
+/*!
+  Returns the current local date and time in ISO 8601 format.
+ */
+QByteArray TClock::isoDate()
+{
+    return slot().isoDate;
+}
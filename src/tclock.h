@@ -0,0 +1,23 @@
+#pragma once
+#include <QByteArray>
+#include <QDateTime>
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TClock {
+public:
+    static qint64 currentMSecsSinceEpoch();
+    static qint64 currentSecsSinceEpoch();
+    static QDateTime currentDateTime();
+    static QDateTime currentDateTimeMSecs();
+    static qint64 monotonicMSecs();
+    static qint64 monotonicSecs();
+    static QByteArray httpDate();
+    static QByteArray isoDate();
+
+    static void tick();
+    static void update();
+
+private:
+    TClock() = delete;
+};
@@ -84,6 +84,7 @@ public:
     TCriteriaConverter(const TCriteria &cri, const QSqlDatabase &db, const QString &aliasTableName = QString()) :
         criteria(cri), database(db), tableAlias(aliasTableName) { }
     QString toString() const;
+    QString toString(QVariantList &bindValues) const;
     QVariant::Type variantType(int property) const;
     QString propertyName(int property, const QSqlDriver *driver, const QString &aliasTableName = QString()) const;
     static QString getPropertyName(int property, const QSqlDriver *driver, const QString &aliasTableName = QString());
@@ -91,15 +92,18 @@ public:
 protected:
     static QString getPropertyName(const QMetaObject *metaObject, int property, const QSqlDriver *driver, const QString &aliasTableName);
     QString criteriaToString(const QVariant &cri) const;
-    static QString criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op, const QVariant &val1, const QVariant &val2, const QSqlDatabase &database);
-    static QString criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op1, TSql::ComparisonOperator op2, const QVariant &val, const QSqlDatabase &database);
+    static QString criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op, const QVariant &val1, const QVariant &val2, const QSqlDatabase &database, QVariantList *binds = nullptr);
+    static QString criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op1, TSql::ComparisonOperator op2, const QVariant &val, const QSqlDatabase &database, QVariantList *binds = nullptr);
     static QString concat(const QString &s1, TCriteria::LogicalOperator op, const QString &s2);
+    static QString formatValue(const QVariant &val, QVariant::Type varType, const QSqlDatabase &database, QVariantList *binds);
+    static QVariant bindValue(const QVariant &val, QVariant::Type varType);
 
 private:
     T obj;
     TCriteria criteria;
     QSqlDatabase database;
     QString tableAlias;
+    mutable QVariantList *binds {nullptr};  // placeholders are generated if set
 };
 
 
@@ -109,6 +113,21 @@ inline QString TCriteriaConverter<T>::toString() const
     return criteriaToString(QVariant::fromValue(criteria));
 }
 
+/*!
+  Returns the SQL WHERE clause with placeholders, and appends the values
+  to bind to \a bindValues. Criteria differing only in values generate
+  the same SQL, which is their shape, so that the prepared statement is
+  reused through the statement cache.
+*/
+template <class T>
+inline QString TCriteriaConverter<T>::toString(QVariantList &bindValues) const
+{
+    binds = &bindValues;
+    QString sql = criteriaToString(QVariant::fromValue(criteria));
+    binds = nullptr;
+    return sql;
+}
+
 
 template <class T>
 inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var) const
@@ -125,8 +144,10 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var) cons
         if (cri.isEmpty()) {
             return QString();
         }
-        sqlString = concat(criteriaToString(cri.first()), cri.logicalOperator(),
-            criteriaToString(cri.second()));
+        QString s1 = criteriaToString(cri.first());
+        auto op = cri.logicalOperator();
+        QString s2 = (op == TCriteria::None || op == TCriteria::Not) ? QString() : criteriaToString(cri.second());
+        sqlString = concat(s1, op, s2);
 
     } else if (var.canConvert<TCriteriaData>()) {
         TCriteriaData cri = var.value<TCriteriaData>();
@@ -141,10 +162,10 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var) cons
         }
 
         if (cri.op1 != TSql::Invalid && cri.op2 != TSql::Invalid && !cri.val1.isNull()) {
-            sqlString += criteriaToString(name, cri.varType, (TSql::ComparisonOperator)cri.op1, (TSql::ComparisonOperator)cri.op2, cri.val1, database);
+            sqlString += criteriaToString(name, cri.varType, (TSql::ComparisonOperator)cri.op1, (TSql::ComparisonOperator)cri.op2, cri.val1, database, binds);
 
         } else if (cri.op1 != TSql::Invalid && !cri.val1.isNull() && !cri.val2.isNull()) {
-            sqlString += criteriaToString(name, cri.varType, (TSql::ComparisonOperator)cri.op1, cri.val1, cri.val2, database);
+            sqlString += criteriaToString(name, cri.varType, (TSql::ComparisonOperator)cri.op1, cri.val1, cri.val2, database, binds);
 
         } else if (cri.op1 != TSql::Invalid) {
             switch (cri.op1) {
@@ -158,13 +179,13 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var) cons
             case TSql::NotLike:
             case TSql::ILike:
             case TSql::NotILike:
-                sqlString += name + TSql::formatArg(cri.op1, TSqlQuery::formatValue(cri.val1, cri.varType, database));
+                sqlString += name + TSql::formatArg(cri.op1, formatValue(cri.val1, cri.varType, database, binds));
                 break;
 
             case TSql::BeginsWith: 
             case TSql::IBeginsWith: {
                 QVariant bwv(cri.val1.toString() + "%");
-                sqlString += name + TSql::formatArg(cri.op1, TSqlQuery::formatValue(bwv, cri.varType, database));
+                sqlString += name + TSql::formatArg(cri.op1, formatValue(bwv, cri.varType, database, binds));
                 }
                 break;
 
@@ -173,14 +194,14 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var) cons
             case TSql::IContains: 
             case TSql::INotContains: {
                 QVariant bwv("%" + cri.val1.toString() + "%");
-                sqlString += name + TSql::formatArg(cri.op1, TSqlQuery::formatValue(bwv, cri.varType, database));
+                sqlString += name + TSql::formatArg(cri.op1, formatValue(bwv, cri.varType, database, binds));
                 }
                 break;
 
             case TSql::EndsWith: 
             case TSql::IEndsWith: {
                 QVariant ewv("%" + cri.val1.toString());
-                sqlString += name + TSql::formatArg(cri.op1, TSqlQuery::formatValue(ewv, cri.varType, database));
+                sqlString += name + TSql::formatArg(cri.op1, formatValue(ewv, cri.varType, database, binds));
                 }
                 break;
 
@@ -191,7 +212,7 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var) cons
                     length = qMin(length, lst.count() - pos);
                     for (int i = 0; i < length; i++) {
                         auto &v = lst[pos + i];
-                        QString s = TSqlQuery::formatValue(v, cri.varType, database);
+                        QString s = formatValue(v, cri.varType, database, binds);
                         if (!s.isEmpty()) {
                             str.append(s).append(',');
                         }
@@ -241,7 +262,7 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var) cons
             case TSql::NotBetween: {
                 QList<QVariant> lst = cri.val1.toList();
                 if (lst.count() == 2) {
-                    sqlString += criteriaToString(name, cri.varType, (TSql::ComparisonOperator)cri.op1, lst[0], lst[1], database);
+                    sqlString += criteriaToString(name, cri.varType, (TSql::ComparisonOperator)cri.op1, lst[0], lst[1], database, binds);
                 }
                 break;
             }
@@ -316,39 +337,40 @@ inline QVariant::Type TCriteriaConverter<T>::variantType(int property) const
 
 
 template <class T>
-inline QString TCriteriaConverter<T>::criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op, const QVariant &val1, const QVariant &val2, const QSqlDatabase &database)
+inline QString TCriteriaConverter<T>::criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op, const QVariant &val1, const QVariant &val2, const QSqlDatabase &database, QVariantList *binds)
 {
     QString sqlString;
-    QString v1 = TSqlQuery::formatValue(val1, (QVariant::Type)varType, database);
-    QString v2 = TSqlQuery::formatValue(val2, (QVariant::Type)varType, database);
-
-    if (!v1.isEmpty() && !v2.isEmpty()) {
-        switch (op) {
-        case TSql::LikeEscape:
-        case TSql::NotLikeEscape:
-        case TSql::ILikeEscape:
-        case TSql::NotILikeEscape:
-        case TSql::Between:
-        case TSql::NotBetween:
+
+    switch (op) {
+    case TSql::LikeEscape:
+    case TSql::NotLikeEscape:
+    case TSql::ILikeEscape:
+    case TSql::NotILikeEscape:
+    case TSql::Between:
+    case TSql::NotBetween: {
+        QString v1 = formatValue(val1, varType, database, binds);
+        QString v2 = formatValue(val2, varType, database, binds);
+        if (!v1.isEmpty() && !v2.isEmpty()) {
             sqlString = QLatin1Char('(');
             sqlString += propertyName;
             sqlString += TSql::formatArg(op, v1, v2);
             sqlString += QLatin1Char(')');
-            break;
-
-        default:
+        } else {
             tWarn("Invalid parameters  [%s:%d]", __FILE__, __LINE__);
-            break;
         }
-    } else {
+        break;
+    }
+
+    default:
         tWarn("Invalid parameters  [%s:%d]", __FILE__, __LINE__);
+        break;
     }
     return sqlString;
 }
 
 
 template <class T>
-inline QString TCriteriaConverter<T>::criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op1, TSql::ComparisonOperator op2, const QVariant &val, const QSqlDatabase &database)
+inline QString TCriteriaConverter<T>::criteriaToString(const QString &propertyName, QVariant::Type varType, TSql::ComparisonOperator op1, TSql::ComparisonOperator op2, const QVariant &val, const QSqlDatabase &database, QVariantList *binds)
 {
     QString sqlString;
     if (op1 != TSql::Invalid && op2 != TSql::Invalid && !val.isNull()) {
@@ -358,7 +380,7 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QString &propertyNa
             QString str;
             const QList<QVariant> lst = val.toList();
             for (auto &v : lst) {
-                QString s = TSqlQuery::formatValue(v, varType, database);
+                QString s = formatValue(v, varType, database, binds);
                 if (!s.isEmpty()) {
                     str.append(s).append(',');
                 }
@@ -411,3 +433,29 @@ inline QString TCriteriaConverter<T>::concat(const QString &s1, TCriteria::Logic
     return string;
 }
 
+
+/*!
+  Returns a string representation of the value \a val, or a placeholder
+  if \a binds is not null, in which case the value is appended to it.
+*/
+template <class T>
+inline QString TCriteriaConverter<T>::formatValue(const QVariant &val, QVariant::Type varType, const QSqlDatabase &database, QVariantList *binds)
+{
+    if (binds) {
+        *binds << bindValue(val, varType);
+        return QStringLiteral("?");
+    }
+    return TSqlQuery::formatValue(val, varType, database);
+}
+
+
+template <class T>
+inline QVariant TCriteriaConverter<T>::bindValue(const QVariant &val, QVariant::Type varType)
+{
+    if (varType == QVariant::Invalid || val.type() == varType) {
+        return val;
+    }
+
+    QVariant v = val;
+    return v.convert(varType) ? v : val;
+}
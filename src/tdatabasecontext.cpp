@@ -5,8 +5,11 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclientcertificatecache.h"
+#include "tclock.h"
 #include "tdatabasecontext.h"
 #include "tkvsdatabasepool.h"
+#include "tsettingssnapshot.h"
 #include "tsqldatabasepool.h"
 #include "tsystemglobal.h"
 #include <QSqlDatabase>
@@ -14,7 +17,6 @@
 #include <QtCore>
 #include <TKvsDriver>
 #include <TWebApplication>
-#include <ctime>
 
 namespace {
 // Stores a pointer to current database context into TLS
@@ -42,9 +44,14 @@ TDatabaseContext::~TDatabaseContext()
 }
 
 
+/*!
+  Returns the connection of the database \a id for the current context.
+  The connection is checked out of the pool and its transaction begun on
+  the first call only, so that the databases not used by an action cost
+  nothing.
+ */
 QSqlDatabase &TDatabaseContext::getSqlDatabase(int id)
 {
-    tSystemDebug("TDatabaseContext::getSqlDatabase: %d" , id);
     if (id < 0) {
         return invalidDb;  // invalid database
     }
@@ -54,18 +61,35 @@ QSqlDatabase &TDatabaseContext::getSqlDatabase(int id)
     }
 
     TSqlTransaction &tx = sqlDatabases[id];
-    tSystemDebug("tx.commonName: %s", tx.commonName().toStdString().c_str());
-
     QSqlDatabase &db = tx.tdatabase().sqlDatabase();
 
-    if (db.isValid() && tx.isActive()) {
+    if (Q_LIKELY(db.isValid())) {
+        // Checked out and begun already
+        idleElapsed = TClock::monotonicSecs();
         return db;
     }
 
+    tSystemDebug("TDatabaseContext::getSqlDatabase: %d  commonName: %s", id, qPrintable(tx.commonName()));
+    primaryUsed.insert(id);
+
+    if (!tx.commonName().isEmpty()) {
+        // The common name from the header names the certificate file
+        if (Q_UNLIKELY(!TClientCertificateCache::isValidCommonName(tx.commonName()))) {
+            tSystemError("Invalid common name: %s", qPrintable(tx.commonName()));
+            return db;
+        }
+
+        // Registers the certificate of the request for the user connection
+        QString certPath = TClientCertificateCache::certificatePath(TSettingsSnapshot::current().sqlDatabase(id).certDir, tx.commonName());
+        if (Q_UNLIKELY(!TClientCertificateCache::instance().update(certPath, userCertificates.value(id)))) {
+            tSystemError("Invalid client certificate: %s", qPrintable(certPath));
+            return db;
+        }
+    }
+
     int n = 0;
     do {
-        tSystemDebug("n: %d valid: %d", n, db.isValid());
-        if (! db.isValid()) {
+        if (!db.isValid()) {
             db = TSqlDatabasePool::instance()->x_database(id, tx.commonName());
         }
 
@@ -74,17 +98,67 @@ QSqlDatabase &TDatabaseContext::getSqlDatabase(int id)
         }
         TSqlDatabasePool::instance()->pool(db, true);
     } while (++n < 2);  // try two times
-    tSystemDebug("getSqlDatabase loop exited");
 
-    idleElapsed = (uint)std::time(nullptr);
+    idleElapsed = TClock::monotonicSecs();
     return db;
 }
 
 
+/*!
+  Returns a connection of the database \a id for reading. If read replicas
+  are configured, a replica is checked out on the first call, unless the
+  \a preference is Tf::ReadPrimary, or it is Tf::ReadAuto and the primary
+  has been used in the request; in that case the reads go to the primary,
+  so that they see the writes and the transaction. Falls back to the
+  primary if no replica is available.
+ */
+QSqlDatabase &TDatabaseContext::getReadSqlDatabase(int id, Tf::ReadPreference preference)
+{
+    if (preference == Tf::ReadPrimary || !TSqlDatabasePool::instance()->hasReplicas(id)) {
+        return getSqlDatabase(id);
+    }
+
+    if (preference == Tf::ReadAuto && primaryUsed.contains(id)) {
+        return getSqlDatabase(id);
+    }
+
+    QSqlDatabase &db = replicaDatabases[id];
+    if (!db.isValid()) {
+        db = TSqlDatabasePool::instance()->replicaDatabase(id);
+        if (Q_UNLIKELY(!db.isValid())) {
+            return getSqlDatabase(id);
+        }
+        tSystemDebug("Replica database: %s", qPrintable(db.connectionName()));
+    }
+
+    idleElapsed = TClock::monotonicSecs();
+    return db;
+}
+
+/*!
+  Lets the reads of the next request go to the replicas again.
+ */
+void TDatabaseContext::resetReadRouting()
+{
+    primaryUsed.clear();
+}
+
+
+void TDatabaseContext::releaseReplicaDatabases()
+{
+    for (auto it = replicaDatabases.begin(); it != replicaDatabases.end(); ++it) {
+        TSqlDatabasePool::instance()->pool(it.value());
+    }
+    replicaDatabases.clear();
+}
+
+
 void TDatabaseContext::releaseSqlDatabases()
 {
     rollbackTransactions();
     sqlDatabases.clear();
+    userCertificates.clear();
+    primaryUsed.clear();
 }
 
 
@@ -95,7 +169,7 @@ TKvsDatabase &TDatabaseContext::getKvsDatabase(Tf::KvsEngine engine)
         db = TKvsDatabasePool::instance()->database(engine);
     }
 
-    idleElapsed = (uint)std::time(nullptr);
+    idleElapsed = TClock::monotonicSecs();
     return db;
 }
 
@@ -117,7 +191,7 @@ void TDatabaseContext::release()
     // Releases all KVS database sessions
     releaseKvsDatabases();
 
-    idleElapsed = 0;
+    idleElapsed = -1;
 }
 
 
@@ -135,13 +209,26 @@ void TDatabaseContext::setTransactionEnabled(bool enable, int id, const QString
     return sqlDatabases[id].setEnabled(enable);
 }
 
+/*!
+  Sets the client certificate \a encodedCertificate of the request for the
+  user connection of the database \a id. The certificate is registered
+  when the database is used first.
+ */
+void TDatabaseContext::setUserCertificate(int id, const QByteArray &encodedCertificate)
+{
+    userCertificates.insert(id, encodedCertificate);
+}
+
 void TDatabaseContext::commitTransactions()
 {
     for (QMap<int, TSqlTransaction>::iterator it = sqlDatabases.begin(); it != sqlDatabases.end(); ++it) {
         TSqlTransaction &tx = it.value();
-        tx.commit();
-        TSqlDatabasePool::instance()->pool(tx.tdatabase().sqlDatabase());
+        if (tx.tdatabase().sqlDatabase().isValid()) {  // used in this request
+            tx.commit();
+            TSqlDatabasePool::instance()->pool(tx.tdatabase().sqlDatabase());
+        }
     }
+    releaseReplicaDatabases();
 }
 
 
@@ -165,9 +252,12 @@ void TDatabaseContext::rollbackTransactions()
 {
     for (QMap<int, TSqlTransaction>::iterator it = sqlDatabases.begin(); it != sqlDatabases.end(); ++it) {
         TSqlTransaction &tx = it.value();
-        tx.rollback();
-        TSqlDatabasePool::instance()->pool(tx.tdatabase().sqlDatabase(), true);
+        if (tx.tdatabase().sqlDatabase().isValid()) {  // used in this request
+            tx.rollback();
+            TSqlDatabasePool::instance()->pool(tx.tdatabase().sqlDatabase(), true);
+        }
     }
+    releaseReplicaDatabases();
 }
 
 
@@ -187,7 +277,7 @@ bool TDatabaseContext::rollbackTransaction(int id)
 
 int TDatabaseContext::idleTime() const
 {
-    return (idleElapsed > 0) ? (uint)std::time(nullptr) - idleElapsed : -1;
+    return (idleElapsed >= 0) ? (int)(TClock::monotonicSecs() - idleElapsed) : -1;
 }
 
 
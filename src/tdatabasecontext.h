@@ -1,5 +1,6 @@
 #pragma once
 #include <QMap>
+#include <QSet>
 #include <QSqlDatabase>
 #include <TGlobal>
 #include <TKvsDatabase>
@@ -12,14 +13,17 @@ public:
     virtual ~TDatabaseContext();
 
     QSqlDatabase &getSqlDatabase(int id = 0);
+    QSqlDatabase &getReadSqlDatabase(int id = 0, Tf::ReadPreference preference = Tf::ReadAuto);
     TKvsDatabase &getKvsDatabase(Tf::KvsEngine engine);
 
     void setTransactionEnabled(bool enable, int id = 0, const QString &commonName = "");
+    void setUserCertificate(int id, const QByteArray &encodedCertificate);
     void release();
     void commitTransactions();
     bool commitTransaction(int id = 0);
     void rollbackTransactions();
     bool rollbackTransaction(int id = 0);
+    void resetReadRouting();
     int idleTime() const;
     static TDatabaseContext *currentDatabaseContext();
     static void setCurrentDatabaseContext(TDatabaseContext *context);
@@ -27,12 +31,16 @@ public:
 protected:
     void releaseKvsDatabases();
     void releaseSqlDatabases();
+    void releaseReplicaDatabases();
 
     QMap<int, TSqlTransaction> sqlDatabases;
     QMap<int, TKvsDatabase> kvsDatabases;
+    QMap<int, QByteArray> userCertificates;  // registered on first use
+    QMap<int, QSqlDatabase> replicaDatabases;
+    QSet<int> primaryUsed;  // reads go to the primary for the rest of the request
 
 private:
-    uint idleElapsed {0};
+    qint64 idleElapsed {-1};  // -1: not in use
 
     T_DISABLE_COPY(TDatabaseContext)
     T_DISABLE_MOVE(TDatabaseContext)
@@ -6,6 +6,7 @@
  */
 
 #include "tbasiclogstream.h"
+#include "tclock.h"
 #include "tloggerfactory.h"
 #include "tsystemglobal.h"
 #include <TAppSettings>
@@ -28,6 +29,18 @@
 namespace {
 TAbstractLogStream *stream = nullptr;
 QList<TLogger *> loggers;
+int threshold = -1;  // no logger
+bool msecsTimestamp = false;  // shown by any of the loggers
+
+
+TLog createLog(int priority, const QByteArray &message)
+{
+    TLog log(priority, message);
+    if (msecsTimestamp) {
+        log.timestamp = TClock::currentDateTimeMSecs();
+    }
+    return log;
+}
 }
 
 /*!
@@ -42,6 +55,8 @@ void Tf::setupAppLoggers()
         TLogger *lgr = TLoggerFactory::create(lg);
         if (lgr) {
             loggers << lgr;
+            threshold = qMax(threshold, (int)lgr->threshold());
+            msecsTimestamp = msecsTimestamp || lgr->dateTimeFormat().contains('z');
             tSystemDebug("Logger added: %s", qPrintable(lgr->key()));
         }
     }
@@ -59,6 +74,8 @@ void Tf::releaseAppLoggers()
 {
     delete stream;
     stream = nullptr;
+    threshold = -1;
+    msecsTimestamp = false;
 
     for (auto &logger : (const QList<TLogger *> &)loggers) {
         delete logger;
@@ -66,11 +83,21 @@ void Tf::releaseAppLoggers()
     loggers.clear();
 }
 
+/*!
+  Returns the least severe priority output by any of the loggers, or -1
+  if no logger is set up. The tDebug() family of macros checks it before
+  evaluating their arguments.
+*/
+int Tf::appLogThreshold() noexcept
+{
+    return threshold;
+}
+
 
 static void tMessage(int priority, const char *msg, va_list ap)
 {
     if (stream) {
-        TLog log(priority, QString().vsprintf(msg, ap).toLocal8Bit());
+        TLog log = createLog(priority, QString().vsprintf(msg, ap).toLocal8Bit());
         stream->writeLog(log);
     }
 }
@@ -87,8 +114,8 @@ static void tFlushMessage()
 TDebug::~TDebug()
 {
     ts.flush();
-    if (!buffer.isNull()) {
-        TLog log(msgPriority, buffer.toLocal8Bit());
+    if (msgPriority >= 0 && !buffer.isNull()) {
+        TLog log = createLog(msgPriority, buffer.toLocal8Bit());
         if (stream) {
             stream->writeLog(log);
         }
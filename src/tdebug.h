@@ -4,14 +4,27 @@
 #include <QTextStream>
 #include <TGlobal>
 
+// Least severe priority compiled into the app; define it before
+// including TreeFrog headers to strip e.g. trace messages at build time.
+#ifndef TF_LOG_MAX_PRIORITY
+#define TF_LOG_MAX_PRIORITY Tf::TraceLevel
+#endif
+
 namespace Tf {
 T_CORE_EXPORT void setupAppLoggers();  // internal use
 T_CORE_EXPORT void releaseAppLoggers();  // internal use
+T_CORE_EXPORT int appLogThreshold() noexcept;  // least severe priority any logger outputs
+
+inline bool isAppLogEnabled(int priority) noexcept
+{
+    return priority <= TF_LOG_MAX_PRIORITY && priority <= appLogThreshold();
+}
 }
 
 
 class T_CORE_EXPORT TDebug {
 public:
+    TDebug() { }  // no-op, for a disabled priority
     TDebug(int priority) :
         msgPriority(priority) {}
     TDebug(const TDebug &other);
@@ -165,6 +178,6 @@ public:
 private:
     QString buffer;
     QTextStream ts {&buffer, QIODevice::WriteOnly};
-    int msgPriority {0};
+    int msgPriority {-1};
 };
 
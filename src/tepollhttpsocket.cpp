@@ -7,6 +7,7 @@
 
 #include "tepollhttpsocket.h"
 #include "tactionworker.h"
+#include "tclock.h"
 #include "tepoll.h"
 #include "tepollwebsocket.h"
 #include "twebsocket.h"
@@ -14,7 +15,6 @@
 #include <THttpRequestHeader>
 #include <TSystemGlobal>
 #include <TWebApplication>
-#include <ctime>
 using namespace Tf;
 
 constexpr int BUFFER_RESERVE_SIZE = 1023;
@@ -29,7 +29,7 @@ TEpollHttpSocket::TEpollHttpSocket(int socketDescriptor, const QHostAddress &add
     idleElapsed()
 {
     httpBuffer.reserve(BUFFER_RESERVE_SIZE);
-    idleElapsed = std::time(nullptr);
+    idleElapsed = TClock::monotonicSecs();
 }
 
 
@@ -60,7 +60,7 @@ int TEpollHttpSocket::send()
 {
     int ret = TEpollSocket::send();
     if (ret == 0) {
-        idleElapsed = std::time(nullptr);
+        idleElapsed = TClock::monotonicSecs();
     }
     return ret;
 }
@@ -70,7 +70,7 @@ int TEpollHttpSocket::recv()
 {
     int ret = TEpollSocket::recv();
     if (ret == 0) {
-        idleElapsed = std::time(nullptr);
+        idleElapsed = TClock::monotonicSecs();
     }
     return ret;
 }
@@ -206,5 +206,5 @@ QList<TEpollHttpSocket *> TEpollHttpSocket::allSockets()
 */
 int TEpollHttpSocket::idleTime() const
 {
-    return (uint)std::time(nullptr) - idleElapsed;
+    return (int)(TClock::monotonicSecs() - idleElapsed);
 }
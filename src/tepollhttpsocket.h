@@ -29,7 +29,7 @@ protected:
 private:
     QByteArray httpBuffer;
     qint64 lengthToRead {0};
-    uint idleElapsed {0};
+    qint64 idleElapsed {0};
 
     TEpollHttpSocket(int socketDescriptor, const QHostAddress &address);
 
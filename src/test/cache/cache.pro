@@ -0,0 +1,4 @@
+include(../test.pri)
+TARGET = cache
+SOURCES = main.cpp
+testAppSettings(SqlDatabaseSettingsFiles=, Cache.Backend=memory, Cache.LocalCacheSize=1)
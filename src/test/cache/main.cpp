@@ -0,0 +1,260 @@
+#include <TfTest/TfTest>
+#include <TCache>
+#include "tcachememorystore.h"
+#include "tcachesharedmemorystore.h"
+#include "tcachetieredstore.h"
+#include "tpublisher.h"
+#include "tsettingssnapshot.h"
+#include <QTemporaryDir>
+#include <QThread>
+
+constexpr qint64 SHARD_CAPACITY = 2048;  // bytes of a shard of the memory store
+
+
+class MemoryStore : public TCacheMemoryStore {
+public:
+    explicit MemoryStore(const QByteArray &name) :
+        TCacheMemoryStore(name) { }
+    using TCacheMemoryStore::open;
+};
+
+
+class SharedMemoryStore : public TCacheSharedMemoryStore {
+public:
+    using TCacheSharedMemoryStore::open;
+};
+
+
+class TieredStore : public TCacheTieredStore {
+public:
+    explicit TieredStore(TCacheStore *store) :
+        TCacheTieredStore(store) { }
+};
+
+
+// Keys falling into one shard of the memory store
+static QByteArrayList sameShardKeys(int count)
+{
+    auto shardOf = [](const QByteArray &key) { return (qHash(key) >> 7) & 63; };
+    QByteArrayList keys;
+    for (int i = 0; keys.count() < count; ++i) {
+        QByteArray key = "k" + QByteArray::number(i);
+        if (shardOf(key) == shardOf("k0")) {
+            keys << key;
+        }
+    }
+    return keys;
+}
+
+
+class TestCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void memoryAdmission();
+    void memoryUpdate();
+    void tieredInvalidate();
+    void publisherThread();
+    void sharedMemoryMixedSizes();
+    void memoryMulti();
+    void tieredMulti();
+    void settingsSnapshot();
+};
+
+
+void TestCache::memoryAdmission()
+{
+    MemoryStore store("admission");
+    QVERIFY(store.open(SHARD_CAPACITY * 64, -1));
+    const QByteArrayList keys = sameShardKeys(4);
+    const QByteArray value(500, 'v');
+
+    // Three hot items fill the shard
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(store.set(keys[i], value, 60));
+    }
+    for (int n = 0; n < 3; ++n) {
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(store.get(keys[i]), value);
+        }
+    }
+    const qint64 size = store.memorySize();
+
+    // A one-off item is not admitted, leaving the shard as it was
+    QVERIFY(!store.set(keys[3], value, 60));
+    QCOMPARE(store.count(), 3);
+    QCOMPARE(store.memorySize(), size);
+    for (int i = 0; i < 3; ++i) {
+        QCOMPARE(store.get(keys[i]), value);
+    }
+    QVERIFY(store.get(keys[3]).isNull());
+}
+
+
+void TestCache::memoryUpdate()
+{
+    MemoryStore store("update");
+    QVERIFY(store.open(SHARD_CAPACITY * 64, -1));
+    const QByteArrayList keys = sameShardKeys(3);
+    const QByteArray value(500, 'v');
+
+    // A cold item and two hot ones
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(store.set(keys[i], value, 60));
+    }
+    for (int n = 0; n < 3; ++n) {
+        QCOMPARE(store.get(keys[1]), value);
+        QCOMPARE(store.get(keys[2]), value);
+    }
+
+    // The larger value of the cold item evicts a hot one, and is not lost
+    const QByteArray larger(900, 'w');
+    QVERIFY(store.set(keys[0], larger, 60));
+    QCOMPARE(store.get(keys[0]), larger);
+    QCOMPARE(store.count(), 2);
+
+    // Too large for the shard; the old value does not remain
+    QVERIFY(!store.set(keys[0], QByteArray(SHARD_CAPACITY, 'x'), 60));
+    QVERIFY(store.get(keys[0]).isNull());
+}
+
+
+void TestCache::tieredInvalidate()
+{
+    auto *backend = new MemoryStore("backend");
+    TieredStore store(backend);
+    QVERIFY(store.open());
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QVERIFY(store.set("t1", "a", 60));
+    QVERIFY(backend->remove("t1"));
+    QCOMPARE(store.get("t1"), QByteArray("a"));  // from L1
+
+    // Its own notification is ignored
+    TCacheTieredStore::invalidate("t1", pid);
+    QCOMPARE(store.get("t1"), QByteArray("a"));
+
+    // Dropped on the notification of another process
+    TCacheTieredStore::invalidate("t1", pid + 1);
+    QVERIFY(store.get("t1").isNull());
+
+    // All dropped for an empty key
+    QVERIFY(store.set("t2", "b", 60));
+    QVERIFY(store.set("t3", "c", 60));
+    backend->clear();
+    TCacheTieredStore::invalidate(QByteArray(), pid + 1);
+    QVERIFY(store.get("t2").isNull());
+    QVERIFY(store.get("t3").isNull());
+}
+
+
+void TestCache::publisherThread()
+{
+    class Thread : public QThread {
+    public:
+        TPublisher *publisher {nullptr};
+    protected:
+        void run() override { publisher = TPublisher::instance(); }
+    };
+
+    // Created first in another thread, it lives in the application thread
+    Thread thread;
+    thread.start();
+    QVERIFY(thread.wait(5000));
+    QVERIFY(thread.publisher);
+    QCOMPARE(thread.publisher->thread(), QCoreApplication::instance()->thread());
+}
+
+
+void TestCache::sharedMemoryMixedSizes()
+{
+    QTemporaryDir dir;
+    SharedMemoryStore store;
+    QVERIFY(store.open(dir.filePath("cachemap"), 16 * 1024 * 1024));
+
+    // Small items fill all the pages
+    const QByteArray small(200, 's');
+    for (int i = 0; i < 64000; ++i) {
+        QVERIFY(store.set("s" + QByteArray::number(i), small, 60));
+    }
+    const int smallCount = store.count();
+
+    // Large items take pages of the small ones, evicting part of them
+    const QByteArray large(3000, 'l');
+    for (int i = 0; i < 32; ++i) {
+        QVERIFY(store.set("l" + QByteArray::number(i), large, 60));
+    }
+    QVERIFY(store.count() > smallCount / 2);
+
+    // More small items evict only small ones
+    for (int i = 64000; i < 96000; ++i) {
+        QVERIFY(store.set("s" + QByteArray::number(i), small, 60));
+    }
+    for (int i = 0; i < 32; ++i) {
+        QCOMPARE(store.get("l" + QByteArray::number(i)), large);
+    }
+    QCOMPARE(store.get("s95999"), small);
+    QVERIFY(store.get("s0").isNull());  // least recently used
+}
+
+
+void TestCache::memoryMulti()
+{
+    // Through the functions of TCacheStore looping over the keys
+    MemoryStore store("multi");
+    QVERIFY(store.open(SHARD_CAPACITY * 64, -1));
+
+    const QMap<QByteArray, QByteArray> values {{"m1", "a"}, {"m2", "b"}, {"m3", "c"}};
+    QVERIFY(store.setMulti(values, 60));
+    QCOMPARE(store.getMulti({"m1", "m2", "m3", "nokey"}), values);
+    QVERIFY(!store.setMulti(values, 0));
+    QVERIFY(store.getMulti({"m1", "m2", "m3"}).isEmpty());
+
+    QVERIFY(store.setMulti(values, 60));
+    QCOMPARE(store.removeMulti({"m1", "m3", "nokey"}), 2);
+    QCOMPARE(store.getMulti({"m1", "m2", "m3"}), (QMap<QByteArray, QByteArray>{{"m2", "b"}}));
+}
+
+
+void TestCache::tieredMulti()
+{
+    auto *backend = new MemoryStore("multibackend");
+    TieredStore store(backend);
+    QVERIFY(store.open());
+
+    QVERIFY(store.setMulti({{"u1", "a"}, {"u2", "b"}}, 60));
+    QVERIFY(backend->set("u3", "c", 60));  // only in L2
+
+    // L1 hits, and the misses from L2
+    QVERIFY(backend->remove("u1"));
+    const QMap<QByteArray, QByteArray> expected {{"u1", "a"}, {"u2", "b"}, {"u3", "c"}};
+    QCOMPARE(store.getMulti({"u1", "u2", "u3", "nokey"}), expected);
+
+    // Kept in L1 once fetched
+    QVERIFY(backend->remove("u3"));
+    QCOMPARE(store.get("u3"), QByteArray("c"));
+
+    QCOMPARE(store.removeMulti({"u2", "u3"}), 1);  // u3 is not in L2 any more
+    QCOMPARE(store.getMulti({"u1", "u2", "u3"}), (QMap<QByteArray, QByteArray>{{"u1", "a"}}));
+}
+
+
+void TestCache::settingsSnapshot()
+{
+    const TSettingsSnapshot &snapshot = TSettingsSnapshot::current();
+    QCOMPARE(snapshot.cache.gcProbability, 0);
+    QCOMPARE(snapshot.cache.enableCompression, true);
+    QCOMPARE(snapshot.cache.compressionThreshold, 128);
+    QVERIFY(TCache::compressionEnabled());
+
+    // Swapped as a whole, keeping the one held valid
+    TSettingsSnapshot::reload();
+    const TSettingsSnapshot &reloaded = TSettingsSnapshot::current();
+    QVERIFY(&reloaded != &snapshot);
+    QCOMPARE(reloaded.cache.enableCompression, snapshot.cache.enableCompression);
+    QCOMPARE(reloaded.session.name, snapshot.session.name);
+}
+
+
+TF_TEST_SQLLESS_MAIN(TestCache)
+#include "main.moc"
@@ -1,6 +1,7 @@
 #include <QTest>
 #include <QDebug>
 #include "tglobal.h"
+#include "tlz4compressor.h"
 
 static QByteArray dummydata;
 static const QByteArray testdata2("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b");
@@ -22,6 +23,10 @@ private slots:
     void lz4_l2();
     void lz4_l5_data();
     void lz4_l5();
+    void compressor_data();
+    void compressor();
+    void compressorLegacy_data();
+    void compressorLegacy();
     void bench_lz4_l1_512();
     void bench_lz4_l2_512();
     void bench_lz4_l5_512();
@@ -150,6 +155,78 @@ void LZ4Compress::lz4_l5()
     QCOMPARE(data, uncomp);
 }
 
+void LZ4Compress::compressor_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("hcThreshold");
+    QTest::addColumn<bool>("dictionary");
+
+    QTest::newRow("stored") << testdata2.left(16) << 0 << false;
+    QTest::newRow("lz4") << testdata5 << 0 << false;
+    QTest::newRow("hc") << dummydata.mid(0, 4096) << 1024 << false;
+    QTest::newRow("dict1") << testdata3 << 0 << true;
+    QTest::newRow("dict2") << dummydata.mid(100, 1000) << 0 << true;
+}
+
+void LZ4Compress::compressor()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, hcThreshold);
+    QFETCH(bool, dictionary);
+
+    TLz4Compressor compressor(32, hcThreshold);
+    if (dictionary) {
+        compressor.setDictionary(TLz4Compressor::trainDictionary({testdata3, testdata5, dummydata.mid(0, 8192)}));
+    }
+    QByteArray comp = compressor.compress(data);
+    QCOMPARE(compressor.uncompress(comp), data);
+
+    // Data compressed by Tf::lz4Compress() is still readable
+    QByteArray legacy = Tf::lz4Compress(data);
+    if (!legacy.isEmpty()) {
+        QCOMPARE(compressor.uncompress(legacy), data);
+    }
+}
+
+void LZ4Compress::compressorLegacy_data()
+{
+    QTest::addColumn<int>("firstByte");
+
+    // Flag bytes of an earlier format, and the first byte of the header
+    for (int b : {0xF0, 0xF1, 0xF2, 0xF3, 0x89}) {
+        QTest::newRow(QByteArray::number(b, 16).data()) << b;
+    }
+}
+
+void LZ4Compress::compressorLegacy()
+{
+    QFETCH(int, firstByte);
+
+    // Incompressible data of the size whose first block length starts
+    // with the byte
+    quint32 seed = 12345;
+    QByteArray data;
+    QByteArray legacy;
+    for (int size = 64; size < 4096; ++size) {
+        data.resize(size);
+        for (auto &c : data) {
+            seed = seed * 1103515245 + 12345;
+            c = (char)(seed >> 16);
+        }
+        legacy = Tf::lz4Compress(data);
+        if ((uchar)legacy.at(0) == firstByte) {
+            break;
+        }
+        legacy.clear();
+    }
+    QVERIFY(!legacy.isEmpty());
+
+    TLz4Compressor compressor(32, 1024);
+    QCOMPARE(compressor.uncompress(legacy), data);
+    compressor.setDictionary(TLz4Compressor::trainDictionary({testdata3, testdata5}));
+    QCOMPARE(compressor.uncompress(legacy), data);
+}
+
 void LZ4Compress::bench_lz4_l1_512()
 {
     auto d = dummydata.mid(0, 512);
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = logringbuffer
+SOURCES += main.cpp
@@ -0,0 +1,128 @@
+#include <QTest>
+#include <QThread>
+#include <TfTest/TfTest>
+#include "tlogringbuffer.h"
+
+
+class ConsumerThread : public QThread
+{
+public:
+    ConsumerThread(TLogRingBuffer *r, int n) : ring(r), total(n) { }
+    QByteArray received;
+protected:
+    void run() override
+    {
+        while (received.length() < total) {
+            const char *first, *second;
+            int firstLength, secondLength;
+            int len = ring->peek(first, firstLength, second, secondLength);
+            received.append(first, firstLength);
+            received.append(second, secondLength);
+            ring->consume(len);
+            if (len == 0) {
+                QThread::yieldCurrentThread();
+            }
+        }
+    }
+private:
+    TLogRingBuffer *ring;
+    int total;
+};
+
+
+class TestLogRingBuffer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void capacity();
+    void pushFull();
+    void wrapAround();
+    void partialConsume();
+    void spsc();
+};
+
+
+void TestLogRingBuffer::capacity()
+{
+    QCOMPARE(TLogRingBuffer(1).capacity(), 1024);
+    QCOMPARE(TLogRingBuffer(1024).capacity(), 1024);
+    QCOMPARE(TLogRingBuffer(1025).capacity(), 2048);
+}
+
+
+void TestLogRingBuffer::pushFull()
+{
+    TLogRingBuffer ring(1024);
+    QByteArray data(1000, 'a');
+
+    QVERIFY(ring.push(data.data(), data.length()));
+    QVERIFY(!ring.push(data.data(), 100));  // all or nothing
+    QCOMPARE(ring.size(), 1000);
+    QVERIFY(ring.push(data.data(), 24));
+    QCOMPARE(ring.size(), 1024);
+}
+
+
+void TestLogRingBuffer::wrapAround()
+{
+    TLogRingBuffer ring(1024);
+    QByteArray filler(1000, 'x');
+    QByteArray data("0123456789abcdefghijklmnopqrstuvwxyz");
+    const char *first, *second;
+    int firstLength, secondLength;
+
+    QVERIFY(ring.push(filler.data(), filler.length()));
+    ring.consume(ring.peek(first, firstLength, second, secondLength));
+    QVERIFY(ring.push(data.data(), data.length()));
+
+    int len = ring.peek(first, firstLength, second, secondLength);
+    QCOMPARE(len, data.length());
+    QCOMPARE(firstLength, 24);
+    QCOMPARE(QByteArray(first, firstLength) + QByteArray(second, secondLength), data);
+    ring.consume(len);
+    QCOMPARE(ring.size(), 0);
+}
+
+
+void TestLogRingBuffer::partialConsume()
+{
+    // As after a short writev(); the unwritten bytes stay readable
+    TLogRingBuffer ring(1024);
+    QByteArray data("first record\nsecond record\n");
+    const char *first, *second;
+    int firstLength, secondLength;
+
+    QVERIFY(ring.push(data.data(), data.length()));
+    ring.peek(first, firstLength, second, secondLength);
+    ring.consume(5);
+
+    int len = ring.peek(first, firstLength, second, secondLength);
+    QCOMPARE(len, data.length() - 5);
+    QCOMPARE(QByteArray(first, firstLength) + QByteArray(second, secondLength), data.mid(5));
+}
+
+
+void TestLogRingBuffer::spsc()
+{
+    const int count = 100000;
+    TLogRingBuffer ring(4096);
+    QByteArray expected;
+    for (int i = 0; i < count; ++i) {
+        expected += QByteArray::number(i) + '\n';
+    }
+
+    ConsumerThread consumer(&ring, expected.length());
+    consumer.start();
+    for (int i = 0; i < count; ++i) {
+        QByteArray line = QByteArray::number(i) + '\n';
+        while (!ring.push(line.data(), line.length())) {
+            QThread::yieldCurrentThread();
+        }
+    }
+    consumer.wait();
+    QCOMPARE(consumer.received, expected);
+}
+
+
+TF_TEST_SQLLESS_MAIN(TestLogRingBuffer)
+#include "main.moc"
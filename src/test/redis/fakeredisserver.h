@@ -0,0 +1,220 @@
+#pragma once
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <atomic>
+
+// A Redis server stand-in for the tests, which keeps the strings in
+// memory. The command RAW replies with its argument as it is, and SLEEP
+// waits for the milliseconds given before replying. Replies are written
+// in chunks of chunkSize bytes if set, to split them across reads.
+class FakeRedisServer : public QThread {
+public:
+    explicit FakeRedisServer(quint16 port) :
+        QThread(), port(port) { }
+    ~FakeRedisServer() { quit(); wait(); }
+
+    bool startListening()
+    {
+        start();
+        while (!listening.load() && !failed.load()) {
+            QThread::msleep(1);
+        }
+        return listening.load();
+    }
+
+    void setChunkSize(int size) { chunkSize.store(size); }
+    int connectionCount() const { return connections.load(); }
+
+    bool contains(const QByteArray &key) const
+    {
+        QMutexLocker locker(&mutex);
+        return strings.contains(key);
+    }
+
+    QByteArray value(const QByteArray &key) const
+    {
+        QMutexLocker locker(&mutex);
+        return strings.value(key);
+    }
+
+    int commandCount(const QByteArray &name) const
+    {
+        QMutexLocker locker(&mutex);
+        return counts.value(name);
+    }
+
+protected:
+    void run() override
+    {
+        QHash<QTcpSocket *, QByteArray> buffers;
+        QTcpServer server;  // deletes the sockets first
+
+        QObject::connect(&server, &QTcpServer::newConnection, [&]() {
+            while (server.hasPendingConnections()) {
+                QTcpSocket *socket = server.nextPendingConnection();
+                connections++;
+                QObject::connect(socket, &QTcpSocket::readyRead, [&, socket]() {
+                    QByteArray &buffer = buffers[socket];
+                    buffer += socket->readAll();
+                    QByteArrayList command;
+                    while (takeCommand(buffer, command)) {
+                        write(socket, execute(command));
+                    }
+                });
+                QObject::connect(socket, &QTcpSocket::disconnected, [&, socket]() {
+                    connections--;
+                    buffers.remove(socket);
+                    socket->deleteLater();
+                });
+            }
+        });
+
+        if (!server.listen(QHostAddress::LocalHost, port)) {
+            failed.store(true);
+            return;
+        }
+        listening.store(true);
+        exec();
+    }
+
+private:
+    // Takes a command in RESP from the head of the buffer
+    static bool takeCommand(QByteArray &buffer, QByteArrayList &command)
+    {
+        command.clear();
+        int eol = buffer.indexOf("\r\n");
+        if (!buffer.startsWith('*') || eol < 0) {
+            return false;
+        }
+
+        int count = buffer.mid(1, eol - 1).toInt();
+        int pos = eol + 2;
+        for (int i = 0; i < count; ++i) {
+            eol = buffer.indexOf("\r\n", pos);
+            if (eol < 0) {
+                return false;
+            }
+            int len = buffer.mid(pos + 1, eol - pos - 1).toInt();
+            pos = eol + 2;
+            if (buffer.length() < pos + len + 2) {
+                return false;
+            }
+            command << buffer.mid(pos, len);
+            pos += len + 2;
+        }
+        buffer.remove(0, pos);
+        return true;
+    }
+
+    void write(QTcpSocket *socket, const QByteArray &reply)
+    {
+        const int size = chunkSize.load();
+        if (size <= 0) {
+            socket->write(reply);
+            socket->flush();
+            return;
+        }
+
+        for (int pos = 0; pos < reply.length(); pos += size) {
+            socket->write(reply.mid(pos, size));
+            socket->flush();
+            socket->waitForBytesWritten(1000);
+            QThread::msleep(1);
+        }
+    }
+
+    static QByteArray bulk(const QByteArray &data)
+    {
+        if (data.isNull()) {
+            return "$-1\r\n";
+        }
+        return "$" + QByteArray::number(data.length()) + "\r\n" + data + "\r\n";
+    }
+
+    QByteArray execute(const QByteArrayList &command)
+    {
+        const QByteArray name = command.value(0).toUpper();
+        QMutexLocker locker(&mutex);
+        counts[name]++;
+
+        if (name == "PING") {
+            return "+PONG\r\n";
+        } else if (name == "SELECT" || name == "FLUSHDB") {
+            if (name == "FLUSHDB") {
+                strings.clear();
+            }
+            return "+OK\r\n";
+        } else if (name == "RAW") {
+            return command.value(1);
+        } else if (name == "SLEEP") {
+            locker.unlock();
+            QThread::msleep(command.value(1).toInt());
+            return "+OK\r\n";
+        } else if (name == "GET") {
+            return bulk(strings.value(command.value(1)));
+        } else if (name == "SET") {
+            bool nx = command.mid(3).contains("NX");
+            if (nx && strings.contains(command.value(1))) {
+                return "$-1\r\n";
+            }
+            strings.insert(command.value(1), command.value(2));
+            return "+OK\r\n";
+        } else if (name == "SETEX") {
+            if (command.value(2).toInt() <= 0) {
+                return "-ERR invalid expire time in 'setex' command\r\n";
+            }
+            strings.insert(command.value(1), command.value(3));
+            return "+OK\r\n";
+        } else if (name == "SETNX") {
+            if (strings.contains(command.value(1))) {
+                return ":0\r\n";
+            }
+            strings.insert(command.value(1), command.value(2));
+            return ":1\r\n";
+        } else if (name == "DEL" || name == "EXISTS") {
+            int n = 0;
+            for (auto &key : command.mid(1)) {
+                n += (name == "DEL") ? strings.remove(key) : strings.contains(key);
+            }
+            return ":" + QByteArray::number(n) + "\r\n";
+        } else if (name == "EXPIRE") {
+            return strings.contains(command.value(1)) ? ":1\r\n" : ":0\r\n";
+        } else if (name == "EVAL") {
+            // Runs only the compare-and-delete script of the cache lock
+            const QByteArray key = command.value(3);
+            if (command.value(2) != "1" || !command.value(1).contains("'del'")) {
+                return "-ERR unsupported script\r\n";
+            }
+            if (strings.contains(key) && strings.value(key) == command.value(4)) {
+                strings.remove(key);
+                return ":1\r\n";
+            }
+            return ":0\r\n";
+        } else if (name == "MGET") {
+            QByteArray reply = "*" + QByteArray::number(command.count() - 1) + "\r\n";
+            for (auto &key : command.mid(1)) {
+                reply += bulk(strings.value(key));
+            }
+            return reply;
+        } else if (name == "MSET") {
+            for (int i = 1; i + 1 < command.count(); i += 2) {
+                strings.insert(command[i], command[i + 1]);
+            }
+            return "+OK\r\n";
+        }
+        return "-ERR unknown command '" + command.value(0) + "'\r\n";
+    }
+
+    const quint16 port;
+    std::atomic<bool> listening {false};
+    std::atomic<bool> failed {false};
+    std::atomic<int> chunkSize {0};
+    std::atomic<int> connections {0};
+    mutable QMutex mutex;
+    QHash<QByteArray, QByteArray> strings;
+    QHash<QByteArray, int> counts;
+};
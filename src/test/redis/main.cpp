@@ -0,0 +1,485 @@
+#include <TfTest/TfTest>
+#include <TRedis>
+#include <TCache>
+#include <TDatabaseContext>
+#include <TRedisDriver>
+#include <TRedisPipeline>
+#include <QElapsedTimer>
+#include <thread>
+#include <vector>
+#include "fakeredisserver.h"
+#include "tcacheredisstore.h"
+#include "tredismultiplexer.h"
+
+constexpr quint16 PORT = 16379;  // as in config/redis.ini and cache.ini
+
+
+class CacheRedisStore : public TCacheRedisStore {
+public:
+    CacheRedisStore() { }
+};
+
+
+// Runs the function in a thread of its own, as another request
+static std::thread requestThread(const std::function<void()> &function)
+{
+    return std::thread([function]() {
+        TDatabaseContext context;
+        TDatabaseContext::setCurrentDatabaseContext(&context);
+        function();
+        context.release();
+        TDatabaseContext::setCurrentDatabaseContext(nullptr);
+    });
+}
+
+
+class TestRedis : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void pipelineRequest();
+    void pipeline();
+    void bulk();
+    void parseReply_data();
+    void parseReply();
+    void largeBulkString();
+    void multiplexer();
+    void multiplexerUnshareable_data();
+    void multiplexerUnshareable();
+    void multiplexerTimeout();
+    void setNx();
+    void cacheLock();
+    void getOrCompute();
+    void getOrComputeConcurrent();
+    void staleWhileRevalidate();
+    void cacheMulti();
+
+private:
+    FakeRedisServer *server {nullptr};
+};
+
+
+void TestRedis::initTestCase()
+{
+    server = new FakeRedisServer(PORT);
+    QVERIFY(server->startListening());
+}
+
+
+void TestRedis::cleanupTestCase()
+{
+    delete server;
+    server = nullptr;
+}
+
+
+void TestRedis::init()
+{
+    server->setChunkSize(0);
+    TRedis().flushDb();
+}
+
+
+void TestRedis::pipelineRequest()
+{
+    TRedisDriver driver;
+    QVERIFY(driver.open(QString(), QString(), QString(), "127.0.0.1", PORT));
+
+    QList<QByteArrayList> commands {
+        {"SET", "k1", "v1"},
+        {"GET", "k1"},
+        {"BOGUS"},
+        {"GET", "nokey"},
+        {"EXISTS", "k1", "nokey"},
+    };
+    QList<QVariantList> responses;
+    QVector<bool> results;
+    QVERIFY(driver.request(commands, responses, results));
+    QCOMPARE(responses.count(), 5);
+    QCOMPARE(results, QVector<bool>({true, true, false, true, true}));
+    QCOMPARE(responses[1].value(0).toByteArray(), QByteArray("v1"));
+    QVERIFY(responses[3].value(0).toByteArray().isNull());
+    QCOMPARE(responses[4].value(0).toInt(), 1);
+
+    // The connection stays usable after an error reply
+    QVariantList response;
+    QVERIFY(driver.request({"GET", "k1"}, response));
+    QCOMPARE(response.value(0).toByteArray(), QByteArray("v1"));
+    driver.close();
+}
+
+
+void TestRedis::pipeline()
+{
+    TRedis redis;
+    TRedisPipeline pl = redis.pipeline();
+    int set = pl.set("p1", "a");
+    int get = pl.get("p1");
+    int exists = pl.exists("p2");
+    int bogus = pl.command({"BOGUS"});
+    int del = pl.del("p1");
+    QCOMPARE(pl.count(), 5);
+
+    QVERIFY(pl.exec());
+    QVERIFY(pl.isSuccess(set));
+    QCOMPARE(pl.toByteArray(get), QByteArray("a"));
+    QVERIFY(!pl.toBool(exists));
+    QVERIFY(!pl.isSuccess(bogus));
+    QVERIFY(pl.toBool(del));
+    QCOMPARE(pl.count(), 0);
+    QVERIFY(!server->contains("p1"));
+}
+
+
+void TestRedis::bulk()
+{
+    TRedis redis;
+    int setex = server->commandCount("SETEX");
+    QVERIFY(redis.mset({{"m1", "x"}, {"m2", "y"}}));
+    QCOMPARE(redis.mget({"m1", "nokey", "m2"}), QByteArrayList({"x", QByteArray(), "y"}));
+
+    QVERIFY(redis.setEx({{"e1", "1"}, {"e2", "2"}}, 60));
+    QCOMPARE(server->value("e1"), QByteArray("1"));
+    QCOMPARE(server->value("e2"), QByteArray("2"));
+    QCOMPARE(server->commandCount("SETEX") - setex, 2);
+
+    // A failed SETEX fails the whole batch
+    TRedisPipeline pl = redis.pipeline();
+    int ok = pl.setEx("e3", "3", 60);
+    int ng = pl.setEx("e4", "4", -1);
+    QVERIFY(pl.exec());
+    QVERIFY(pl.isSuccess(ok));
+    QVERIFY(!pl.isSuccess(ng));
+
+    QVERIFY(!redis.setEx({{"e5", "5"}, {"e6", "6"}}, -1));
+    QVERIFY(!server->contains("e5"));
+}
+
+
+void TestRedis::parseReply_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::addColumn<QByteArray>("reply");
+    QTest::addColumn<QVariantList>("expected");
+
+    const QList<QPair<QByteArray, QVariantList>> replies {
+        {"+OK\r\n", {QByteArray("OK")}},
+        {":42\r\n", {42LL}},
+        {":-7\r\n", {-7LL}},
+        {"$5\r\nhello\r\n", {QByteArray("hello")}},
+        {"$12\r\nline1\r\nline2\r\n", {QByteArray("line1\r\nline2")}},  // CRLF in a bulk string
+        {"$0\r\n\r\n", {QByteArray("")}},
+        {"*3\r\n:1\r\n$1\r\na\r\n$-1\r\n", {1LL, QByteArray("a"), QByteArray()}},
+        {"*2\r\n*2\r\n:1\r\n:2\r\n*1\r\n$1\r\nb\r\n", {QVariantList({1LL, 2LL}), QVariantList({QByteArray("b")})}},
+        {"*0\r\n", {}},
+        {"*-1\r\n", {}},
+        {"_\r\n", {QByteArray()}},
+        {"#t\r\n", {true}},
+        {"#f\r\n", {false}},
+        {",1.5\r\n", {1.5}},
+        {"(12345678901234567890\r\n", {QByteArray("12345678901234567890")}},
+        {"=15\r\ntxt:Some string\r\n", {QByteArray("Some string")}},
+        {"%2\r\n$1\r\nk\r\n:1\r\n$1\r\nl\r\n:2\r\n", {QByteArray("k"), 1LL, QByteArray("l"), 2LL}},
+        {"~2\r\n:1\r\n:2\r\n", {1LL, 2LL}},
+    };
+
+    // Whole, and split into pieces across reads
+    for (int chunk : {0, 1, 3}) {
+        for (int i = 0; i < replies.count(); ++i) {
+            QByteArray name = QByteArray::number(chunk) + "-" + QByteArray::number(i);
+            QTest::newRow(name.data()) << chunk << replies[i].first << replies[i].second;
+        }
+    }
+}
+
+
+void TestRedis::parseReply()
+{
+    QFETCH(int, chunkSize);
+    QFETCH(QByteArray, reply);
+    QFETCH(QVariantList, expected);
+
+    TRedisDriver driver;
+    QVERIFY(driver.open(QString(), QString(), QString(), "127.0.0.1", PORT));
+    server->setChunkSize(chunkSize);
+
+    // Twice in a pipeline, so that the second starts in the middle of a read
+    QList<QVariantList> responses;
+    QVector<bool> results;
+    QVERIFY(driver.request({{"RAW", reply}, {"RAW", reply}, {"GET", "nokey"}}, responses, results));
+    QCOMPARE(results, QVector<bool>({true, true, true}));
+    QCOMPARE(responses[0], expected);
+    QCOMPARE(responses[1], expected);
+    QVERIFY(responses[2].value(0).toByteArray().isNull());
+    driver.close();
+}
+
+
+void TestRedis::largeBulkString()
+{
+    // Received in many reads, the rest directly into its own buffer
+    QByteArray value(1024 * 1024 + 7, 'x');
+    for (int i = 0; i < value.length(); i += 1000) {
+        value[i] = 'a' + (i / 1000) % 26;
+    }
+
+    TRedis redis;
+    QVERIFY(redis.set("large", value));
+    for (int chunk : {0, 65536, 100000}) {
+        server->setChunkSize(chunk);
+        TRedisPipeline pl = redis.pipeline();
+        pl.get("large");
+        pl.exists("large");
+        pl.get("large");
+        QVERIFY(pl.exec());
+        QCOMPARE(pl.toByteArray(0), value);
+        QVERIFY(pl.toBool(1));
+        QCOMPARE(pl.toByteArray(2), value);
+    }
+}
+
+
+void TestRedis::multiplexer()
+{
+    TRedisMultiplexer *mux = TRedisMultiplexer::instance("multiplexer", "127.0.0.1", PORT, 2, QStringList());
+    QCOMPARE(mux->connectionCount(), 2);
+
+    // Requests of several threads over the shared connections
+    std::atomic<int> failures {0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 50; ++i) {
+                QByteArray key = "mx" + QByteArray::number(t) + "-" + QByteArray::number(i);
+                QList<QVariantList> responses;
+                QVector<bool> results;
+                if (!mux->request({{"SET", key, key}, {"GET", key}}, responses, results)
+                    || responses.value(1).value(0).toByteArray() != key) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    QCOMPARE(failures.load(), 0);
+
+    // Opened on the multiplexer, without a connection of its own
+    TRedisDriver driver;
+    driver.setMultiplexer(mux);
+    QVERIFY(!driver.isOpen());
+    QVERIFY(driver.open(QString(), QString(), QString(), "127.0.0.1", PORT));
+    QVERIFY(driver.isOpen());
+    QVariantList response;
+    QVERIFY(driver.request({"GET", "mx0-0"}, response));
+    QCOMPARE(response.value(0).toByteArray(), QByteArray("mx0-0"));
+    driver.close();
+    QVERIFY(!driver.isOpen());
+}
+
+
+void TestRedis::multiplexerUnshareable_data()
+{
+    QTest::addColumn<QByteArrayList>("command");
+    QTest::addColumn<bool>("shareable");
+
+    QTest::newRow("get") << QByteArrayList({"GET", "k"}) << true;
+    QTest::newRow("multi") << QByteArrayList({"MULTI"}) << false;
+    QTest::newRow("exec") << QByteArrayList({"exec"}) << false;
+    QTest::newRow("watch") << QByteArrayList({"WATCH", "k"}) << false;
+    QTest::newRow("select") << QByteArrayList({"SELECT", "1"}) << false;
+    QTest::newRow("subscribe") << QByteArrayList({"SUBSCRIBE", "ch"}) << false;
+    QTest::newRow("blpop") << QByteArrayList({"BLPOP", "k", "0"}) << false;
+    QTest::newRow("xread") << QByteArrayList({"XREAD", "STREAMS", "s", "0"}) << true;
+    QTest::newRow("xread-block") << QByteArrayList({"XREAD", "block", "0", "STREAMS", "s", "0"}) << false;
+}
+
+
+void TestRedis::multiplexerUnshareable()
+{
+    QFETCH(QByteArrayList, command);
+    QFETCH(bool, shareable);
+
+    QCOMPARE(TRedisMultiplexer::isShareable(command), shareable);
+    if (!shareable) {
+        TRedisMultiplexer *mux = TRedisMultiplexer::instance("multiplexer", "127.0.0.1", PORT, 2, QStringList());
+        const QByteArray name = command.value(0).toUpper();
+        int count = server->commandCount(name);
+        QList<QVariantList> responses;
+        QVector<bool> results;
+        QVERIFY(!mux->request({{"PING"}, command}, responses, results));
+        QVERIFY(responses.isEmpty());
+        QCOMPARE(server->commandCount(name), count);  // not sent
+    }
+}
+
+
+void TestRedis::multiplexerTimeout()
+{
+    TRedisMultiplexer *mux = TRedisMultiplexer::instance("multiplexer", "127.0.0.1", PORT, 1, QStringList());
+    const int timeout = mux->requestTimeout();
+    mux->setRequestTimeout(100);
+
+    QList<QVariantList> responses;
+    QVector<bool> results;
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(!mux->request({{"SLEEP", "1000"}}, responses, results));
+    QVERIFY(timer.elapsed() < 1000);
+    mux->setRequestTimeout(timeout);
+
+    // Usable again once the reply has arrived
+    QVERIFY(mux->request({{"SET", "t1", "a"}, {"GET", "t1"}}, responses, results));
+    QCOMPARE(responses.value(1).value(0).toByteArray(), QByteArray("a"));
+}
+
+
+void TestRedis::setNx()
+{
+    TRedis redis;
+    QVERIFY(redis.setNx("nx1", "a", 60));
+    QVERIFY(!redis.setNx("nx1", "b", 60));
+    QCOMPARE(redis.get("nx1"), QByteArray("a"));
+}
+
+
+void TestRedis::cacheLock()
+{
+    CacheRedisStore store;
+    QVERIFY(store.lock("c1", 10));
+    QVERIFY(server->contains("c1:lock"));
+    QVERIFY(!store.lock("c1", 10));  // held
+
+    store.unlock("c1");
+    QVERIFY(!server->contains("c1:lock"));
+    QVERIFY(store.lock("c1", 10));
+    store.unlock("c1");
+
+    // Never releases the lock acquired by another after the expiry
+    QVERIFY(store.lock("c2", 10));
+    QVERIFY(TRedis().set("c2:lock", "other"));
+    store.unlock("c2");
+    QCOMPARE(server->value("c2:lock"), QByteArray("other"));
+}
+
+
+void TestRedis::getOrCompute()
+{
+    TCache cache;
+    int computed = 0;
+    auto compute = [&]() {
+        computed++;
+        return QByteArray("computed");
+    };
+
+    // Computed under the lock among the processes, which is released
+    int sets = server->commandCount("SET");
+    QCOMPARE(cache.getOrCompute("g1", 60, compute, 0, true), QByteArray("computed"));
+    QCOMPARE(server->commandCount("SET") - sets, 1);
+    QVERIFY(!server->contains("g1:lock"));
+
+    QCOMPARE(cache.getOrCompute("g1", 60, compute, 0, true), QByteArray("computed"));
+    QCOMPARE(computed, 1);
+}
+
+
+void TestRedis::getOrComputeConcurrent()
+{
+    std::atomic<int> computed {0};
+    std::atomic<bool> release {false};
+    auto compute = [&]() {
+        computed++;
+        while (!release) {
+            QThread::msleep(10);
+        }
+        return QByteArray("computed");
+    };
+
+    QByteArray values[2];
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+        threads.push_back(requestThread([&, t]() {
+            TCache cache;
+            values[t] = cache.getOrCompute("g2", 60, compute, 0, true);
+        }));
+    }
+    QThread::msleep(200);  // both callers are in
+    release = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // One computes, the other one waits for its value
+    QCOMPARE(computed.load(), 1);
+    QCOMPARE(values[0], QByteArray("computed"));
+    QCOMPARE(values[1], QByteArray("computed"));
+    QVERIFY(!server->contains("g2:lock"));
+}
+
+
+void TestRedis::staleWhileRevalidate()
+{
+    // Stale at once, kept 60 seconds more
+    TCache cache;
+    QCOMPARE(cache.getOrCompute("s1", 0, []() { return QByteArray("old"); }, 60, true), QByteArray("old"));
+
+    std::atomic<bool> started {false};
+    std::atomic<bool> release {false};
+    std::thread thread = requestThread([&]() {
+        TCache cache;
+        cache.getOrCompute("s1", 60, [&]() {
+            started = true;
+            while (!release) {
+                QThread::msleep(10);
+            }
+            return QByteArray("new");
+        }, 60, true);
+    });
+    while (!started) {
+        QThread::msleep(10);
+    }
+
+    // The stale value while revalidating, without computing
+    int computed = 0;
+    auto compute = [&]() {
+        computed++;
+        return QByteArray("other");
+    };
+    QCOMPARE(cache.getOrCompute("s1", 60, compute, 60, true), QByteArray("old"));
+
+    release = true;
+    thread.join();
+    QCOMPARE(cache.getOrCompute("s1", 60, compute, 60, true), QByteArray("new"));
+    QCOMPARE(computed, 0);
+    QVERIFY(!server->contains("s1:lock"));
+}
+
+
+void TestRedis::cacheMulti()
+{
+    CacheRedisStore store;
+    const int mget = server->commandCount("MGET");
+    const int setex = server->commandCount("SETEX");
+    const int del = server->commandCount("DEL");
+
+    const QMap<QByteArray, QByteArray> values {{"r1", "a"}, {"r2", "b"}, {"r3", "c"}};
+    QVERIFY(store.setMulti(values, 60));
+    QCOMPARE(server->commandCount("SETEX") - setex, 3);
+    QCOMPARE(server->value("r2"), QByteArray("b"));
+
+    QCOMPARE(store.getMulti({"r1", "nokey", "r2", "r3"}), values);
+    QCOMPARE(server->commandCount("MGET") - mget, 1);
+
+    QCOMPARE(store.removeMulti({"r1", "r3", "nokey"}), 2);
+    QCOMPARE(server->commandCount("DEL") - del, 1);
+    QVERIFY(!server->contains("r1"));
+    QVERIFY(server->contains("r2"));
+}
+
+
+TF_TEST_MAIN(TestRedis)
+#include "main.moc"
@@ -0,0 +1,5 @@
+include(../test.pri)
+TARGET = redis
+HEADERS = fakeredisserver.h
+SOURCES = main.cpp
+testAppSettings(SqlDatabaseSettingsFiles=, RedisSettingsFile=redis.ini, Cache.Backend=redis)
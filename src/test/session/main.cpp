@@ -0,0 +1,170 @@
+#include <TfTest/TfTest>
+#include <TSqlQuery>
+#include "tclock.h"
+#include "tsession.h"
+#include "tsessionsqlobjectstore.h"
+
+
+class TestSession : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void read();
+    void assign();
+    void assignFound();
+    void removeMissing();
+    void touchThrottle();
+    void touchOther();
+};
+
+
+static QDateTime updatedAt(const QByteArray &id)
+{
+    TSqlQuery query;
+    query.prepare("SELECT updated_at FROM session WHERE id=?");
+    query.addBind(QString::fromLatin1(id));
+    return (query.exec() && query.next()) ? query.value(0).toDateTime() : QDateTime();
+}
+
+
+static bool setUpdatedAt(const QByteArray &id, const QDateTime &dateTime)
+{
+    TSqlQuery query;
+    query.prepare("UPDATE session SET updated_at=? WHERE id=?");
+    query.addBind(dateTime).addBind(QString::fromLatin1(id));
+    return query.exec() && query.numRowsAffected() == 1;
+}
+
+
+static bool isClose(const QDateTime &dateTime1, const QDateTime &dateTime2)
+{
+    return dateTime1.isValid() && qAbs(dateTime1.secsTo(dateTime2)) <= 1;
+}
+
+
+void TestSession::initTestCase()
+{
+    TSessionSqlObjectStore store;
+    TSession session("initial");
+    QVERIFY(store.store(session));  // creates the table
+
+    TSqlQuery query;
+    QVERIFY(query.exec("DELETE FROM session"));
+}
+
+
+void TestSession::read()
+{
+    TSession session("read");
+    QVariant value = session["foo"];
+    QVERIFY(value.isNull());
+    QVERIFY(!session.contains("foo"));
+    QVERIFY(!session.isModified());
+}
+
+
+void TestSession::assign()
+{
+    TSession session("assign");
+    session["foo"] = 1;
+    QVERIFY(session.isModified());
+    QCOMPARE(session.value("foo").toInt(), 1);
+
+    // Through another item
+    session["bar"] = session["foo"];
+    QCOMPARE(session.value("bar").toInt(), 1);
+    QCOMPARE(session.count(), 2);
+}
+
+
+void TestSession::assignFound()
+{
+    TSessionSqlObjectStore store;
+    TSession session("assignfound");
+    session.insert("foo", 1);
+    QVERIFY(store.store(session));
+
+    TSession found = store.find(session.id());
+    QCOMPARE(found["foo"].toInt(), 1);
+    QVERIFY(found["bar"].isNull());
+    QVERIFY(!found.contains("bar"));
+    QVERIFY(!found.isModified());
+
+    found["foo"] = 1;  // same value
+    QVERIFY(!found.isModified());
+    found["foo"] = 2;
+    QVERIFY(found.isModified());
+    QCOMPARE(found.value("foo").toInt(), 2);
+}
+
+
+void TestSession::removeMissing()
+{
+    TSessionSqlObjectStore store;
+    TSession session("removemissing");
+    session.insert("foo", 1);
+    QVERIFY(store.store(session));
+
+    TSession found = store.find(session.id());
+    QCOMPARE(found.remove("bar"), 0);
+    QVERIFY(found.take("bar").isNull());
+    QVERIFY(!found.isModified());
+    QCOMPARE(found.remove("foo"), 1);
+    QVERIFY(found.isModified());
+}
+
+
+void TestSession::touchThrottle()
+{
+    TSessionSqlObjectStore store;
+    TSession session("touchthrottle");
+    session.insert("foo", 1);
+    QVERIFY(store.store(session));
+
+    // Within the interval, 60 secs for the lifetime of 1800 secs
+    const QDateTime recent = TClock::currentDateTime().addSecs(-30);
+    QVERIFY(setUpdatedAt(session.id(), recent));
+    TSession found = store.find(session.id());
+    QCOMPARE(found.value("foo").toInt(), 1);
+    QVERIFY(store.touch(found));
+    QVERIFY(isClose(updatedAt(session.id()), recent));
+
+    // Beyond the interval
+    const QDateTime old = TClock::currentDateTime().addSecs(-120);
+    QVERIFY(setUpdatedAt(session.id(), old));
+    found = store.find(session.id());
+    QCOMPARE(found.value("foo").toInt(), 1);
+    QVERIFY(store.touch(found));
+    QVERIFY(isClose(updatedAt(session.id()), TClock::currentDateTime()));
+}
+
+
+void TestSession::touchOther()
+{
+    TSessionSqlObjectStore store;
+    TSession session1("touchother1");
+    TSession session2("touchother2");
+    QVERIFY(store.store(session1));
+    QVERIFY(store.store(session2));
+
+    const QDateTime recent = TClock::currentDateTime().addSecs(-30);
+    QVERIFY(setUpdatedAt(session1.id(), recent));
+    QVERIFY(setUpdatedAt(session2.id(), recent));
+
+    // Not found by this store last
+    store.find(session1.id());
+    QVERIFY(store.touch(session2));
+    QVERIFY(isClose(updatedAt(session2.id()), TClock::currentDateTime()));
+    QVERIFY(isClose(updatedAt(session1.id()), recent));
+
+    // Removed meanwhile
+    TSession session3("touchother3");
+    session3.insert("foo", 1);
+    QVERIFY(store.touch(session3));
+    QCOMPARE(store.find(session3.id()).value("foo").toInt(), 1);
+}
+
+
+TF_TEST_MAIN(TestSession)
+#include "main.moc"
@@ -0,0 +1,4 @@
+include(../test.pri)
+TARGET = session
+SOURCES = main.cpp
+testAppSettings(Session.StoreType=sqlobject, Cache.SettingsFile=)
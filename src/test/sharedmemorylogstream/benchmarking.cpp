@@ -1,10 +1,27 @@
 #include <TfTest/TfTest>
 #include <TSystemGlobal>
+#include "tsharedmemorylogring.h"
 #include "tsharedmemorylogstream.h"
+#include "tprocessinfo.h"
 #include "tbasiclogstream.h"
 #include "tfilelogger.h"
 #include "tfileaiologger.h"
 #include "tfileaiowriter.h"
+#include <QSharedMemory>
+#include <atomic>
+
+
+class MemoryLogger : public TLogger
+{
+public:
+    QString key() const override { return "Memory"; }
+    bool isMultiProcessSafe() const override { return true; }
+    bool open() override { return true; }
+    void close() override { }
+    bool isOpen() const override { return true; }
+    void log(const TLog &log) override { messages << log.message; }
+    QByteArrayList messages;
+};
 
 
 class BenchMark : public QObject
@@ -19,6 +36,8 @@ private slots:
     void rawWriteLog();
     void aioWriteLog();
     void aioWriter();
+    void staleReservation();
+    void slowProducer();
     void cleanupTestCase();
 };
 
@@ -188,6 +207,63 @@ void BenchMark::aioWriter()
 }
 
 
+void BenchMark::staleReservation()
+{
+    MemoryLogger logger;
+    TSharedMemoryLogStream stream({&logger});
+    stream.flush();
+    logger.messages.clear();
+
+    // Reserves a slot for a process that does not exist, as a producer
+    // crashing before publishing leaves it
+    QSharedMemory memory("TreeFrogLogStream");
+    QVERIFY(memory.attach());
+    memory.lock();
+    auto *header = TSharedMemoryLogRing::header(memory.data());
+    quint64 pos = header->reserveIndex.fetch_add(1);
+    TSharedMemoryLogRing::slotAt(header, pos)->owner.store(0x7FFFFFF0);
+    memory.unlock();
+
+    stream.writeLog(TLog(1, "after the crash"));
+    stream.flush();
+    QCOMPARE(logger.messages, QByteArrayList({"after the crash"}));
+}
+
+
+void BenchMark::slowProducer()
+{
+    MemoryLogger logger;
+    TSharedMemoryLogStream stream({&logger});
+    stream.flush();
+    logger.messages.clear();
+
+    // Reserves a slot for a process alive, as a slow producer does
+    QSharedMemory memory("TreeFrogLogStream");
+    QVERIFY(memory.attach());
+    memory.lock();
+    auto *header = TSharedMemoryLogRing::header(memory.data());
+    quint64 pos = header->reserveIndex.fetch_add(1);
+    auto *slot = TSharedMemoryLogRing::slotAt(header, pos);
+    slot->owner.store(TProcessInfo(QCoreApplication::applicationPid()).ppid());
+    memory.unlock();
+
+    stream.writeLog(TLog(1, "after the slow"));
+    stream.flush();
+    QVERIFY(logger.messages.isEmpty());  // waits for the slot
+
+    // Publishes the slot
+    const QByteArray message("slow");
+    slot->timestamp = QDateTime::currentMSecsSinceEpoch();
+    slot->priority = 1;
+    slot->length = message.length();
+    memcpy(TSharedMemoryLogRing::slotData(slot), message.constData(), message.length());
+    slot->sequence.store(pos + 1);
+
+    stream.flush();
+    QCOMPARE(logger.messages, QByteArrayList({"slow", "after the slow"}));
+}
+
+
 void BenchMark::cleanupTestCase()
 {
     QDir logDir("log");
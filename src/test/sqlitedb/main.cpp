@@ -16,6 +16,7 @@ private slots:
     void initTestCase();
     void cleanupTestCase();
     void test();
+    void multi();
     void insert_data();
     void insert();
     void bench_insert_binary();
@@ -92,6 +93,39 @@ void TestCache::test()
     TCacheFactory::destroy("sqlite", cache);
 }
 
+void TestCache::multi()
+{
+    TCacheStore *cache = TCacheFactory::create("sqlite");
+    cache->open();
+    cache->clear();
+
+    // More keys than one statement takes
+    QMap<QByteArray, QByteArray> values;
+    for (int i = 0; i < 700; i++) {
+        QByteArray key = "multi" + QByteArray::number(i);
+        values.insert(key, genval(key));
+    }
+    QVERIFY(cache->setMulti(values, 60));
+
+    QByteArrayList keys = values.keys();
+    keys << "nokey";
+    QCOMPARE(cache->getMulti(keys), values);
+
+    // Overwrites the existing ones
+    QVERIFY(cache->setMulti({{"multi0", "x"}, {"multi1", "y"}}, 60));
+    QCOMPARE(cache->get("multi0"), QByteArray("x"));
+    QCOMPARE(cache->get("multi1"), QByteArray("y"));
+
+    // The expired ones are not returned
+    QVERIFY(cache->setMulti({{"expired", "z"}}, 1));
+    Tf::msleep(1100);
+    QVERIFY(cache->getMulti({"expired"}).isEmpty());
+
+    QCOMPARE(cache->removeMulti(keys), 700);
+    QVERIFY(cache->getMulti(keys).isEmpty());
+    TCacheFactory::destroy("sqlite", cache);
+}
+
 void TestCache::insert_data()
 {
     QTest::addColumn<QByteArray>("key");
@@ -1,3 +1,4 @@
 include(../test.pri)
 TARGET = sqlitedb
 SOURCES = main.cpp
+testAppSettings()
@@ -0,0 +1,42 @@
+#pragma once
+#include <TSqlObject>
+#include <QSharedData>
+
+
+class ItemObject : public TSqlObject, public QSharedData
+{
+public:
+    int id {0};
+    QString name;
+    int qty {0};
+
+    enum PropertyIndex {
+        Id = 0,
+        Name,
+        Qty,
+    };
+
+    int primaryKeyIndex() const override { return Id; }
+    int autoValueIndex() const override { return Id; }
+    QString tableName() const override { return QLatin1String("item"); }
+
+    const TModelField *modelFields() const override
+    {
+        static constexpr TModelField fields[] = {
+            T_MODEL_FIELD(ItemObject, int, id),
+            T_MODEL_FIELD(ItemObject, QString, name),
+            T_MODEL_FIELD(ItemObject, int, qty),
+            {nullptr, nullptr, nullptr},
+        };
+        return fields;
+    }
+
+private:    /*** Don't modify below this line ***/
+    Q_OBJECT
+    Q_PROPERTY(int id READ getid WRITE setid)
+    T_DEFINE_PROPERTY(int, id)
+    Q_PROPERTY(QString name READ getname WRITE setname)
+    T_DEFINE_PROPERTY(QString, name)
+    Q_PROPERTY(int qty READ getqty WRITE setqty)
+    T_DEFINE_PROPERTY(int, qty)
+};
@@ -0,0 +1,528 @@
+#include <TfTest/TfTest>
+#include <TSqlORMapper>
+#include <TSqlQuery>
+#include <QVersionNumber>
+#include <TDatabaseContext>
+#include "tclientcertificatecache.h"
+#include "tsqluserconnectioncache.h"
+#include "itemobject.h"
+#include "plainitemobject.h"
+
+static const QString SELECT_ITEMS("SELECT id, name, qty FROM item ORDER BY id");
+
+
+class DatabaseContext : public TDatabaseContext
+{
+public:
+    // Not by value; a copy of the transaction rolls it back when destroyed
+    bool isCheckedOut(int id) { return sqlDatabases[id].tdatabase().sqlDatabase().isValid(); }
+    bool isActive(int id) { return sqlDatabases[id].isActive(); }
+    bool isReplicaCheckedOut(int id) const { return replicaDatabases.value(id).isValid(); }
+};
+
+
+class TestSqlOrm : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void init();
+    void statementCacheModelCopy();
+    void statementCacheQueryCopy();
+    void statementCacheMapper();
+    void tableModel();
+    void findEach();
+    void findEachStop();
+    void modelFields();
+    void modelFieldsReordered();
+    void insertAll();
+    void upsertAll();
+    void criteriaShape_data();
+    void criteriaShape();
+    void criteriaBinding();
+    void deferredCheckout();
+    void readReplica();
+    void userConnectionPin();
+    void commonName_data();
+    void commonName();
+};
+
+// RETURNING is available as of SQLite 3.35
+static bool supportsReturning()
+{
+    TSqlQuery query;
+    return query.exec("SELECT sqlite_version()") && query.next()
+        && QVersionNumber::fromString(query.value(0).toString()) >= QVersionNumber(3, 35);
+}
+
+
+void TestSqlOrm::initTestCase()
+{
+    TSqlQuery query;
+    QVERIFY(query.exec("DROP TABLE IF EXISTS item"));
+    QVERIFY(query.exec("CREATE TABLE item (id INTEGER PRIMARY KEY AUTOINCREMENT, name VARCHAR(64), qty INTEGER)"));
+
+    // Visible to the other connections
+    QVERIFY(TDatabaseContext::currentDatabaseContext()->commitTransaction(0));
+}
+
+
+void TestSqlOrm::init()
+{
+    TSqlQuery query;
+    QVERIFY(query.exec("DELETE FROM item"));
+
+    const QStringList names = {"a", "b", "c"};
+    for (int i = 0; i < names.count(); ++i) {
+        ItemObject item;
+        item.name = names[i];
+        item.qty = i + 1;
+        QVERIFY(item.create());
+    }
+}
+
+
+void TestSqlOrm::statementCacheModelCopy()
+{
+    // A model reading a copy of the result outlives the query
+    QSqlQueryModel model;
+    {
+        TSqlQuery query;
+        query.prepare(SELECT_ITEMS);
+        QVERIFY(query.exec());
+        model.setQuery(query);
+    }
+
+    // Same SQL through the statement cache
+    for (int i = 0; i < 3; ++i) {
+        TSqlQuery query;
+        query.setStatementCacheEnabled(true);
+        query.prepare(SELECT_ITEMS);
+        QVERIFY(query.exec());
+        QVERIFY(query.next());
+        QCOMPARE(query.value(1).toString(), QString("a"));
+    }
+
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(model.record(0).value("name").toString(), QString("a"));
+    QCOMPARE(model.record(2).value("name").toString(), QString("c"));
+}
+
+
+void TestSqlOrm::statementCacheQueryCopy()
+{
+    // A copy keeps the statement out of the cache
+    TSqlQuery copy;
+    {
+        TSqlQuery query;
+        query.setStatementCacheEnabled(true);
+        query.prepare(SELECT_ITEMS);
+        QVERIFY(query.exec());
+        copy = query;
+    }
+
+    TSqlQuery other;
+    other.setStatementCacheEnabled(true);
+    other.prepare(SELECT_ITEMS);
+    QVERIFY(other.exec());
+    QVERIFY(other.next());
+    QVERIFY(other.next());
+
+    QVERIFY(copy.next());
+    QCOMPARE(copy.value(1).toString(), QString("a"));
+    QVERIFY(copy.next());
+    QCOMPARE(copy.value(1).toString(), QString("b"));
+}
+
+
+void TestSqlOrm::statementCacheMapper()
+{
+    TSqlORMapper<ItemObject> mapper;
+    mapper.setSortOrder(ItemObject::Id, Tf::AscendingOrder);
+    QCOMPARE(mapper.find(), 3);
+
+    {
+        TSqlORMapper<ItemObject> other;
+        QCOMPARE(other.findCount(), 3);
+        QCOMPARE(other.findCount(TCriteria(ItemObject::Qty, TSql::GreaterThan, 1)), 2);
+        QCOMPARE(other.find(TCriteria(ItemObject::Name, "b")), 1);
+    }
+
+    QCOMPARE(mapper.rowCount(), 3);
+    QCOMPARE(mapper.value(2).name, QString("c"));
+}
+
+
+void TestSqlOrm::tableModel()
+{
+    // The schema comes from the schema cache, not from setTable()
+    TSqlORMapper<ItemObject> mapper;
+    QSqlTableModel *model = &mapper;
+    QCOMPARE(mapper.tableName(), QString("item"));
+    QCOMPARE(mapper.record().count(), 3);
+    QCOMPARE(mapper.record().fieldName(1), QString("name"));
+    QCOMPARE(model->primaryKey().fieldName(0), QString("id"));
+    QVERIFY(model->tableName().isEmpty());
+
+    QCOMPARE(mapper.find(), 3);
+    QCOMPARE(model->record(0).value(1).toString(), mapper.first().name);
+    mapper.reset();
+    QCOMPARE(mapper.tableName(), QString("item"));
+    QCOMPARE(mapper.record().count(), 3);
+    QCOMPARE(model->primaryKey().fieldName(0), QString("id"));
+    QCOMPARE(mapper.find(), 3);
+}
+
+
+void TestSqlOrm::findEach()
+{
+    TSqlORMapper<ItemObject> mapper;
+    mapper.setSortOrder(ItemObject::Id, Tf::DescendingOrder);
+
+    QStringList names;
+    int sum = 0;
+    int cnt = mapper.findEach(TCriteria(ItemObject::Qty, TSql::GreaterEqual, 2), [&](const ItemObject &item) {
+        names << item.name;
+        sum += item.qty;
+        return true;
+    });
+    QCOMPARE(cnt, 2);
+    QCOMPARE(names, QStringList({"c", "b"}));
+    QCOMPARE(sum, 5);
+    QCOMPARE(mapper.rowCount(), 0);  // not kept in the mapper
+}
+
+
+void TestSqlOrm::findEachStop()
+{
+    TSqlORMapper<ItemObject> mapper;
+    mapper.setSortOrder(ItemObject::Id, Tf::AscendingOrder);
+
+    QString last;
+    int cnt = mapper.findEach(TCriteria(), [&](const ItemObject &item) {
+        last = item.name;
+        return item.name != "b";
+    });
+    QCOMPARE(cnt, 2);
+    QCOMPARE(last, QString("b"));
+}
+
+
+void TestSqlOrm::modelFields()
+{
+    // Same results through the field descriptors and the meta-object
+    TSqlORMapper<ItemObject> mapper;
+    TSqlORMapper<PlainItemObject> plainMapper;
+    mapper.setSortOrder(ItemObject::Id);
+    plainMapper.setSortOrder(PlainItemObject::Id);
+    QCOMPARE(mapper.find(), 3);
+    QCOMPARE(plainMapper.find(), 3);
+
+    for (int i = 0; i < 3; ++i) {
+        ItemObject item = mapper.value(i);
+        PlainItemObject plain = plainMapper.value(i);
+        QCOMPARE(item.name, plain.name);
+        QCOMPARE(item.qty, i + 1);
+        QCOMPARE(item.toVariantMap(), plain.toVariantMap());
+    }
+
+    ItemObject item;
+    PlainItemObject plain;
+    QCOMPARE(item.propertyNames(), plain.propertyNames());
+
+    QVariantMap values {{"name", "d"}, {"qty", 4}};
+    item.setProperties(values);
+    QCOMPARE(item.name, QString("d"));
+    QCOMPARE(item.qty, 4);
+    QVERIFY(item.create());
+
+    TSqlORMapper<PlainItemObject> check;
+    plain = check.findFirst(TCriteria(PlainItemObject::Id, item.id));
+    QCOMPARE(plain.name, QString("d"));
+    QCOMPARE(plain.qty, 4);
+}
+
+
+void TestSqlOrm::modelFieldsReordered()
+{
+    // Columns in another order than the fields, as after ALTER TABLE
+    QSqlRecord rec;
+    rec.append(QSqlField("qty", QVariant::Int));
+    rec.append(QSqlField("name", QVariant::String));
+    rec.append(QSqlField("id", QVariant::Int));
+    rec.setValue(0, 7);
+    rec.setValue(1, "x");
+    rec.setValue(2, 10);
+
+    ItemObject item;
+    item.setRecord(rec, QSqlError());
+    QCOMPARE(item.id, 10);
+    QCOMPARE(item.name, QString("x"));
+    QCOMPARE(item.qty, 7);
+}
+
+
+void TestSqlOrm::insertAll()
+{
+    QList<ItemObject> items;
+    for (int i = 0; i < 10; ++i) {
+        ItemObject item;
+        item.name = QString("x%1").arg(i);
+        item.qty = i % 3;  // some rows with the same qty
+        items << item;
+    }
+
+    TSqlORMapper<ItemObject> mapper;
+    QCOMPARE(mapper.insertAll(items), 10);
+    QCOMPARE(mapper.findCount(), 13);
+
+    if (!supportsReturning()) {
+        QSKIP("RETURNING not supported by this SQLite");
+    }
+
+    // Each object gets the key of its own row
+    QSet<int> ids;
+    for (auto &item : items) {
+        QVERIFY(item.id > 0);
+        ids << item.id;
+        ItemObject stored = mapper.findByPrimaryKey(item.id);
+        QCOMPARE(stored.name, item.name);
+        QCOMPARE(stored.qty, item.qty);
+    }
+    QCOMPARE(ids.count(), 10);
+}
+
+
+void TestSqlOrm::upsertAll()
+{
+    TSqlORMapper<ItemObject> mapper;
+    ItemObject a = mapper.findFirst(TCriteria(ItemObject::Name, "a"));
+    ItemObject c = mapper.findFirst(TCriteria(ItemObject::Name, "c"));
+    QVERIFY(a.id > 0 && c.id > 0);
+
+    // New and existing rows, not in key order
+    ItemObject d;
+    d.id = c.id + 100;
+    d.name = "d";
+    d.qty = 4;
+    c.qty = 30;
+    a.qty = 10;
+    QList<ItemObject> items {d, c, a};
+
+    QCOMPARE(mapper.upsertAll(items), 3);
+    QCOMPARE(mapper.findCount(), 4);
+    QCOMPARE(mapper.findFirst(TCriteria(ItemObject::Name, "c")).qty, 30);
+    QCOMPARE(mapper.findFirst(TCriteria(ItemObject::Name, "a")).qty, 10);
+
+    if (!supportsReturning()) {
+        QSKIP("RETURNING not supported by this SQLite");
+    }
+
+    // Matched by the keys
+    QCOMPARE(items[0].name, QString("d"));
+    QCOMPARE(items[0].id, d.id);
+    QCOMPARE(items[1].name, QString("c"));
+    QCOMPARE(items[1].qty, 30);
+    QCOMPARE(items[2].name, QString("a"));
+    QCOMPARE(items[2].qty, 10);
+}
+
+
+void TestSqlOrm::criteriaShape_data()
+{
+    QTest::addColumn<TCriteria>("cri1");
+    QTest::addColumn<TCriteria>("cri2");
+    QTest::addColumn<bool>("sameSql");
+
+    QTest::newRow("1") << TCriteria(ItemObject::Name, "a") << TCriteria(ItemObject::Name, "b") << true;
+    QTest::newRow("2") << TCriteria(ItemObject::Qty, TSql::GreaterThan, 1) << TCriteria(ItemObject::Qty, TSql::GreaterThan, 100) << true;
+    QTest::newRow("3") << TCriteria(ItemObject::Qty, TSql::GreaterThan, 1) << TCriteria(ItemObject::Qty, TSql::LessThan, 1) << false;
+    QTest::newRow("4") << TCriteria(ItemObject::Qty, TSql::In, QVariantList({1, 2})) << TCriteria(ItemObject::Qty, TSql::In, QVariantList({3, 4})) << true;
+    QTest::newRow("5") << TCriteria(ItemObject::Qty, TSql::In, QVariantList({1, 2})) << TCriteria(ItemObject::Qty, TSql::In, QVariantList({1, 2, 3})) << false;
+    QTest::newRow("6") << TCriteria(ItemObject::Name, "a") << TCriteria(ItemObject::Name, QVariant()) << true;
+    QTest::newRow("7") << TCriteria(ItemObject::Name, "a") << TCriteria(ItemObject::Qty, 1) << false;
+    QTest::newRow("8") << (TCriteria(ItemObject::Name, "a") && TCriteria(ItemObject::Qty, 1)) << (TCriteria(ItemObject::Name, "b") && TCriteria(ItemObject::Qty, 2)) << true;
+    QTest::newRow("9") << (TCriteria(ItemObject::Name, "a") && TCriteria(ItemObject::Qty, 1)) << (TCriteria(ItemObject::Name, "a") || TCriteria(ItemObject::Qty, 1)) << false;
+}
+
+
+void TestSqlOrm::criteriaShape()
+{
+    QFETCH(TCriteria, cri1);
+    QFETCH(TCriteria, cri2);
+    QFETCH(bool, sameSql);
+
+    QSqlDatabase db = Tf::currentSqlDatabase(0);
+    QVariantList values1, values2;
+    QString sql1 = TCriteriaConverter<ItemObject>(cri1, db).toString(values1);
+    QString sql2 = TCriteriaConverter<ItemObject>(cri2, db).toString(values2);
+    QCOMPARE(sql1 == sql2, sameSql);
+    QCOMPARE(sql1.count('?'), values1.count());
+    QCOMPARE(sql2.count('?'), values2.count());
+
+    // The same SQL on every call
+    QVariantList values3;
+    QCOMPARE(TCriteriaConverter<ItemObject>(cri1, db).toString(values3), sql1);
+    QCOMPARE(values3, values1);
+}
+
+
+void TestSqlOrm::criteriaBinding()
+{
+    // Values are bound, not inlined
+    ItemObject quote;
+    quote.name = "o'neil";
+    quote.qty = 5;
+    QVERIFY(quote.create());
+
+    TSqlORMapper<ItemObject> mapper;
+    QCOMPARE(mapper.find(TCriteria(ItemObject::Name, "o'neil")), 1);
+    QCOMPARE(mapper.first().qty, 5);
+    QCOMPARE(mapper.findCount(TCriteria(ItemObject::Name, TSql::BeginsWith, "o'")), 1);
+    QCOMPARE(mapper.findCount(TCriteria(ItemObject::Qty, TSql::In, QVariantList({1, 3, 5}))), 3);
+    QCOMPARE(mapper.findCount(TCriteria(ItemObject::Qty, TSql::Between, QVariantList({2, 3}))), 2);
+    QCOMPARE(mapper.findCount(TCriteria(ItemObject::Name, TSql::IsNull)), 0);
+
+    // Same shape, other values
+    QCOMPARE(mapper.find(TCriteria(ItemObject::Name, "b")), 1);
+    QCOMPARE(mapper.first().qty, 2);
+
+    QCOMPARE(mapper.updateAll(TCriteria(ItemObject::Qty, TSql::GreaterThan, 2), ItemObject::Name, "z"), 2);
+    QCOMPARE(mapper.findCount(TCriteria(ItemObject::Name, "z")), 2);
+    QCOMPARE(mapper.removeAll(TCriteria(ItemObject::Name, "z")), 2);
+    QCOMPARE(mapper.findCount(), 2);
+}
+
+
+void TestSqlOrm::deferredCheckout()
+{
+    DatabaseContext context;
+    context.setTransactionEnabled(true);
+    QVERIFY(!context.isCheckedOut(0));
+
+    // Nothing to commit in a request without database access
+    context.commitTransactions();
+    QVERIFY(!context.isCheckedOut(0));
+
+    // Checked out and begun on first use, once
+    QSqlDatabase &db = context.getSqlDatabase(0);
+    QVERIFY(db.isValid());
+    QVERIFY(context.isCheckedOut(0));
+    QVERIFY(context.isActive(0));
+    QCOMPARE(&context.getSqlDatabase(0), &db);
+    QVERIFY(context.isActive(0));
+
+    context.commitTransactions();
+    QVERIFY(!context.isCheckedOut(0));
+    QVERIFY(!context.isActive(0));
+    context.release();
+}
+
+
+void TestSqlOrm::readReplica()
+{
+    // Another request
+    TDatabaseContext *current = TDatabaseContext::currentDatabaseContext();
+    DatabaseContext context;
+    TDatabaseContext::setCurrentDatabaseContext(nullptr);
+    TDatabaseContext::setCurrentDatabaseContext(&context);
+
+    {
+        // Other rows on the replica, to tell where the reads go
+        TSqlQuery query(context.getReadSqlDatabase(0));
+        QVERIFY(query.exec("CREATE TABLE IF NOT EXISTS item (id INTEGER PRIMARY KEY AUTOINCREMENT, name VARCHAR(64), qty INTEGER)"));
+        QVERIFY(query.exec("DELETE FROM item"));
+        QVERIFY(query.exec("INSERT INTO item (name, qty) VALUES ('replica', 1)"));
+    }
+    QVERIFY(context.isReplicaCheckedOut(0));
+    QVERIFY(!context.isCheckedOut(0));
+
+    {
+        TSqlORMapper<ItemObject> mapper;
+        QCOMPARE(mapper.find(), 1);
+        QCOMPARE(mapper.first().name, QString("replica"));
+        QCOMPARE(mapper.findCount(TCriteria(ItemObject::Name, "replica")), 1);
+        int cnt = mapper.findEach(TCriteria(), [](const ItemObject &) { return true; });
+        QCOMPARE(cnt, 1);
+    }
+    QVERIFY(!context.isCheckedOut(0));
+
+    context.commitTransactions();
+    QVERIFY(!context.isReplicaCheckedOut(0));
+
+    {
+        // A mapper for writes checks out no replica
+        TSqlORMapper<ItemObject> mapper(Tf::ReadPrimary);
+        QVERIFY(context.isCheckedOut(0));
+        QVERIFY(!context.isReplicaCheckedOut(0));
+    }
+
+    {
+        // Reads see the primary once it is used
+        TSqlORMapper<ItemObject> mapper;
+        QCOMPARE(mapper.findCount(TCriteria(ItemObject::Name, "replica")), 0);
+        QVERIFY(!context.isReplicaCheckedOut(0));
+    }
+
+    context.release();
+    TDatabaseContext::setCurrentDatabaseContext(nullptr);
+    TDatabaseContext::setCurrentDatabaseContext(current);
+}
+
+
+void TestSqlOrm::userConnectionPin()
+{
+    TSqlUserConnectionCache cache(1);
+    auto create = []() { return true; };
+
+    // Pinned from checkout until release, although not in use yet
+    QVERIFY(cache.checkout("pin_a", create));
+    QVERIFY(cache.checkout("pin_b", create));
+    QCOMPARE(cache.count(), 2);
+    QCOMPARE(cache.evictionCount(), 0ULL);
+
+    cache.release("pin_a");
+    QVERIFY(cache.checkout("pin_c", create));
+    QCOMPARE(cache.count(), 2);
+    QCOMPARE(cache.evictionCount(), 1ULL);
+
+    // Checked out twice, pinned until released twice
+    QVERIFY(cache.checkout("pin_b", create));
+    cache.release("pin_b");
+    cache.release("pin_c");
+    QVERIFY(cache.checkout("pin_d", create));
+    QCOMPARE(cache.evictionCount(), 2ULL);  // pin_c
+    QCOMPARE(cache.count(), 2);
+}
+
+
+void TestSqlOrm::commonName_data()
+{
+    QTest::addColumn<QString>("commonName");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("1") << "alice" << true;
+    QTest::newRow("2") << "Alice Smith" << true;
+    QTest::newRow("3") << "alice@example.com" << true;
+    QTest::newRow("4") << "" << false;
+    QTest::newRow("5") << "." << false;
+    QTest::newRow("6") << ".." << false;
+    QTest::newRow("7") << "../alice" << false;
+    QTest::newRow("8") << "a\\b" << false;
+    QTest::newRow("9") << "a\nb" << false;
+    QTest::newRow("10") << QString(65, 'a') << false;
+}
+
+
+void TestSqlOrm::commonName()
+{
+    QFETCH(QString, commonName);
+    QFETCH(bool, valid);
+
+    QCOMPARE(TClientCertificateCache::isValidCommonName(commonName), valid);
+    QCOMPARE(TClientCertificateCache::certificatePath("cert", commonName).isEmpty(), !valid);
+}
+
+
+TF_TEST_MAIN(TestSqlOrm)
+#include "main.moc"
@@ -0,0 +1,32 @@
+#pragma once
+#include <TSqlObject>
+#include <QSharedData>
+
+
+// Without the field descriptors, as generated by older versions
+class PlainItemObject : public TSqlObject, public QSharedData
+{
+public:
+    int id {0};
+    QString name;
+    int qty {0};
+
+    enum PropertyIndex {
+        Id = 0,
+        Name,
+        Qty,
+    };
+
+    int primaryKeyIndex() const override { return Id; }
+    int autoValueIndex() const override { return Id; }
+    QString tableName() const override { return QLatin1String("item"); }
+
+private:    /*** Don't modify below this line ***/
+    Q_OBJECT
+    Q_PROPERTY(int id READ getid WRITE setid)
+    T_DEFINE_PROPERTY(int, id)
+    Q_PROPERTY(QString name READ getname WRITE setname)
+    T_DEFINE_PROPERTY(QString, name)
+    Q_PROPERTY(int qty READ getqty WRITE setqty)
+    T_DEFINE_PROPERTY(int, qty)
+};
@@ -0,0 +1,5 @@
+include(../test.pri)
+TARGET = sqlorm
+HEADERS = itemobject.h plainitemobject.h
+SOURCES = main.cpp
+testAppSettings()
@@ -22,3 +22,15 @@ win32 {
   LIBS += -Wl,-rpath,../../ -L../../ -ltreefrog
   linux-*:LIBS += -lrt
 }
+
+# Writes config/application.ini of the test from the shared fixture
+# ../config/application.ini, overriding the given settings,
+# e.g. testAppSettings(Cache.Backend=memory, Session.StoreType=cookie)
+defineTest(testAppSettings) {
+  settings = $$cat($$PWD/config/application.ini, lines)
+  for(setting, ARGS) {
+    key = $$section(setting, =, 0, 0)
+    settings = $$replace(settings, ^$${key}=.*$, $$setting)
+  }
+  write_file($$_PRO_FILE_PWD_/config/application.ini, settings)|error("Unable to write config/application.ini")
+}
@@ -7,6 +7,7 @@
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -118,6 +119,12 @@ inline int tf_write(int fd, const void *buf, size_t count)
 }
 
 
+inline int tf_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    TF_EINTR_LOOP(::writev(fd, iov, iovcnt));
+}
+
+
 inline int tf_recv(int sockfd, void *buf, size_t len, int flags = 0)
 {
     TF_EAGAIN_LOOP(::recv(sockfd, buf, len, flags));
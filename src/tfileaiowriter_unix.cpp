@@ -7,24 +7,238 @@
 
 #include "tfcore_unix.h"
 #include "tfileaiowriter.h"
-#include "tqueue.h"
+#include "tlogringbuffer.h"
+#include <QHash>
 #include <QList>
 #include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+#include <TAppSettings>
+#include <TAtomic>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
 
-constexpr int MAX_NUM_BUFFERING_DATA = 10000;
+constexpr int DEFAULT_RING_BUFFER_SIZE = 64 * 1024;  // bytes per thread
+constexpr int DRAIN_INTERVAL_MSECS = 50;
+constexpr int MAX_IOVEC_COUNT = 64;
+
+namespace {
+TAtomic<quint64> writerIdCounter {0};
+
+
+// Rings of the current thread, keyed by writer ID
+class ThreadRings : public QHash<quint64, std::shared_ptr<TLogRingBuffer>> {
+public:
+    ~ThreadRings()
+    {
+        for (auto &ring : *this) {
+            ring->setAbandoned();  // released by the writer thread when drained
+        }
+    }
+};
+
+thread_local ThreadRings threadRings;
+}
 
 
 class TFileAioWriterData {
 public:
-    mutable QMutex mutex;
+    enum OverflowPolicy {
+        Drop = 0,
+        Block,
+    };
+
+    mutable QMutex mutex;  // guards the members below and draining
     QString fileName;
-    int fileDescriptor;
-    TQueue<struct aiocb *> syncBuffer;
+    int fileDescriptor {0};
+    const quint64 id {++writerIdCounter};
+    int ringSize {DEFAULT_RING_BUFFER_SIZE};
+    OverflowPolicy policy {Drop};
+    QList<std::shared_ptr<TLogRingBuffer>> rings;
+    TAtomic<int> droppedCount {0};
+    int lastError {0};  // errno of the last failed write, reported once
 
     TFileAioWriterData() :
-        mutex(QMutex::Recursive), fileName(), fileDescriptor(0), syncBuffer() { }
+        mutex(QMutex::Recursive) { }
+    TLogRingBuffer *threadRing();
+    void drain();
+};
+
+
+class TLogWriterThread : public QThread {
+public:
+    static TLogWriterThread *instance();
+    void addWriter(TFileAioWriterData *writer);
+    void removeWriter(TFileAioWriterData *writer);
+    void wakeUp() { condition.wakeOne(); }
+
+protected:
+    void run() override;
+
+private:
+    TLogWriterThread() :
+        QThread() { }
+
+    QMutex mutex;
+    QWaitCondition condition;
+    QList<TFileAioWriterData *> writers;
 };
 
+
+TLogWriterThread *TLogWriterThread::instance()
+{
+    static TLogWriterThread *writerThread = []() {
+        auto *thread = new TLogWriterThread;
+        thread->start();
+        return thread;
+    }();
+    return writerThread;
+}
+
+
+void TLogWriterThread::addWriter(TFileAioWriterData *writer)
+{
+    QMutexLocker locker(&mutex);
+    if (!writers.contains(writer)) {
+        writers << writer;
+    }
+}
+
+
+void TLogWriterThread::removeWriter(TFileAioWriterData *writer)
+{
+    QMutexLocker locker(&mutex);
+    writers.removeAll(writer);
+}
+
+
+void TLogWriterThread::run()
+{
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        condition.wait(&mutex, DRAIN_INTERVAL_MSECS);
+
+        for (auto *writer : (const QList<TFileAioWriterData *> &)writers) {
+            QMutexLocker writerLocker(&writer->mutex);
+            writer->drain();
+        }
+    }
+}
+
+/*!
+  Returns the ring of the current thread, registering a new one on first
+  use. Called by producers only.
+*/
+TLogRingBuffer *TFileAioWriterData::threadRing()
+{
+    auto it = threadRings.constFind(id);
+    if (Q_LIKELY(it != threadRings.constEnd())) {
+        return it->get();
+    }
+
+    QMutexLocker locker(&mutex);
+    auto ring = std::make_shared<TLogRingBuffer>(ringSize);
+    rings << ring;
+    threadRings.insert(id, ring);
+    return ring.get();
+}
+
+/*!
+  Writes out the contents of all rings in batches. The mutex must be
+  held by the caller, which makes it the only consumer of the rings.
+  Data not written because of an error stays in the rings and is
+  written by the next call.
+*/
+void TFileAioWriterData::drain()
+{
+    if (fileDescriptor <= 0) {
+        return;
+    }
+
+    int dropped = droppedCount.exchange(0);
+    if (Q_UNLIKELY(dropped > 0)) {
+        QByteArray msg = QByteArray::number(dropped) + " log messages dropped: buffer full\n";
+        tf_write(fileDescriptor, msg.data(), msg.length());
+    }
+
+    struct iovec iov[MAX_IOVEC_COUNT];
+    TLogRingBuffer *batch[MAX_IOVEC_COUNT / 2];
+    int lengths[MAX_IOVEC_COUNT / 2];
+    int idx = 0;
+
+    while (idx < rings.count()) {
+        int iovcnt = 0;
+        int ringcnt = 0;
+
+        // Collects readable regions
+        for (; idx < rings.count() && iovcnt + 2 <= MAX_IOVEC_COUNT; ++idx) {
+            auto *ring = rings[idx].get();
+            const char *first, *second;
+            int firstLength, secondLength;
+            int len = ring->peek(first, firstLength, second, secondLength);
+            if (len == 0) {
+                continue;
+            }
+
+            iov[iovcnt++] = {(void *)first, (size_t)firstLength};
+            if (secondLength > 0) {
+                iov[iovcnt++] = {(void *)second, (size_t)secondLength};
+            }
+            batch[ringcnt] = ring;
+            lengths[ringcnt] = len;
+            ringcnt++;
+        }
+
+        // Writes all regions, continuing after a partial write
+        qint64 written = 0;
+        int err = 0;
+        struct iovec *cur = iov;
+        while (iovcnt > 0) {
+            int ret = tf_writev(fileDescriptor, cur, iovcnt);
+            if (ret <= 0) {
+                err = (ret < 0) ? errno : EIO;
+                break;
+            }
+            written += ret;
+            while (iovcnt > 0 && (size_t)ret >= cur->iov_len) {
+                ret -= cur->iov_len;
+                cur++;
+                iovcnt--;
+            }
+            if (iovcnt > 0) {
+                cur->iov_base = (char *)cur->iov_base + ret;
+                cur->iov_len -= ret;
+            }
+        }
+
+        // Releases only the bytes written; the rest is retried next time
+        for (int i = 0; i < ringcnt && written > 0; ++i) {
+            int len = (int)qMin((qint64)lengths[i], written);
+            batch[i]->consume(len);
+            written -= len;
+        }
+
+        if (Q_UNLIKELY(err)) {
+            if (err != lastError) {
+                std::fprintf(stderr, "log write error: %s  errno:%d\n", qPrintable(fileName), err);
+            }
+            lastError = err;
+            return;
+        }
+        lastError = 0;
+    }
+
+    // Releases the rings of finished threads
+    for (auto it = rings.begin(); it != rings.end();) {
+        if ((*it)->isAbandoned() && (*it)->size() == 0) {
+            it = rings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 /*!
   Constructor.
  */
@@ -44,28 +258,46 @@ TFileAioWriter::~TFileAioWriter()
 
 bool TFileAioWriter::open()
 {
-    QMutexLocker locker(&d->mutex);
+    {
+        QMutexLocker locker(&d->mutex);
 
-    if (d->fileDescriptor <= 0) {
-        if (d->fileName.isEmpty()) {
-            return false;
+        if (d->fileDescriptor <= 0) {
+            if (d->fileName.isEmpty()) {
+                return false;
+            }
+
+            if (Tf::appSettings()) {
+                d->ringSize = Tf::appSettings()->value(Tf::LogWriterBufferSize, DEFAULT_RING_BUFFER_SIZE).toInt();
+                QString policy = Tf::appSettings()->value(Tf::LogWriterOverflowPolicy).toString().trimmed().toLower();
+                d->policy = (policy == QLatin1String("block")) ? TFileAioWriterData::Block : TFileAioWriterData::Drop;
+            }
+
+            d->fileDescriptor = ::open(qPrintable(d->fileName), (O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC), 0666);
+            if (d->fileDescriptor < 0) {
+                //fprintf(stderr, "file open failed: %s\n", qPrintable(d->fileName));
+            }
         }
 
-        d->fileDescriptor = ::open(qPrintable(d->fileName), (O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC), 0666);
-        if (d->fileDescriptor < 0) {
-            //fprintf(stderr, "file open failed: %s\n", qPrintable(d->fileName));
+        if (d->fileDescriptor <= 0) {
+            return false;
         }
     }
 
-    return (d->fileDescriptor > 0);
+    TLogWriterThread::instance()->addWriter(d);
+    return true;
 }
 
 
 void TFileAioWriter::close()
 {
-    QMutexLocker locker(&d->mutex);
+    if (!isOpen()) {
+        return;
+    }
 
-    flush();
+    TLogWriterThread::instance()->removeWriter(d);
+
+    QMutexLocker locker(&d->mutex);
+    d->drain();
 
     if (d->fileDescriptor > 0) {
         tf_close(d->fileDescriptor);
@@ -79,7 +311,11 @@ bool TFileAioWriter::isOpen() const
     return (d->fileDescriptor > 0);
 }
 
-
+/*!
+  Appends the \a data to the ring of the current thread; the log writer
+  thread writes it to the file. Neither allocates nor calls the system
+  except for the first write from a thread or a message larger than the ring.
+ */
 int TFileAioWriter::write(const char *data, int length)
 {
     if (!isOpen()) {
@@ -90,95 +326,57 @@ int TFileAioWriter::write(const char *data, int length)
         return -1;
     }
 
-    if (d->syncBuffer.count() > 0) {
-        if (d->mutex.tryLock()) {
-            // check whether head's item  writing is finished
-            struct aiocb *headcb;
-            while (d->syncBuffer.head(headcb)) {
-                if (aio_error(headcb) == EINPROGRESS) {
-                    break;
-                }
-
-                if (d->syncBuffer.dequeue(headcb)) {
-                    delete[](char *) headcb->aio_buf;
-                    delete headcb;
-                } else {
-                    break;
-                }
-            }
-            d->mutex.unlock();
-        }
+    auto *ring = d->threadRing();
 
-        if (d->syncBuffer.count() > MAX_NUM_BUFFERING_DATA) {
-            flush();
-        }
+    if (Q_UNLIKELY(length > ring->capacity())) {
+        // Writes directly, keeping the order of this thread's messages
+        QMutexLocker locker(&d->mutex);
+        d->drain();
+        return (tf_write(d->fileDescriptor, data, length) > 0) ? 0 : -1;
     }
 
-    struct aiocb *cb = new struct aiocb;
-    memset(cb, 0, sizeof(struct aiocb));
-
-    cb->aio_fildes = d->fileDescriptor;
-    cb->aio_nbytes = length;
-    cb->aio_buf = new char[length];
-    memcpy((void *)cb->aio_buf, data, length);
-
-    int ret = tf_aio_write(cb);
-    int err = errno;
-
-    if (ret < 0) {
-        //fprintf(stderr, "aio_write error fd:%d (pid:%d tid:%d) ret:%d errno:%d\n", d->fileDescriptor, getpid(), gettid(), ret, err);
-        //fprintf(stderr, "aio_write str: %s\n", data);
-        delete[](char *) cb->aio_buf;
-        delete cb;
+    while (!ring->push(data, length)) {
+        if (d->policy == TFileAioWriterData::Drop) {
+            d->droppedCount++;
+            TLogWriterThread::instance()->wakeUp();
+            return -1;
+        }
 
-        if (err != EAGAIN) {
-            close();
-        } else {
-#ifdef Q_OS_DARWIN
-            // try sync-write
-            return (tf_write(d->fileDescriptor, data, length) > 0) ? 0 : -1;
-#endif
+        // Blocks until the writer thread makes room
+        TLogWriterThread::instance()->wakeUp();
+        QThread::msleep(1);
+        if (!isOpen()) {
+            return -1;
         }
-        return ret;
     }
 
-    d->syncBuffer.enqueue(cb);
+    if (ring->size() > ring->capacity() / 2) {
+        TLogWriterThread::instance()->wakeUp();
+    }
     return 0;
 }
 
-
+/*!
+  Writes out all the buffered data synchronously.
+ */
 void TFileAioWriter::flush()
 {
     if (!isOpen()) {
         return;
     }
 
-    if (d->syncBuffer.count() == 0) {
-        return;
-    }
-
     QMutexLocker locker(&d->mutex);
-    struct aiocb *headcb;
-
-    while (d->syncBuffer.count() > 0) {
-        if (d->syncBuffer.head(headcb) && aio_error(headcb) != EINPROGRESS) {
-            // Dequeue
-            if (d->syncBuffer.dequeue(headcb)) {
-                delete[](char *) headcb->aio_buf;
-                delete headcb;
-            }
-        }
-    }
+    d->drain();
 }
 
 
 void TFileAioWriter::setFileName(const QString &name)
 {
-    QMutexLocker locker(&d->mutex);
-
     if (isOpen()) {
         close();
     }
+
+    QMutexLocker locker(&d->mutex);
     d->fileName = name;
 }
 
@@ -203,6 +203,16 @@ enum AppAttribute {
     EnableForwardedForHeader,
     TrustedProxyServers,
     ActionMailerSmtpRequireTLS,
+    //
+    LogWriterBufferSize,
+    LogWriterOverflowPolicy,
+    //
+    CacheLocalCacheSize,
+    CacheLocalCacheTimeout,
+    CacheCompressionThreshold,
+    CacheCompressionHcThreshold,
+    SessionCompressionThreshold,
+    SessionCompressionDictionary,
 };
 
 // Reason codes why a web socket has been closed
@@ -233,6 +243,12 @@ enum LogPriority {
     TraceLevel,  //!< Finer-grained informational events than the DEBUG.
 };
 
+enum ReadPreference {
+    ReadAuto = 0,  //!< Replica, unless the primary has been used in the request.
+    ReadPrimary,  //!< Primary always.
+    ReadReplica,  //!< Replica always; may not see the writes of the request.
+};
+
 enum class KvsEngine {
     MongoDB = 0,
     Redis,
@@ -205,6 +205,16 @@ QSqlDatabase &Tf::currentSqlDatabase(int id) noexcept
     return currentDatabaseContext()->getSqlDatabase(id);
 }
 
+/*!
+  Returns a reference to the database for reading with the ID \a id,
+  which is a read replica if configured, in the current context.
+  \sa TDatabaseContext::getReadSqlDatabase()
+*/
+QSqlDatabase &Tf::currentReadSqlDatabase(int id, Tf::ReadPreference preference) noexcept
+{
+    return currentDatabaseContext()->getReadSqlDatabase(id, preference);
+}
+
 
 QMap<QByteArray, std::function<QObject *()>> *Tf::objectFactories() noexcept
 {
@@ -212,12 +212,19 @@ constexpr auto TF_SRC_REVISION = 2274;
     Class(Class &&) = delete; \
     Class &operator=(Class &&) = delete;
 
+// Calls the log function only if some logger outputs the priority, so
+// that the arguments of the printf-style form are not evaluated
+// otherwise. Still an expression: the stream form returns a no-op TDebug.
+#define T_LOG_IF_ENABLED(PRIORITY, FUNC, ...)                           \
+    (Tf::isAppLogEnabled(PRIORITY) ? TDebug(PRIORITY).FUNC(__VA_ARGS__) \
+                                   : decltype(TDebug(PRIORITY).FUNC(__VA_ARGS__))())
+
 #define tFatal TDebug(Tf::FatalLevel).fatal
-#define tError TDebug(Tf::ErrorLevel).error
-#define tWarn TDebug(Tf::WarnLevel).warn
-#define tInfo TDebug(Tf::InfoLevel).info
-#define tDebug TDebug(Tf::DebugLevel).debug
-#define tTrace TDebug(Tf::TraceLevel).trace
+#define tError(...) T_LOG_IF_ENABLED(Tf::ErrorLevel, error, __VA_ARGS__)
+#define tWarn(...) T_LOG_IF_ENABLED(Tf::WarnLevel, warn, __VA_ARGS__)
+#define tInfo(...) T_LOG_IF_ENABLED(Tf::InfoLevel, info, __VA_ARGS__)
+#define tDebug(...) T_LOG_IF_ENABLED(Tf::DebugLevel, debug, __VA_ARGS__)
+#define tTrace(...) T_LOG_IF_ENABLED(Tf::TraceLevel, trace, __VA_ARGS__)
 
 
 #include "tfexception.h"
@@ -254,6 +261,7 @@ T_CORE_EXPORT TCache *cache() noexcept;
 T_CORE_EXPORT TActionContext *currentContext();
 T_CORE_EXPORT TDatabaseContext *currentDatabaseContext();
 T_CORE_EXPORT QSqlDatabase &currentSqlDatabase(int id) noexcept;
+T_CORE_EXPORT QSqlDatabase &currentReadSqlDatabase(int id, Tf::ReadPreference preference = Tf::ReadAuto) noexcept;
 T_CORE_EXPORT QMap<QByteArray, std::function<QObject *()>> *objectFactories() noexcept;
 
 // LZ4 lossless compression algorithm
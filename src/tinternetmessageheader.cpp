@@ -5,6 +5,7 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclock.h"
 #include "thttputility.h"
 #include "tsystemglobal.h"
 #include <TInternetMessageHeader>
@@ -166,7 +167,7 @@ void TInternetMessageHeader::setDate(const QByteArray &date)
  */
 void TInternetMessageHeader::setCurrentDate()
 {
-    setDate(THttpUtility::getUTCTimeString());
+    setDate(TClock::httpDate());
 }
 
 /*!
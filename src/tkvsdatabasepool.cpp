@@ -6,7 +6,10 @@
  */
 
 #include "tkvsdatabasepool.h"
+#include "tclock.h"
 #include "tfnamespace.h"
+#include "tredisdriver.h"
+#include "tredismultiplexer.h"
 #include "tsqldatabasepool.h"
 #include "tsystemglobal.h"
 #include <QDateTime>
@@ -14,7 +17,6 @@
 #include <QStringList>
 #include <QThread>
 #include <TWebApplication>
-#include <ctime>
 
 /*!
   \class TKvsDatabasePool
@@ -100,7 +102,7 @@ void TKvsDatabasePool::init()
     }
 
     cachedDatabase = new TStack<QString>[kvsEngineHash()->count()];
-    lastCachedTime = new TAtomic<uint>[kvsEngineHash()->count()];
+    lastCachedTime = new TAtomic<qint64>[kvsEngineHash()->count()]();
     availableNames = new TStack<QString>[kvsEngineHash()->count()];
     bool aval = false;
 
@@ -260,6 +262,15 @@ bool TKvsDatabasePool::setDatabaseSettings(TKvsDatabase &database, Tf::KvsEngine
         database.setPostOpenStatements(postOpenStatements);
     }
 
+    // Shares the connections among all the threads
+    int sharedConnections = settings.value("SharedConnections").toInt();
+    auto *redis = dynamic_cast<TRedisDriver *>(database.driver());
+    if (redis && sharedConnections > 0) {
+        tSystemDebug("KVS SharedConnections: %d", sharedConnections);
+        QString name = QString::number((int)engine);
+        redis->setMultiplexer(TRedisMultiplexer::instance(name, hostName, port, sharedConnections, postOpenStatements));
+    }
+
     return true;
 }
 
@@ -274,7 +285,7 @@ void TKvsDatabasePool::pool(TKvsDatabase &database)
         }
 
         cachedDatabase[engine].push(database.connectionName());
-        lastCachedTime[engine].store((uint)std::time(nullptr));
+        lastCachedTime[engine].store(TClock::monotonicSecs());
         tSystemDebug("Pooled KVS database: %s", qPrintable(database.connectionName()));
     }
     database = TKvsDatabase();  // Sets an invalid object
@@ -293,7 +304,7 @@ void TKvsDatabasePool::timerEvent(QTimerEvent *event)
             }
 
             auto &cache = cachedDatabase[e];
-            while (lastCachedTime[e].load() < (uint)std::time(nullptr) - 30
+            while (TClock::monotonicSecs() - lastCachedTime[e].load() > 30
                 && cache.pop(name)) {
                 TKvsDatabase::database(name).close();
                 tSystemDebug("Closed KVS database connection, name: %s", qPrintable(name));
@@ -34,7 +34,7 @@ private:
     TKvsDatabasePool();
 
     TStack<QString> *cachedDatabase {nullptr};
-    TAtomic<uint> *lastCachedTime {nullptr};
+    TAtomic<qint64> *lastCachedTime {nullptr};
     TStack<QString> *availableNames {nullptr};
     int maxConnects {0};
     QBasicTimer timer;
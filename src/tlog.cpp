@@ -6,6 +6,7 @@
  */
 
 #include "TLog"
+#include "tclock.h"
 #include "tfcore.h"
 #include <QThread>
 
@@ -23,7 +24,7 @@
   Constructor.
 */
 TLog::TLog(int pri, const QByteArray &msg) :
-    timestamp(QDateTime::currentDateTime()),
+    timestamp(TClock::currentDateTime()),
     priority(pri),
     pid(QCoreApplication::applicationPid()),
 #ifdef Q_OS_UNIX
@@ -0,0 +1,98 @@
+#pragma once
+#include <TGlobal>
+#include <atomic>
+#include <cstring>
+
+/*
+  Single-producer/single-consumer byte ring for log records.
+  The producer is the thread owning the ring and the consumer is the log
+  writer thread. A record becomes visible to the consumer only after all
+  of its bytes have been copied, so records are never split.
+*/
+class TLogRingBuffer {
+public:
+    explicit TLogRingBuffer(int capacity);
+    ~TLogRingBuffer() { delete[] _buffer; }
+
+    int capacity() const { return (int)_capacity; }
+    int size() const;
+    bool push(const char *data, int length);
+    int peek(const char *&first, int &firstLength, const char *&second, int &secondLength) const;
+    void consume(int length);
+    bool isAbandoned() const { return _abandoned.load(std::memory_order_acquire); }
+    void setAbandoned() { _abandoned.store(true, std::memory_order_release); }
+
+private:
+    char *_buffer {nullptr};
+    quint64 _capacity {0};
+    alignas(64) std::atomic<quint64> _head {0};  // write position, owned by the producer
+    alignas(64) std::atomic<quint64> _tail {0};  // read position, owned by the consumer
+    std::atomic<bool> _abandoned {false};
+
+    T_DISABLE_COPY(TLogRingBuffer)
+    T_DISABLE_MOVE(TLogRingBuffer)
+};
+
+
+inline TLogRingBuffer::TLogRingBuffer(int capacity)
+{
+    // Rounds up to a power of two
+    _capacity = 1024;
+    while (_capacity < (quint64)capacity) {
+        _capacity <<= 1;
+    }
+    _buffer = new char[_capacity];
+}
+
+
+inline int TLogRingBuffer::size() const
+{
+    return (int)(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire));
+}
+
+/*!
+  Appends \a length bytes of \a data. Returns false if there is not
+  enough free space; nothing is written in that case.
+*/
+inline bool TLogRingBuffer::push(const char *data, int length)
+{
+    quint64 head = _head.load(std::memory_order_relaxed);
+    quint64 tail = _tail.load(std::memory_order_acquire);
+
+    if (length <= 0 || _capacity - (head - tail) < (quint64)length) {
+        return false;
+    }
+
+    quint64 idx = head & (_capacity - 1);
+    quint64 len = qMin((quint64)length, _capacity - idx);
+    std::memcpy(_buffer + idx, data, len);
+    std::memcpy(_buffer, data + len, length - len);
+    _head.store(head + length, std::memory_order_release);
+    return true;
+}
+
+/*!
+  Returns the number of readable bytes, which are exposed as up to two
+  contiguous regions. Consumer only.
+*/
+inline int TLogRingBuffer::peek(const char *&first, int &firstLength, const char *&second, int &secondLength) const
+{
+    quint64 head = _head.load(std::memory_order_acquire);
+    quint64 tail = _tail.load(std::memory_order_relaxed);
+    quint64 avail = head - tail;
+    quint64 idx = tail & (_capacity - 1);
+
+    first = _buffer + idx;
+    firstLength = (int)qMin(avail, _capacity - idx);
+    second = _buffer;
+    secondLength = (int)(avail - firstLength);
+    return (int)avail;
+}
+
+/*!
+  Releases \a length bytes returned by peek(). Consumer only.
+*/
+inline void TLogRingBuffer::consume(int length)
+{
+    _tail.store(_tail.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
@@ -0,0 +1,320 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tlz4compressor.h"
+#include "lz4.h"
+#include "lz4hc.h"
+#include "tsystemglobal.h"
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+/*!
+  \class TLz4Compressor
+  \brief The TLz4Compressor class compresses payloads with LZ4, choosing
+  how by their size.
+
+  The output starts with a 5-byte header: a magic, the format version
+  and a mode byte telling how the rest is stored: data smaller than
+  threshold() as is, data of hcThreshold() bytes or
+  more with LZ4 HC, which is slower but smaller, and the other data with
+  LZ4. Data that does not shrink is stored as is.
+  If a dictionary is set, data up to 64KB is compressed with it, which
+  works well for small payloads sharing content, e.g. sessions. The
+  output then carries the ID of the dictionary, and the same dictionary
+  must be set to uncompress it. trainDictionary() builds a dictionary
+  from sample payloads; LZ4 has no trainer of its own.
+
+  uncompress() also accepts the output of Tf::lz4Compress() written
+  before the header was introduced. That output starts with the 32-bit
+  little-endian length of its first block, at most the LZ4 bound of 1MB,
+  so its fourth byte is always 0; the version byte of the header is not,
+  so the two can not be mistaken for each other.
+*/
+
+namespace {
+
+enum Mode : uchar {
+    Stored = 0x00,
+    Lz4 = 0x01,
+    Lz4Hc = 0x02,
+    Lz4Dict = 0x03,  // followed by the dictionary ID and the original size
+};
+
+constexpr char MAGIC[] = {'\x89', 'T', 'Z'};
+constexpr char VERSION = 0x01;  // never 0, unlike the 4th byte of the old format
+constexpr int HEADER_LEN = sizeof(MAGIC) + 2;
+
+constexpr int MAX_DICTIONARY_SIZE = 64 * 1024;
+constexpr int MAX_DICTIONARY_INPUT = 64 * 1024;
+constexpr int HC_BLOCKSIZE = 1024 * 1024;  // as Tf::lz4Compress()
+constexpr int DICT_HEADER_LEN = HEADER_LEN + 8;
+constexpr int SHINGLE_LEN = 8;
+constexpr int SEGMENT_LEN = 64;
+
+
+quint32 fnv1a(const QByteArray &data)
+{
+    quint32 h = 0x811c9dc5;
+    for (char c : data) {
+        h = (h ^ (uchar)c) * 0x01000193;
+    }
+    return h;
+}
+
+
+inline QByteArray header(Mode mode)
+{
+    QByteArray ret(MAGIC, sizeof(MAGIC));
+    ret += VERSION;
+    ret += (char)mode;
+    return ret;
+}
+
+
+inline QByteArray stored(const QByteArray &data)
+{
+    return header(Stored) + data;
+}
+
+
+// Same framing as Tf::lz4Compress(), so that Tf::lz4Uncompress() reads it
+QByteArray lz4HcCompress(const QByteArray &data, int level)
+{
+    QByteArray ret = header(Lz4Hc);
+    const int bound = LZ4_compressBound(qMin(data.size(), HC_BLOCKSIZE));
+    int readlen = 0;
+
+    while (readlen < data.size()) {
+        int srclen = qMin(data.size() - readlen, HC_BLOCKSIZE);
+        int pos = ret.size();
+        ret.resize(pos + sizeof(qint32) + bound);
+        int rv = LZ4_compress_HC(data.constData() + readlen, ret.data() + pos + sizeof(qint32), srclen, bound, level);
+        if (rv <= 0) {
+            tError("LZ4 HC compression error: %d", rv);
+            return QByteArray();
+        }
+        qToLittleEndian<qint32>(rv, ret.data() + pos);
+        ret.resize(pos + sizeof(qint32) + rv);
+        readlen += srclen;
+    }
+    return ret;
+}
+
+}  // namespace
+
+/*!
+  Constructs a compressor storing data smaller than \a threshold bytes as
+  is and compressing data of \a hcThreshold bytes or more with LZ4 HC;
+  0 disables LZ4 HC.
+ */
+TLz4Compressor::TLz4Compressor(int threshold, int hcThreshold) :
+    _threshold(threshold),
+    _hcThreshold(hcThreshold)
+{
+}
+
+/*!
+  Sets the \a dictionary, of which the last 64KB are used.
+ */
+void TLz4Compressor::setDictionary(const QByteArray &dictionary)
+{
+    _dictionary = dictionary.right(MAX_DICTIONARY_SIZE);
+    _dictionaryId = (_dictionary.isEmpty()) ? 0 : fnv1a(_dictionary);
+    _dictionaryStream.clear();
+
+    if (!_dictionary.isEmpty()) {
+        _dictionaryStream.resize(sizeof(LZ4_stream_t));
+        LZ4_stream_t *stream = LZ4_initStream(_dictionaryStream.data(), _dictionaryStream.size());
+        if (Q_UNLIKELY(!stream)) {
+            // Compresses without the dictionary; uncompress() still uses it
+            tError("LZ4 stream initialization error");
+            _dictionaryStream.clear();
+            return;
+        }
+        LZ4_loadDict(stream, _dictionary.constData(), _dictionary.size());
+    }
+}
+
+/*!
+  Reads the dictionary from the file \a path. Returns false if the file
+  can not be read.
+ */
+bool TLz4Compressor::loadDictionary(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        tSystemWarn("Unable to read the LZ4 dictionary: %s", qPrintable(path));
+        return false;
+    }
+    setDictionary(file.readAll());
+    tSystemDebug("LZ4 dictionary loaded: %s  id:%08x", qPrintable(path), _dictionaryId);
+    return true;
+}
+
+/*!
+  Compresses the \a data.
+ */
+QByteArray TLz4Compressor::compress(const QByteArray &data) const
+{
+    if (data.isEmpty() || data.size() < _threshold) {
+        return stored(data);
+    }
+
+    QByteArray ret;
+    if (!_dictionaryStream.isEmpty() && data.size() <= MAX_DICTIONARY_INPUT) {
+        // Copying the loaded stream is cheaper than loading the dictionary
+        LZ4_stream_t stream;
+        std::memcpy(&stream, _dictionaryStream.constData(), sizeof(stream));
+
+        const int bound = LZ4_compressBound(data.size());
+        ret = header(Lz4Dict);
+        ret.resize(DICT_HEADER_LEN + bound);
+        qToLittleEndian<quint32>(_dictionaryId, ret.data() + HEADER_LEN);
+        qToLittleEndian<qint32>(data.size(), ret.data() + HEADER_LEN + 4);
+        int rv = LZ4_compress_fast_continue(&stream, data.constData(), ret.data() + DICT_HEADER_LEN, data.size(), bound, 1);
+        if (rv > 0) {
+            ret.resize(DICT_HEADER_LEN + rv);
+        } else {
+            tError("LZ4 compression error: %d", rv);
+            ret.clear();
+        }
+    } else if (_hcThreshold > 0 && data.size() >= _hcThreshold) {
+        ret = lz4HcCompress(data, _hcLevel);
+    } else {
+        QByteArray comp = Tf::lz4Compress(data);
+        if (!comp.isEmpty()) {
+            ret = header(Lz4) + comp;
+        }
+    }
+
+    return (ret.isEmpty() || ret.size() > data.size()) ? stored(data) : ret;
+}
+
+/*!
+  Uncompresses the \a data compressed by compress(). Returns a null
+  byte array on error.
+ */
+QByteArray TLz4Compressor::uncompress(const QByteArray &data) const
+{
+    if (data.isEmpty()) {
+        return QByteArray();
+    }
+
+    if (data.size() < HEADER_LEN || std::memcmp(data.constData(), MAGIC, sizeof(MAGIC)) != 0 || data[sizeof(MAGIC)] == 0) {
+        // Written before the header
+        return Tf::lz4Uncompress(data);
+    }
+
+    if (data[sizeof(MAGIC)] != VERSION) {
+        tError("LZ4 unknown format version: %d", (int)(uchar)data[sizeof(MAGIC)]);
+        return QByteArray();
+    }
+
+    switch ((uchar)data[HEADER_LEN - 1]) {
+    case Stored:
+        return data.mid(HEADER_LEN);
+
+    case Lz4:
+    case Lz4Hc:
+        return Tf::lz4Uncompress(data.constData() + HEADER_LEN, data.size() - HEADER_LEN);
+
+    case Lz4Dict: {
+        if (data.size() < DICT_HEADER_LEN) {
+            break;
+        }
+
+        quint32 id = qFromLittleEndian<quint32>(data.constData() + HEADER_LEN);
+        qint32 size = qFromLittleEndian<qint32>(data.constData() + HEADER_LEN + 4);
+        if (id != _dictionaryId) {
+            tError("LZ4 dictionary not found: %08x", id);
+            return QByteArray();
+        }
+        if (size <= 0 || size > MAX_DICTIONARY_INPUT) {
+            break;
+        }
+
+        QByteArray ret(size, Qt::Uninitialized);
+        int rv = LZ4_decompress_safe_usingDict(data.constData() + DICT_HEADER_LEN, ret.data(), data.size() - DICT_HEADER_LEN, size, _dictionary.constData(), _dictionary.size());
+        if (rv != size) {
+            tError("LZ4 uncompression error: %d", rv);
+            return QByteArray();
+        }
+        return ret;
+    }
+
+    default:
+        break;
+    }
+
+    tError("LZ4 uncompression format error");
+    return QByteArray();
+}
+
+/*!
+  Builds a dictionary of up to \a maxSize bytes from the \a samples.
+  The segments of the samples are scored by how often their 8-byte
+  sequences appear in all the samples, and the best ones are joined with
+  the highest scores last, where LZ4 finds matches most cheaply.
+ */
+QByteArray TLz4Compressor::trainDictionary(const QByteArrayList &samples, int maxSize)
+{
+    auto shingle = [](const char *p) {
+        quint64 v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    };
+
+    QHash<quint64, int> counts;
+    for (auto &sample : samples) {
+        for (int i = 0; i + SHINGLE_LEN <= sample.size(); ++i) {
+            counts[shingle(sample.constData() + i)]++;
+        }
+    }
+
+    struct Segment {
+        double score;
+        QByteArray data;
+    };
+
+    QVector<Segment> segments;
+    QSet<QByteArray> seen;
+    for (auto &sample : samples) {
+        for (int pos = 0; pos < sample.size(); pos += SEGMENT_LEN) {
+            QByteArray seg = sample.mid(pos, SEGMENT_LEN);
+            if (seg.size() < SHINGLE_LEN || seen.contains(seg)) {
+                continue;
+            }
+            seen.insert(seg);
+
+            qint64 sum = 0;
+            for (int i = 0; i + SHINGLE_LEN <= seg.size(); ++i) {
+                sum += counts.value(shingle(seg.constData() + i)) - 1;  // excludes itself
+            }
+            if (sum > 0) {
+                segments.append({(double)sum / seg.size(), seg});
+            }
+        }
+    }
+
+    std::sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b) { return a.score > b.score; });
+
+    QByteArrayList selected;
+    int total = 0;
+    for (auto &seg : segments) {
+        if (total + seg.data.size() > maxSize) {
+            break;
+        }
+        selected.prepend(seg.data);  // the highest score last
+        total += seg.data.size();
+    }
+    return selected.join();
+}
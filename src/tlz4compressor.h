@@ -0,0 +1,36 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QString>
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TLz4Compressor {
+public:
+    TLz4Compressor(int threshold = 0, int hcThreshold = 0);
+
+    int threshold() const { return _threshold; }
+    void setThreshold(int threshold) { _threshold = threshold; }
+    int hcThreshold() const { return _hcThreshold; }
+    void setHcThreshold(int threshold) { _hcThreshold = threshold; }
+    int hcLevel() const { return _hcLevel; }
+    void setHcLevel(int level) { _hcLevel = level; }
+
+    void setDictionary(const QByteArray &dictionary);
+    bool loadDictionary(const QString &path);
+    const QByteArray &dictionary() const { return _dictionary; }
+    quint32 dictionaryId() const { return _dictionaryId; }
+
+    QByteArray compress(const QByteArray &data) const;
+    QByteArray uncompress(const QByteArray &data) const;
+
+    static QByteArray trainDictionary(const QByteArrayList &samples, int maxSize = 64 * 1024);
+
+private:
+    int _threshold {0};  // bytes; smaller data is stored as is
+    int _hcThreshold {0};  // bytes; 0: LZ4 HC disabled
+    int _hcLevel {9};
+    QByteArray _dictionary;
+    quint32 _dictionaryId {0};
+    QByteArray _dictionaryStream;  // LZ4 stream with the dictionary loaded
+};
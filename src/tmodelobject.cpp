@@ -19,6 +19,14 @@
 QVariantMap TModelObject::toVariantMap() const
 {
     QVariantMap ret;
+    const TModelField *fields = modelFields();
+    if (fields) {
+        for (; fields->name; ++fields) {
+            ret.insert(QLatin1String(fields->name), fields->get(this));
+        }
+        return ret;
+    }
+
     const QMetaObject *metaObj = metaObject();
     for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
         const char *propName = metaObj->property(i).name();
@@ -35,6 +43,17 @@ QVariantMap TModelObject::toVariantMap() const
 */
 void TModelObject::setProperties(const QVariantMap &values)
 {
+    const TModelField *fields = modelFields();
+    if (fields) {
+        for (; fields->name; ++fields) {
+            auto it = values.constFind(QLatin1String(fields->name));
+            if (it != values.constEnd()) {
+                fields->set(this, it.value());
+            }
+        }
+        return;
+    }
+
     const QMetaObject *metaObj = metaObject();
     for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
         const char *n = metaObj->property(i).name();
@@ -52,12 +71,27 @@ void TModelObject::clear()
 {
 }
 
+/*!
+  \fn virtual const TModelField *TModelObject::modelFields() const
+  Returns the field descriptors generated by tspawn, terminated by an
+  entry with a null name, or nullptr if the class has none. The
+  properties are accessed through the meta-object in that case.
+*/
+
 /*!
   Returns a list of the property names.
 */
 QStringList TModelObject::propertyNames() const
 {
     QStringList ret;
+    const TModelField *fields = modelFields();
+    if (fields) {
+        for (; fields->name; ++fields) {
+            ret << QLatin1String(fields->name);
+        }
+        return ret;
+    }
+
     const QMetaObject *metaObj = metaObject();
     for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
         const char *propName = metaObj->property(i).name();
@@ -5,6 +5,25 @@
 #include <QVariant>
 #include <TGlobal>
 
+class TModelObject;
+
+// Field descriptor of a model object generated by tspawn
+struct TModelField {
+    const char *name;
+    QVariant (*get)(const TModelObject *obj);
+    void (*set)(TModelObject *obj, const QVariant &value);
+};
+
+
+template <class O, class V, V O::*Member>
+struct TModelFieldAccessor {
+    static QVariant get(const TModelObject *obj) { return QVariant::fromValue(static_cast<const O *>(obj)->*Member); }
+    static void set(TModelObject *obj, const QVariant &value) { static_cast<O *>(obj)->*Member = value.value<V>(); }
+};
+
+#define T_MODEL_FIELD(CLASS, TYPE, NAME) \
+    { #NAME, &TModelFieldAccessor<CLASS, TYPE, &CLASS::NAME>::get, &TModelFieldAccessor<CLASS, TYPE, &CLASS::NAME>::set }
+
 
 class T_CORE_EXPORT TModelObject : public QObject {
 public:
@@ -20,5 +39,6 @@ public:
     virtual void clear();
     virtual QVariantMap toVariantMap() const;
     virtual QStringList propertyNames() const;
+    virtual const TModelField *modelFields() const { return nullptr; }
 };
 
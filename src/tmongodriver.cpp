@@ -16,6 +16,7 @@ extern "C" {
 #endif
 }
 #include <QDateTime>
+#include <QVector>
 
 
 TMongoDriver::TMongoDriver() :
@@ -183,6 +184,44 @@ bool TMongoDriver::insertOne(const QString &collection, const QVariantMap &objec
 }
 
 
+bool TMongoDriver::insertMany(const QString &collection, const QList<QVariantMap> &objects, QVariantMap *reply)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    if (objects.isEmpty()) {
+        return true;
+    }
+
+    bson_error_t error;
+    clearError();
+
+    QList<TBson> bsons;
+    QVector<const bson_t *> documents;
+    for (auto &obj : objects) {
+        bsons << TBson::toBson(obj);
+        documents << (const bson_t *)bsons.last().constData();
+    }
+
+    mongoc_collection_t *col = mongoc_client_get_collection(mongoClient, qPrintable(dbName), qPrintable(collection));
+    bson_t rep;
+    bool res = mongoc_collection_insert_many(col, documents.data(), documents.count(), nullptr, &rep, &error);
+    mongoc_collection_destroy(col);
+
+    if (res) {
+        if (reply) {
+            *reply = TBson::fromBson((TBsonObject *)&rep);
+        }
+    } else {
+        tSystemError("MongoDB Insert Error: %s", error.message);
+        setLastError(&error);
+    }
+    bson_destroy(&rep);
+    return res;
+}
+
+
 bool TMongoDriver::removeOne(const QString &collection, const QVariantMap &criteria, QVariantMap *reply)
 {
     if (!isOpen()) {
@@ -22,6 +22,7 @@ public:
     QVariantMap findOne(const QString &collection, const QVariantMap &criteria,
         const QStringList &projectFields = QStringList());
     bool insertOne(const QString &collection, const QVariantMap &object, QVariantMap *reply = nullptr);
+    bool insertMany(const QString &collection, const QList<QVariantMap> &objects, QVariantMap *reply = nullptr);
     bool updateOne(const QString &collection, const QVariantMap &criteria, const QVariantMap &object,
         bool upsert = false, QVariantMap *reply = nullptr);
     bool updateMany(const QString &collection, const QVariantMap &criteria, const QVariantMap &object,
@@ -271,6 +271,17 @@ bool TMongoObject::isModified() const
 
 void TMongoObject::syncToObject()
 {
+    const TModelField *fields = modelFields();
+    if (fields) {
+        for (; fields->name; ++fields) {
+            auto it = QVariantMap::constFind(QLatin1String(fields->name));
+            if (it != QVariantMap::constEnd()) {
+                fields->set(this, it.value());
+            }
+        }
+        return;
+    }
+
     int offset = metaObject()->propertyOffset();
 
     for (auto it = QVariantMap::begin(); it != QVariantMap::end(); ++it) {
@@ -287,6 +298,14 @@ void TMongoObject::syncToVariantMap()
 {
     QVariantMap::clear();
 
+    const TModelField *fields = modelFields();
+    if (fields) {
+        for (; fields->name; ++fields) {
+            QVariantMap::insert(QLatin1String(fields->name), fields->get(this));
+        }
+        return;
+    }
+
     const QMetaObject *metaObj = metaObject();
     for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
         const char *propName = metaObj->property(i).name();
@@ -151,6 +151,34 @@ bool TMongoQuery::insert(QVariantMap &document)
     return (insertedCount == 1);
 }
 
+/*!
+  Inserts the \a documents into the collection in one bulk write.
+  Returns the number of the documents inserted, or -1 on error.
+*/
+int TMongoQuery::insertMulti(QList<QVariantMap> &documents)
+{
+    if (!_database.isValid()) {
+        tSystemError("TMongoQuery::insertMulti : driver not loaded");
+        return -1;
+    }
+
+    for (auto &document : documents) {
+        if (!document.contains(ObjectIdKey)) {
+            // Sets Object ID
+            document.insert(ObjectIdKey, TBson::generateObjectId());
+        }
+    }
+
+    int insertedCount = -1;
+    QVariantMap reply;
+    bool ret = driver()->insertMany(_collection, documents, &reply);
+    if (ret) {
+        insertedCount = reply.value(QStringLiteral("insertedCount")).toInt();
+    }
+    tSystemDebug("TMongoQuery::insertMulti insertedCount:%d", insertedCount);
+    return insertedCount;
+}
+
 /*!
   Removes documents that matches the \a criteria from the collection.
 */
@@ -24,6 +24,7 @@ public:
     QVariantMap findOne(const QVariantMap &criteria = QVariantMap(), const QStringList &fields = QStringList());
     QVariantMap findById(const QString &id, const QStringList &fields = QStringList());
     bool insert(QVariantMap &document);
+    int insertMulti(QList<QVariantMap> &documents);
     int update(const QVariantMap &criteria, const QVariantMap &document, bool upsert = false);
     bool updateById(const QVariantMap &document);
     int updateMulti(const QVariantMap &criteria, const QVariantMap &document);
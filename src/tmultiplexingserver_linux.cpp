@@ -5,6 +5,7 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclock.h"
 #include "tepoll.h"
 #include "tepollhttpsocket.h"
 #include "tepollsocket.h"
@@ -151,6 +152,7 @@ void TMultiplexingServer::run()
         if (numEvents < 0) {
             break;
         }
+        TClock::tick();
 
         TEpollSocket *sock;
         while ((sock = TEpoll::instance()->next())) {
@@ -6,6 +6,7 @@
  */
 
 #include "tpublisher.h"
+#include "tcachetieredstore.h"
 #include "tsystembus.h"
 #include "tsystemglobal.h"
 #include "twebsocket.h"
@@ -106,10 +107,16 @@ void Pub::publish(const QByteArray &binary, const QObject *sender)
   \brief The TPublisher class provides a means of publish subscribe messaging for websocket.
 */
 
+/*!
+  Returns the global instance. It lives in the application thread
+  wherever it is created first, since the system bus emits its signal in
+  that thread and an action thread may finish before the messages arrive.
+ */
 TPublisher *TPublisher::instance()
 {
     static TPublisher *globalInstance = []() {
         auto *pub = new TPublisher();
+        pub->moveToThread(Tf::app()->thread());
         connect(TSystemBus::instance(), SIGNAL(readyReceive()), pub, SLOT(receiveSystemBus()));
         return pub;
     }();
@@ -253,6 +260,10 @@ void TPublisher::receiveSystemBus()
             break;
         }
 
+        case Tf::CacheInvalidate:
+            TCacheTieredStore::invalidate(msg.data(), msg.target().toLongLong());
+            break;
+
         default:
             tSystemError("Internal Error  [%s:%d]", __FILE__, __LINE__);
             break;
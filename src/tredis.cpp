@@ -8,6 +8,7 @@
 #include "tredisdriver.h"
 #include <TActionContext>
 #include <TRedis>
+#include <TRedisPipeline>
 
 /*!
   \class TRedis
@@ -163,6 +164,22 @@ bool TRedis::setNx(const QByteArray &key, const QByteArray &value)
     return (res && resp.value(0).toInt() == 1);
 }
 
+/*!
+  Set the \a key to hold the \a value with the timeout of \a seconds
+  if the key does not exist. Returns true if the key is set.
+ */
+bool TRedis::setNx(const QByteArray &key, const QByteArray &value, int seconds)
+{
+    if (!driver()) {
+        return false;
+    }
+
+    QVariantList resp;
+    QByteArrayList command = {"SET", key, value, "NX", "EX", QByteArray::number(seconds)};
+    bool res = driver()->request(command, resp);
+    return (res && resp.value(0).toByteArray() == "OK");
+}
+
 /*!
   Atomically sets the \a key to the \a value and returns the old value
   stored at the \a key.
@@ -190,6 +207,22 @@ bool TRedis::del(const QByteArray &key)
     return (count == 1);
 }
 
+/*!
+  Sets the timeout of the \a key to \a seconds. Returns false if the
+  key does not exist.
+ */
+bool TRedis::expire(const QByteArray &key, int seconds)
+{
+    if (!driver()) {
+        return false;
+    }
+
+    QVariantList resp;
+    QByteArrayList command = {"EXPIRE", key, QByteArray::number(seconds)};
+    bool res = driver()->request(command, resp);
+    return (res && resp.value(0).toInt() == 1);
+}
+
 /*!
   Removes the specified \a keys. A key is ignored if it does
   not exist.
@@ -424,6 +457,85 @@ QList<QPair<QByteArray, QByteArray>> TRedis::hgetAll(const QByteArray &key)
 }
 
 
+/*!
+  Returns the values of all the \a keys, in the same order. For a key that
+  does not exist, the value is a null byte array.
+ */
+QByteArrayList TRedis::mget(const QByteArrayList &keys)
+{
+    QByteArrayList ret;
+    if (!driver() || keys.isEmpty()) {
+        return ret;
+    }
+
+    QVariantList resp;
+    QByteArrayList command = {"MGET"};
+    command << keys;
+    bool res = driver()->request(command, resp);
+    if (res) {
+        for (auto &var : (const QVariantList &)resp) {
+            ret << var.toByteArray();
+        }
+    }
+    return ret;
+}
+
+/*!
+  Sets each key of the \a values to hold its value in one command.
+ */
+bool TRedis::mset(const QList<QPair<QByteArray, QByteArray>> &values)
+{
+    if (!driver() || values.isEmpty()) {
+        return false;
+    }
+
+    QVariantList resp;
+    QByteArrayList command = {"MSET"};
+    for (auto &val : values) {
+        command << val.first << val.second;
+    }
+    return driver()->request(command, resp);
+}
+
+/*!
+  Sets each key of the \a values to hold its value and to timeout after
+  \a seconds, with a pipeline of SETEX commands. Returns true if all the
+  keys are set.
+ */
+bool TRedis::setEx(const QList<QPair<QByteArray, QByteArray>> &values, int seconds)
+{
+    if (values.isEmpty()) {
+        return false;
+    }
+
+    TRedisPipeline pl = pipeline();
+    for (auto &val : values) {
+        pl.setEx(val.first, val.second, seconds);
+    }
+
+    if (!pl.exec()) {
+        return false;
+    }
+    // The queue is cleared by exec(); one reply per value
+    for (int i = 0; i < values.count(); ++i) {
+        if (!pl.isSuccess(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+  Returns a pipeline to send commands on the connection of this object
+  in one round trip.
+  \sa TRedisPipeline
+ */
+TRedisPipeline TRedis::pipeline() const
+{
+    return TRedisPipeline(*this);
+}
+
+
 void TRedis::flushDb()
 {
     if (!driver()) {
@@ -7,6 +7,7 @@
 #include <TfNamespace>
 
 class TRedisDriver;
+class TRedisPipeline;
 
 
 class T_CORE_EXPORT TRedis {
@@ -23,6 +24,7 @@ public:
     bool set(const QByteArray &key, const QByteArray &value);
     bool setEx(const QByteArray &key, const QByteArray &value, int seconds);
     bool setNx(const QByteArray &key, const QByteArray &value);
+    bool setNx(const QByteArray &key, const QByteArray &value, int seconds);
     QByteArray getSet(const QByteArray &key, const QByteArray &value);
 
     // string
@@ -34,6 +36,7 @@ public:
 
     bool del(const QByteArray &key);
     int del(const QByteArrayList &keys);
+    bool expire(const QByteArray &key, int seconds);
 
     // binary list
     int rpush(const QByteArray &key, const QByteArrayList &values);
@@ -61,6 +64,12 @@ public:
     int hlen(const QByteArray &key);
     QList<QPair<QByteArray, QByteArray>> hgetAll(const QByteArray &key);
 
+    // bulk
+    QByteArrayList mget(const QByteArrayList &keys);
+    bool mset(const QList<QPair<QByteArray, QByteArray>> &values);
+    bool setEx(const QList<QPair<QByteArray, QByteArray>> &values, int seconds);
+    TRedisPipeline pipeline() const;
+
     void flushDb();
 
 private:
@@ -74,6 +83,7 @@ private:
     TKvsDatabase database;
 
     friend class TCacheRedisStore;
+    friend class TRedisPipeline;
 };
 
 
@@ -6,6 +6,7 @@
  */
 
 #include "tredisdriver.h"
+#include "tredismultiplexer.h"
 #include "tsystemglobal.h"
 using namespace Tf;
 
@@ -21,16 +22,44 @@ bool TRedisDriver::command(const QString &cmd)
 
 bool TRedisDriver::request(const QByteArrayList &command, QVariantList &response)
 {
+    QList<QVariantList> responses;
+    QVector<bool> results;
+
+    bool ret = request(QList<QByteArrayList>({command}), responses, results);
+    if (ret) {
+        response = responses.value(0);
+        ret = results.value(0);
+    }
+    return ret;
+}
+
+/*!
+  Sends the \a commands in one write and reads their replies in order into
+  \a responses, so that the commands cost a single round trip. \a results
+  holds false for each command answered with an error reply. Returns false
+  if the commands could not be sent or the replies not read; the connection
+  is closed in that case.
+  If the driver is multiplexed, the commands are pipelined with those of
+  other threads on a shared connection.
+ */
+bool TRedisDriver::request(const QList<QByteArrayList> &commands, QList<QVariantList> &responses, QVector<bool> &results)
+{
+    if (_multiplexer) {
+        return _multiplexer->request(commands, responses, results);
+    }
+
+    responses.clear();
+    results.clear();
+
     if (Q_UNLIKELY(!isOpen())) {
         tSystemError("Not open Redis session  [%s:%d]", __FILE__, __LINE__);
         return false;
     }
 
-    bool ret = true;
-    bool ok = false;
-    QByteArray str;
-
-    QByteArray cmd = toMultiBulk(command);
+    QByteArray cmd;
+    for (auto &command : commands) {
+        cmd += toMultiBulk(command);
+    }
     tSystemDebug("Redis command: %s", cmd.data());
     if (!writeCommand(cmd)) {
         tSystemError("Redis write error  [%s:%d]", __FILE__, __LINE__);
@@ -39,190 +68,232 @@ bool TRedisDriver::request(const QByteArrayList &command, QVariantList &response
     }
     clearBuffer();
 
-    for (;;) {
-        if (!readReply()) {
-            tSystemError("Redis read error   pos:%d  buflen:%d", _pos, _buffer.length());
-            close();
-            break;
-        }
+    responses.reserve(commands.count());
+    results.reserve(commands.count());
 
-        switch (_buffer.at(_pos)) {
-        case Error:
-            ret = false;
-            str = getLine(&ok);
-            tSystemError("Redis error response: %s", qPrintable(str));
-            break;
+    while (responses.count() < commands.count()) {
+        QVariantList response;
+        ReplyStatus status = parseReply(response);
 
-        case SimpleString:
-            str = getLine(&ok);
-            tSystemDebug("Redis response: %s", qPrintable(str));
-            break;
-
-        case Integer: {
-            _pos++;
-            int num = getNumber(&ok);
-            if (ok) {
-                response << num;
-            }
-            break;
-        }
-
-        case BulkString:
-            str = parseBulkString(&ok);
-            if (ok) {
-                response << str;
+        switch (status) {
+        case ReplyIncomplete: {
+            bool res;
+            if (_bulkType && _bulkReceived < _bulk.length()) {
+                // Receives the rest of the bulk string into its own buffer
+                res = readData(_bulk.data() + _bulkReceived, _bulk.length() - _bulkReceived);
+                _bulkReceived = _bulk.length();
+            } else {
+                // Discards the parsed data, so that it is never scanned again
+                _buffer.remove(0, _pos);
+                _pos = 0;
+                res = readReply();
             }
-            break;
 
-        case Array:
-            response = parseArray(&ok);
-            if (!ok) {
-                response.clear();
+            if (!res) {
+                tSystemError("Redis read error   pos:%d  buflen:%d", _pos, _buffer.length());
+                clearBuffer();
+                close();
+                return false;
             }
             break;
+        }
 
-        default:
-            tSystemError("Invalid protocol: %c  [%s:%d]", _buffer.at(_pos), __FILE__, __LINE__);
-            ret = false;
+        case ReplyInvalid:
             clearBuffer();
             close();
-            goto parse_done;
-            break;
-        }
+            return false;
 
-        if (ok) {
-            if (_pos < _buffer.length()) {
-                tSystemError("Invalid format  [%s:%d]", __FILE__, __LINE__);
-            }
-            clearBuffer();
+        default:
+            responses << response;
+            results << (status == ReplySuccess);
             break;
         }
-
-        _pos = 0;
-        // retry to read..
     }
 
-parse_done:
-    return ret;
-}
-
-
-QByteArray TRedisDriver::getLine(bool *ok)
-{
-    int idx = _buffer.indexOf(CRLF, _pos);
-    if (idx < 0) {
-        *ok = false;
-        return QByteArray();
+    if (_pos < _buffer.length()) {
+        tSystemError("Invalid format  [%s:%d]", __FILE__, __LINE__);
     }
-
-    QByteArray ret = _buffer.mid(_pos, idx);
-    _pos = idx + 2;
-    *ok = true;
-    return ret;
+    clearBuffer();
+    return true;
 }
 
+/*!
+  Parses the reply at the current position into \a response, which
+  receives the value of a scalar reply or the elements of an aggregate
+  one. Supports the types of RESP2 and RESP3.
 
-QByteArray TRedisDriver::parseBulkString(bool *ok)
+  The parser is resumable: if the reply has not been received in full,
+  it returns ReplyIncomplete keeping the elements parsed so far, and
+  continues where it left off when called again after the next read.
+  A bulk string that is not in the buffer in full is moved to a buffer
+  of its own length, into which the rest is read directly.
+ */
+TRedisDriver::ReplyStatus TRedisDriver::parseReply(QVariantList &response)
 {
-    QByteArray str;
-    int startpos = _pos;
-
-    Q_ASSERT((int)_buffer[_pos] == BulkString);
-    _pos++;
-
-    int len = getNumber(ok);
-    if (*ok) {
-        if (len < -1) {
-            tSystemError("Invalid length: %d  [%s:%d]", len, __FILE__, __LINE__);
-            *ok = false;
-        } else if (len == -1) {
-            // null string
-            tSystemDebug("Null string parsed");
+    for (;;) {
+        enum { Scalar, Simple, Failure, Aggregate } kind = Scalar;
+        QVariant value;
+
+        if (_bulkType) {
+            // Bulk string received directly
+            if (_bulkReceived < _bulk.length() || _buffer.length() - _pos < 2) {
+                return ReplyIncomplete;
+            }
+            _pos += 2;  // CRLF
+            kind = (_bulkType == BlobError) ? Failure : Scalar;
+            value = (_bulkType == VerbatimString) ? _bulk.mid(4) : _bulk;  // strips the format "txt:"
+            _bulkType = 0;
+            _bulk = QByteArray();
+            _bulkReceived = 0;
         } else {
-            if (_pos + 2 <= _buffer.length()) {
-                str = (len > 0) ? _buffer.mid(_pos, len) : QByteArray("");
-                _pos += len + 2;
-            } else {
-                *ok = false;
+            if (_pos >= _buffer.length()) {
+                return ReplyIncomplete;
             }
-        }
-    }
 
-    if (!*ok) {
-        _pos = startpos;
-    }
-    return str;
-}
+            const char type = _buffer.at(_pos);
+            int eol = _buffer.indexOf(CRLF, _pos + 1);
+            if (eol < 0) {
+                return ReplyIncomplete;
+            }
 
+            const auto line = QByteArray::fromRawData(_buffer.constData() + _pos + 1, eol - _pos - 1);
+            bool ok = true;
+
+            switch (type) {
+            case SimpleString:
+                kind = Simple;
+                value = QByteArray(line.constData(), line.length());
+                _pos = eol + 2;
+                break;
+
+            case Error:
+                kind = Failure;
+                value = QByteArray(line.constData(), line.length());
+                _pos = eol + 2;
+                break;
+
+            case Integer:
+                value = line.toLongLong(&ok);
+                _pos = eol + 2;
+                break;
+
+            case BulkString:
+            case BlobError:
+            case VerbatimString: {
+                int len = line.toInt(&ok);
+                if (!ok || len < -1) {
+                    ok = false;
+                    break;
+                }
+
+                _pos = eol + 2;
+                if (len == -1) {
+                    value = QByteArray();  // null string
+                    break;
+                }
+
+                kind = (type == BlobError) ? Failure : Scalar;
+                if (_buffer.length() - _pos >= len + 2) {
+                    QByteArray str = _buffer.mid(_pos, len);
+                    value = (type == VerbatimString) ? str.mid(4) : str;
+                    _pos += len + 2;
+                } else {
+                    // Takes what has been received; the rest is read later
+                    _bulkType = type;
+                    _bulk = QByteArray(len, Qt::Uninitialized);
+                    _bulkReceived = qMin(len, _buffer.length() - _pos);
+                    memcpy(_bulk.data(), _buffer.constData() + _pos, _bulkReceived);
+                    _pos += _bulkReceived;
+                    return ReplyIncomplete;
+                }
+                break;
+            }
 
-QVariantList TRedisDriver::parseArray(bool *ok)
-{
-    QVariantList lst;
-    int startpos = _pos;
-    *ok = false;
-
-    Q_ASSERT((int)_buffer[_pos] == Array);
-    _pos++;
-
-    int count = getNumber(ok);
-    while (*ok) {
-        switch (_buffer[_pos]) {
-        case BulkString: {
-            auto str = parseBulkString(ok);
-            if (*ok) {
-                lst << str;
+            case Array:
+            case Set:
+            case Push:
+            case Map: {
+                int count = line.toInt(&ok);
+                _pos = eol + 2;
+                if (!ok) {
+                    break;
+                }
+
+                if (count > 0) {
+                    // Parses the elements next; a map as its keys and values in turn
+                    _frames.append(Frame {(type == Map) ? count * 2 : count, QVariantList()});
+                    continue;
+                }
+                kind = Aggregate;
+                value = QVariantList();  // empty or null array
+                break;
             }
-            break;
-        }
 
-        case Integer: {
-            _pos++;
-            int num = getNumber(ok);
-            if (*ok) {
-                lst << num;
+            case Null:
+                value = QByteArray();
+                _pos = eol + 2;
+                break;
+
+            case Boolean:
+                value = (line == "t");
+                _pos = eol + 2;
+                break;
+
+            case Double:
+                value = line.toDouble(&ok);
+                _pos = eol + 2;
+                break;
+
+            case BigNumber:
+                value = QByteArray(line.constData(), line.length());
+                _pos = eol + 2;
+                break;
+
+            default:
+                ok = false;
+                break;
             }
-            break;
-        }
 
-        case Array: {
-            auto var = parseArray(ok);
-            if (*ok) {
-                lst << QVariant(var);
+            if (Q_UNLIKELY(!ok)) {
+                tSystemError("Invalid protocol: %c  [%s:%d]", type, __FILE__, __LINE__);
+                return ReplyInvalid;
             }
-            break;
         }
 
-        default:
-            tSystemError("Bad logic  [%s:%d]", __FILE__, __LINE__);
-            *ok = false;
-            break;
+        // Adds the value to the enclosing aggregate; completes it if full
+        while (!_frames.isEmpty()) {
+            Frame &frame = _frames.last();
+            frame.elements << value;
+            if (--frame.remaining > 0) {
+                break;
+            }
+            kind = Aggregate;
+            value = frame.elements;
+            _frames.removeLast();
         }
 
-        if (lst.count() >= count) {
-            break;
-        }
-    }
+        if (_frames.isEmpty()) {
+            switch (kind) {
+            case Failure:
+                tSystemError("Redis error response: %s", value.toByteArray().data());
+                return ReplyError;
 
-    if (!*ok) {
-        _pos = startpos;
-    }
-    return lst;
-}
+            case Simple:
+                tSystemDebug("Redis response: %s", value.toByteArray().data());
+                response << value;
+                break;
 
+            case Aggregate:
+                response = value.toList();
+                break;
 
-int TRedisDriver::getNumber(bool *ok)
-{
-    int idx = _buffer.indexOf(CRLF, _pos);
-    if (idx < 0) {
-        *ok = false;
-        return 0;
+            default:
+                response << value;
+                break;
+            }
+            return ReplySuccess;
+        }
     }
-
-    int num = _buffer.mid(_pos, idx - _pos).toInt();
-    _pos = idx + 2;
-    *ok = true;
-    tSystemDebug("getNumber: %d", num);
-    return num;
 }
 
 
@@ -230,6 +301,10 @@ void TRedisDriver::clearBuffer()
 {
     _buffer.resize(0);
     _pos = 0;
+    _frames.clear();
+    _bulkType = 0;
+    _bulk = QByteArray();
+    _bulkReceived = 0;
 }
 
 
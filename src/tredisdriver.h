@@ -1,11 +1,14 @@
 #pragma once
+#include <QList>
 #include <QString>
 #include <QVariant>
+#include <QVector>
 #include <QtGlobal>
 #include <TGlobal>
 #include <TKvsDriver>
 
 class QTcpSocket;
+class TRedisMultiplexer;
 
 
 class T_CORE_EXPORT TRedisDriver : public TKvsDriver {
@@ -20,6 +23,8 @@ public:
     bool isOpen() const override;
     void moveToThread(QThread *thread) override;
     bool request(const QByteArrayList &command, QVariantList &response);
+    bool request(const QList<QByteArrayList> &commands, QList<QVariantList> &responses, QVector<bool> &results);
+    void setMultiplexer(TRedisMultiplexer *multiplexer) { _multiplexer = multiplexer; }
 
 protected:
     enum DataType {
@@ -28,14 +33,29 @@ protected:
         Integer = ':',
         BulkString = '$',
         Array = '*',
+        // RESP3
+        Null = '_',
+        Boolean = '#',
+        Double = ',',
+        BigNumber = '(',
+        BlobError = '!',
+        VerbatimString = '=',
+        Map = '%',
+        Set = '~',
+        Push = '>',
+    };
+
+    enum ReplyStatus {
+        ReplyIncomplete = 0,
+        ReplySuccess,
+        ReplyError,  // error reply of the server
+        ReplyInvalid,  // protocol error
     };
 
     bool writeCommand(const QByteArray &command);
     bool readReply();
-    QByteArray parseBulkString(bool *ok);
-    QVariantList parseArray(bool *ok);
-    QByteArray getLine(bool *ok);
-    int getNumber(bool *ok);
+    bool readData(char *data, int size);
+    ReplyStatus parseReply(QVariantList &response);
     void clearBuffer();
 
     static QByteArray toBulk(const QByteArray &data);
@@ -47,10 +67,21 @@ private:
 #else
     QTcpSocket *_client {nullptr};
 #endif
+    struct Frame {
+        int remaining;  // number of the elements to parse
+        QVariantList elements;
+    };
+
     QByteArray _buffer;
     int _pos {0};
+    QVector<Frame> _frames;  // aggregates being parsed, innermost last
+    char _bulkType {0};  // of the bulk string being received directly
+    QByteArray _bulk;
+    int _bulkReceived {0};
     QString _host;
     quint16 _port {0};
+    TRedisMultiplexer *_multiplexer {nullptr};  // shared connections
+    bool _sharedOpen {false};  // opened on the multiplexer
 
     T_DISABLE_COPY(TRedisDriver)
     T_DISABLE_MOVE(TRedisDriver)
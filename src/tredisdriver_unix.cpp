@@ -32,7 +32,7 @@ TRedisDriver::~TRedisDriver()
 
 bool TRedisDriver::isOpen() const
 {
-    return _socket > 0;
+    return _sharedOpen || _socket > 0;
 }
 
 
@@ -42,6 +42,12 @@ bool TRedisDriver::open(const QString &, const QString &, const QString &, const
         return true;
     }
 
+    if (_multiplexer) {
+        // The multiplexer owns the connections
+        _sharedOpen = true;
+        return true;
+    }
+
     QTcpSocket tcpSocket;
 
     // Sets socket options
@@ -80,6 +86,7 @@ bool TRedisDriver::open(const QString &, const QString &, const QString &, const
 
 void TRedisDriver::close()
 {
+    _sharedOpen = false;
     if (_socket > 0) {
         tf_close_socket(_socket);
         _socket = 0;
@@ -117,19 +124,19 @@ bool TRedisDriver::readReply()
         return false;
     }
 
-    QByteArray buf;
-    buf.reserve(RECV_BUF_SIZE);
     int timeout = 5000;
     int len = 0;
 
     while (tf_poll_recv(_socket, timeout) == 0) {
-        len = tf_recv(_socket, buf.data(), RECV_BUF_SIZE, 0);
+        // Receives into the tail of the buffer directly
+        const int size = _buffer.length();
+        _buffer.resize(size + RECV_BUF_SIZE);
+        len = tf_recv(_socket, _buffer.data() + size, RECV_BUF_SIZE, 0);
+        _buffer.resize(size + qMax(len, 0));
         if (len <= 0) {
             break;
         }
 
-        buf.resize(len);
-        _buffer += buf;
         if (len < RECV_BUF_SIZE) {
             break;
         }
@@ -139,6 +146,27 @@ bool TRedisDriver::readReply()
     return len > 0;
 }
 
+/*!
+  Reads exactly \a size bytes into \a data, bypassing the receive buffer.
+ */
+bool TRedisDriver::readData(char *data, int size)
+{
+    if (Q_UNLIKELY(!isOpen())) {
+        tSystemError("Not open Redis session  [%s:%d]", __FILE__, __LINE__);
+        return false;
+    }
+
+    int total = 0;
+    while (total < size && tf_poll_recv(_socket, 5000) == 0) {
+        int len = tf_recv(_socket, data + total, size - total, 0);
+        if (len <= 0) {
+            break;
+        }
+        total += len;
+    }
+    return total == size;
+}
+
 
 void TRedisDriver::moveToThread(QThread *)
 {
@@ -33,6 +33,9 @@ TRedisDriver::~TRedisDriver()
 
 bool TRedisDriver::isOpen() const
 {
+    if (_sharedOpen) {
+        return true;
+    }
     return (_client) ? (_client->state() == QAbstractSocket::ConnectedState) : false;
 }
 
@@ -43,6 +46,12 @@ bool TRedisDriver::open(const QString &, const QString &, const QString &, const
         return true;
     }
 
+    if (_multiplexer) {
+        // The multiplexer owns the connections
+        _sharedOpen = true;
+        return true;
+    }
+
     if (!_client) {
         _client = new QTcpSocket();
     }
@@ -90,6 +99,7 @@ bool TRedisDriver::writeCommand(const QByteArray &command)
 
 void TRedisDriver::close()
 {
+    _sharedOpen = false;
     if (_client) {
         _client->close();
     }
@@ -115,6 +125,32 @@ bool TRedisDriver::readReply()
     return ret;
 }
 
+/*!
+  Reads exactly \a size bytes into \a data, bypassing the receive buffer.
+ */
+bool TRedisDriver::readData(char *data, int size)
+{
+    if (Q_UNLIKELY(!isOpen())) {
+        tSystemError("Not open Redis session  [%s:%d]", __FILE__, __LINE__);
+        return false;
+    }
+
+    qint64 total = 0;
+    while (total < size) {
+        if (_client->bytesAvailable() == 0 && !_client->waitForReadyRead(5000)) {
+            tSystemWarn("Redis response timeout");
+            break;
+        }
+
+        qint64 len = _client->read(data + total, size - total);
+        if (len < 0) {
+            break;
+        }
+        total += len;
+    }
+    return total == size;
+}
+
 
 void TRedisDriver::moveToThread(QThread *thread)
 {
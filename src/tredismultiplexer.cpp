@@ -0,0 +1,265 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tredismultiplexer.h"
+#include "tredisdriver.h"
+#include "tsystemglobal.h"
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QThread>
+#include <QWaitCondition>
+#include <chrono>
+#include <vector>
+
+constexpr int DEFAULT_REQUEST_TIMEOUT = 10000;  // msecs
+
+/*!
+  \class TRedisMultiplexer
+  \brief The TRedisMultiplexer class shares a few Redis connections among
+  all the threads of the process.
+
+  Each connection is owned by an I/O thread. The commands posted by the
+  threads are queued, and the I/O thread writes all the queued commands
+  in one batch and reads their replies in order, which RESP guarantees;
+  so the commands of different threads are pipelined. The caller gets
+  a future of the replies.
+
+  Commands that change the state of the connection or block it, such as
+  MULTI, SELECT or BLPOP, would affect the other threads, so they are
+  rejected; see isShareable().
+*/
+
+class TRedisMultiplexer::Channel : public QThread {
+public:
+    Channel(const QString &host, quint16 port, const QStringList &postOpenStatements) :
+        QThread(),
+        host(host),
+        port(port),
+        postOpenStatements(postOpenStatements) { }
+
+    std::future<TRedisReply> post(const QList<QByteArrayList> &commands);
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    struct Pending {
+        QList<QByteArrayList> commands;
+        std::promise<TRedisReply> promise;
+    };
+
+    bool connect(TRedisDriver &driver);
+
+    const QString host;
+    const quint16 port;
+    const QStringList postOpenStatements;
+    QMutex mutex;
+    QWaitCondition cond;
+    std::vector<Pending> queue;
+    bool stopped {false};
+};
+
+
+std::future<TRedisReply> TRedisMultiplexer::Channel::post(const QList<QByteArrayList> &commands)
+{
+    Pending pending {commands, std::promise<TRedisReply>()};
+    auto future = pending.promise.get_future();
+
+    QMutexLocker locker(&mutex);
+    queue.push_back(std::move(pending));
+    cond.wakeOne();
+    return future;
+}
+
+
+void TRedisMultiplexer::Channel::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopped = true;
+        cond.wakeOne();
+    }
+    wait();
+}
+
+
+bool TRedisMultiplexer::Channel::connect(TRedisDriver &driver)
+{
+    if (driver.isOpen()) {
+        return true;
+    }
+
+    if (!driver.open(QString(), QString(), QString(), host, port)) {
+        return false;
+    }
+
+    for (QString st : postOpenStatements) {
+        st = st.trimmed();
+        driver.command(st);
+    }
+    return true;
+}
+
+
+void TRedisMultiplexer::Channel::run()
+{
+    TRedisDriver driver;
+    std::vector<Pending> batch;
+
+    for (;;) {
+        {
+            QMutexLocker locker(&mutex);
+            while (queue.empty() && !stopped) {
+                cond.wait(&mutex);
+            }
+            if (queue.empty()) {
+                break;  // stopped
+            }
+            batch.swap(queue);
+        }
+
+        // Writes the commands of all the callers at once
+        QList<QByteArrayList> commands;
+        for (auto &pending : batch) {
+            commands += pending.commands;
+        }
+
+        TRedisReply reply;
+        reply.ok = connect(driver) && driver.request(commands, reply.responses, reply.results);
+
+        // Hands the replies to the callers in order
+        int pos = 0;
+        for (auto &pending : batch) {
+            TRedisReply rep;
+            rep.ok = reply.ok;
+            if (reply.ok) {
+                rep.responses = reply.responses.mid(pos, pending.commands.count());
+                rep.results = reply.results.mid(pos, pending.commands.count());
+            }
+            pos += pending.commands.count();
+            pending.promise.set_value(rep);
+        }
+        batch.clear();
+    }
+    driver.close();
+}
+
+
+TRedisMultiplexer::TRedisMultiplexer(const QString &host, quint16 port, int connections, const QStringList &postOpenStatements) :
+    timeout(DEFAULT_REQUEST_TIMEOUT)
+{
+    for (int i = 0; i < connections; ++i) {
+        auto *channel = new Channel(host, port, postOpenStatements);
+        channel->start();
+        channels << channel;
+    }
+}
+
+
+TRedisMultiplexer::~TRedisMultiplexer()
+{
+    for (auto *channel : channels) {
+        channel->stop();
+        delete channel;
+    }
+}
+
+/*!
+  Posts the \a commands to one of the connections and returns the future
+  of their replies.
+ */
+std::future<TRedisReply> TRedisMultiplexer::post(const QList<QByteArrayList> &commands)
+{
+    auto *channel = channels[next++ % channels.count()];
+    return channel->post(commands);
+}
+
+/*!
+  Posts the \a commands and waits for their replies; the same as
+  TRedisDriver::request(). Returns false without sending anything if one
+  of the commands is not shareable, or if the replies do not arrive
+  within requestTimeout() milliseconds.
+ */
+bool TRedisMultiplexer::request(const QList<QByteArrayList> &commands, QList<QVariantList> &responses, QVector<bool> &results)
+{
+    responses.clear();
+    results.clear();
+
+    for (auto &command : commands) {
+        if (Q_UNLIKELY(!isShareable(command))) {
+            tSystemError("Redis command not allowed on shared connections: %s", command.value(0).data());
+            return false;
+        }
+    }
+
+    auto future = post(commands);
+    if (Q_UNLIKELY(future.wait_for(std::chrono::milliseconds(timeout)) != std::future_status::ready)) {
+        tSystemError("Redis request timed out: %d msecs", timeout);
+        return false;
+    }
+
+    TRedisReply reply = future.get();
+    responses = reply.responses;
+    results = reply.results;
+    return reply.ok;
+}
+
+/*!
+  Returns true if the \a command can share a connection with the commands
+  of other threads. Transactions, connection state changes such as SELECT,
+  subscriptions and blocking commands can not.
+ */
+bool TRedisMultiplexer::isShareable(const QByteArrayList &command)
+{
+    static const QSet<QByteArray> unshareable {
+        // Transactions
+        "MULTI", "EXEC", "DISCARD", "WATCH", "UNWATCH",
+        // Connection state
+        "SELECT", "AUTH", "HELLO", "RESET", "QUIT", "CLIENT", "MONITOR", "READONLY", "READWRITE",
+        // Pub/Sub
+        "SUBSCRIBE", "PSUBSCRIBE", "SSUBSCRIBE", "UNSUBSCRIBE", "PUNSUBSCRIBE", "SUNSUBSCRIBE",
+        // Blocking
+        "BLPOP", "BRPOP", "BRPOPLPUSH", "BLMOVE", "BLMPOP", "BZPOPMIN", "BZPOPMAX", "BZMPOP", "WAIT", "WAITAOF",
+    };
+
+    const QByteArray name = command.value(0).toUpper();
+    if (unshareable.contains(name)) {
+        return false;
+    }
+
+    if (name == "XREAD" || name == "XREADGROUP") {
+        // Blocks with the BLOCK option
+        for (int i = 1; i < command.count(); ++i) {
+            if (command[i].toUpper() == "BLOCK") {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+  Returns the multiplexer named \a name, creating it with \a connections
+  connections to the server \a host:\a port on the first call.
+  \a postOpenStatements are executed whenever a connection is opened.
+ */
+TRedisMultiplexer *TRedisMultiplexer::instance(const QString &name, const QString &host, quint16 port, int connections, const QStringList &postOpenStatements)
+{
+    static QMutex mutex;
+    static QMap<QString, TRedisMultiplexer *> multiplexers;
+
+    QMutexLocker locker(&mutex);
+    auto *&multiplexer = multiplexers[name];
+    if (!multiplexer) {
+        multiplexer = new TRedisMultiplexer(host, port, qMax(connections, 1), postOpenStatements);
+        tSystemDebug("Redis multiplexer created: %s connections:%d", qPrintable(name), multiplexer->connectionCount());
+    }
+    return multiplexer;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include <TGlobal>
+#include <future>
+#include "tatomic.h"
+
+
+class T_CORE_EXPORT TRedisReply {
+public:
+    bool ok {false};  // false if the connection failed
+    QList<QVariantList> responses;
+    QVector<bool> results;
+};
+
+
+class T_CORE_EXPORT TRedisMultiplexer {
+public:
+    ~TRedisMultiplexer();
+
+    std::future<TRedisReply> post(const QList<QByteArrayList> &commands);
+    bool request(const QList<QByteArrayList> &commands, QList<QVariantList> &responses, QVector<bool> &results);
+    int connectionCount() const { return channels.count(); }
+    int requestTimeout() const { return timeout; }
+    void setRequestTimeout(int msecs) { timeout = msecs; }
+
+    static bool isShareable(const QByteArrayList &command);
+    static TRedisMultiplexer *instance(const QString &name, const QString &host, quint16 port, int connections, const QStringList &postOpenStatements);
+
+private:
+    class Channel;
+
+    TRedisMultiplexer(const QString &host, quint16 port, int connections, const QStringList &postOpenStatements);
+
+    QVector<Channel *> channels;
+    TAtomic<uint> next {0};
+    int timeout;  // msecs
+
+    T_DISABLE_COPY(TRedisMultiplexer)
+    T_DISABLE_MOVE(TRedisMultiplexer)
+};
@@ -0,0 +1,142 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tredisdriver.h"
+#include <TRedisPipeline>
+
+/*!
+  \class TRedisPipeline
+  \brief The TRedisPipeline class queues Redis commands and sends them
+  in one write, so that N commands cost one round trip instead of N.
+
+  Each function queueing a command returns the index of its reply.
+  After exec(), the replies are read with the index in the order the
+  commands were queued:
+  \code
+  TRedisPipeline pl = TRedis().pipeline();
+  int a = pl.get("foo");
+  int b = pl.hget("bar", "baz");
+  if (pl.exec()) {
+      QByteArray foo = pl.toByteArray(a);
+      QByteArray baz = pl.toByteArray(b);
+  }
+  \endcode
+  \sa TRedis::pipeline()
+*/
+
+
+TRedisPipeline::TRedisPipeline(const TRedis &redis) :
+    _redis(redis)
+{
+}
+
+/*!
+  Queues a GET command for the \a key.
+ */
+int TRedisPipeline::get(const QByteArray &key)
+{
+    return command({"GET", key});
+}
+
+/*!
+  Queues a SET command to set the \a key to hold the \a value.
+ */
+int TRedisPipeline::set(const QByteArray &key, const QByteArray &value)
+{
+    return command({"SET", key, value});
+}
+
+/*!
+  Queues a SETEX command to set the \a key to hold the \a value and to
+  timeout after \a seconds.
+ */
+int TRedisPipeline::setEx(const QByteArray &key, const QByteArray &value, int seconds)
+{
+    return command({"SETEX", key, QByteArray::number(seconds), value});
+}
+
+/*!
+  Queues a DEL command for the \a key.
+ */
+int TRedisPipeline::del(const QByteArray &key)
+{
+    return command({"DEL", key});
+}
+
+/*!
+  Queues an EXISTS command for the \a key.
+ */
+int TRedisPipeline::exists(const QByteArray &key)
+{
+    return command({"EXISTS", key});
+}
+
+/*!
+  Queues an EXPIRE command to set the \a key to timeout after \a seconds.
+ */
+int TRedisPipeline::expire(const QByteArray &key, int seconds)
+{
+    return command({"EXPIRE", key, QByteArray::number(seconds)});
+}
+
+/*!
+  Queues an HGET command for the \a field of the hash stored at the \a key.
+ */
+int TRedisPipeline::hget(const QByteArray &key, const QByteArray &field)
+{
+    return command({"HGET", key, field});
+}
+
+/*!
+  Queues an HSET command to set the \a field of the hash stored at the
+  \a key to the \a value.
+ */
+int TRedisPipeline::hset(const QByteArray &key, const QByteArray &field, const QByteArray &value)
+{
+    return command({"HSET", key, field, value});
+}
+
+/*!
+  Queues the \a command, the command name followed by its arguments.
+ */
+int TRedisPipeline::command(const QByteArrayList &command)
+{
+    _commands << command;
+    return _commands.count() - 1;
+}
+
+/*!
+  Sends the queued commands and reads all the replies. Returns false if
+  the connection failed; the result of each command is given by
+  isSuccess(). The queue is cleared.
+ */
+bool TRedisPipeline::exec()
+{
+    _replies.clear();
+    _results.clear();
+
+    if (_commands.isEmpty()) {
+        return true;
+    }
+
+    bool res = false;
+    if (_redis.driver()) {
+        res = _redis.driver()->request(_commands, _replies, _results);
+    }
+    _commands.clear();
+    return res;
+}
+
+/*!
+  Clears the queued commands and the replies.
+ */
+void TRedisPipeline::clear()
+{
+    _commands.clear();
+    _replies.clear();
+    _results.clear();
+}
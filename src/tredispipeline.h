@@ -0,0 +1,52 @@
+#pragma once
+#include <QByteArray>
+#include <QList>
+#include <QVariant>
+#include <QVector>
+#include <TGlobal>
+#include <TRedis>
+
+
+class T_CORE_EXPORT TRedisPipeline {
+public:
+    int get(const QByteArray &key);
+    int set(const QByteArray &key, const QByteArray &value);
+    int setEx(const QByteArray &key, const QByteArray &value, int seconds);
+    int del(const QByteArray &key);
+    int exists(const QByteArray &key);
+    int expire(const QByteArray &key, int seconds);
+    int hget(const QByteArray &key, const QByteArray &field);
+    int hset(const QByteArray &key, const QByteArray &field, const QByteArray &value);
+    int command(const QByteArrayList &command);
+
+    int count() const { return _commands.count(); }
+    bool exec();
+    void clear();
+
+    bool isSuccess(int index) const { return _results.value(index, false); }
+    QByteArray toByteArray(int index) const;
+    int toInt(int index) const;
+    bool toBool(int index) const { return toInt(index) == 1; }
+    QVariantList reply(int index) const { return _replies.value(index); }
+
+private:
+    TRedisPipeline(const TRedis &redis);
+
+    TRedis _redis;
+    QList<QByteArrayList> _commands;
+    QList<QVariantList> _replies;
+    QVector<bool> _results;
+
+    friend class TRedis;
+};
+
+
+inline QByteArray TRedisPipeline::toByteArray(int index) const
+{
+    return _replies.value(index).value(0).toByteArray();
+}
+
+inline int TRedisPipeline::toInt(int index) const
+{
+    return _replies.value(index).value(0).toInt();
+}
@@ -41,7 +41,7 @@ TSendBuffer::TSendBuffer(int statusCode, const QHostAddress &address, const QByt
 {
     accesslogger.open();
     accesslogger.setStatusCode(statusCode);
-    accesslogger.setTimestamp(QDateTime::currentDateTime());
+    accesslogger.setTimestamp(Tf::accessLogTimestamp());
     accesslogger.setRemoteHost(address.toString().toLatin1());
     accesslogger.setRequest(method);
 
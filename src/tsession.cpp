@@ -5,6 +5,7 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tsettingssnapshot.h"
 #include "tsystemglobal.h"
 #include <TActionController>
 #include <TAppSettings>
@@ -25,6 +26,7 @@
 void TSession::reset()
 {
     QVariantMap::clear();
+    modified = true;
     // Agsinst CSRF
     TActionController::setCsrfProtectionInto(*this);
 }
@@ -40,7 +42,7 @@ void TSession::clear()
  */
 QByteArray TSession::sessionName()
 {
-    return Tf::appSettings()->value(Tf::SessionName).toByteArray();
+    return TSettingsSnapshot::current().session.name;
 }
 
 
@@ -66,6 +68,28 @@ QByteArray TSession::sessionName()
   replaced with \a value.
 */
 
+/*!
+  \fn TSession::Value TSession::operator[](const QString &key)
+  Returns the value associated with the \a key, which can be assigned
+  to; the assignment inserts the item, as insert() does. Reading the
+  value does not modify the session, nor does it insert an item.
+*/
+
+/*!
+  \fn bool TSession::isModified() const
+  Returns true if items of the session have been inserted, replaced or
+  removed since it was loaded from the session store; otherwise returns
+  false. Inserting a value equal to the current one does not modify
+  the session. An unmodified session is not written back to the store,
+  only its expiration is extended.
+*/
+
+/*!
+  \fn void TSession::setModified(bool modified)
+  Sets the modified flag to \a modified. Call this after changing a value
+  through an iterator, which the session cannot detect.
+*/
+
 /*!
   \fn const QVariant TSession::value(const QString &key) const
   Returns the value associated with the \a key.
@@ -6,6 +6,8 @@
 
 class T_CORE_EXPORT TSession : public QVariantMap {
 public:
+    class Value;
+
     TSession(const QByteArray &id = QByteArray());
     TSession(const TSession &other);
     TSession &operator=(const TSession &other);
@@ -15,18 +17,45 @@ public:
     iterator insert(const QString &key, const QVariant &value);
     int remove(const QString &key);
     QVariant take(const QString &key);
+    Value operator[](const QString &key);
+    const QVariant operator[](const QString &key) const;
     const QVariant value(const QString &key) const;
     const QVariant value(const QString &key, const QVariant &defaultValue) const;
+    bool isModified() const { return modified; }
+    void setModified(bool modified = true) { this->modified = modified; }
     static QByteArray sessionName();
 
 private:
     QByteArray sessionId;
+    bool modified {false};  // items changed since loaded
 
     void clear();  // disabled
     friend class TSessionCookieStore;
     friend class TActionContext;
 };
 
+// Value of an item, which is inserted into the session when assigned
+class TSession::Value : public QVariant {
+public:
+    Value &operator=(const QVariant &value)
+    {
+        QVariant::operator=(value);
+        session->insert(key, value);
+        return *this;
+    }
+
+    Value &operator=(const Value &other) { return operator=(static_cast<const QVariant &>(other)); }
+
+private:
+    Value(TSession *session, const QString &key) :
+        QVariant(session->QVariantMap::value(key)), session(session), key(key) { }
+
+    TSession *session;
+    QString key;
+
+    friend class TSession;
+};
+
 
 inline TSession::TSession(const QByteArray &id) :
     sessionId(id)
@@ -34,7 +63,7 @@ inline TSession::TSession(const QByteArray &id) :
 }
 
 inline TSession::TSession(const TSession &other) :
-    QVariantMap(*static_cast<const QVariantMap *>(&other)), sessionId(other.sessionId)
+    QVariantMap(*static_cast<const QVariantMap *>(&other)), sessionId(other.sessionId), modified(other.modified)
 {
 }
 
@@ -42,22 +71,47 @@ inline TSession &TSession::operator=(const TSession &other)
 {
     QVariantMap::operator=(*static_cast<const QVariantMap *>(&other));
     sessionId = other.sessionId;
+    modified = other.modified;
     return *this;
 }
 
 inline TSession::iterator TSession::insert(const QString &key, const QVariant &value)
 {
+    auto it = QVariantMap::find(key);
+    if (it != QVariantMap::end() && it.value() == value) {
+        return it;  // unchanged
+    }
+    modified = true;
     return QVariantMap::insert(key, value);
 }
 
 inline int TSession::remove(const QString &key)
 {
-    return QVariantMap::remove(key);
+    int cnt = QVariantMap::remove(key);
+    modified = modified || cnt > 0;
+    return cnt;
 }
 
 inline QVariant TSession::take(const QString &key)
 {
-    return QVariantMap::take(key);
+    auto it = QVariantMap::find(key);
+    if (it == QVariantMap::end()) {
+        return QVariant();
+    }
+    modified = true;
+    QVariant value = it.value();
+    QVariantMap::erase(it);
+    return value;
+}
+
+inline TSession::Value TSession::operator[](const QString &key)
+{
+    return Value(this, key);
+}
+
+inline const QVariant TSession::operator[](const QString &key) const
+{
+    return QVariantMap::operator[](key);
 }
 
 inline const QVariant TSession::value(const QString &key) const
@@ -55,13 +55,24 @@ bool TSessionCookieStore::store(TSession &session)
         return false;
     }
 
-    ba = Tf::lz4Compress(ba);
+    ba = compress(ba);
     QByteArray digest = QCryptographicHash::hash(ba + sessionSecret(), QCryptographicHash::Sha1);
     session.sessionId = ba.toBase64() + "_" + digest.toBase64();
     return true;
 }
 
 
+/*!
+  Does nothing; the ID of the \a session received in the cookie already
+  holds its items.
+ */
+bool TSessionCookieStore::touch(TSession &session)
+{
+    Q_UNUSED(session);
+    return true;
+}
+
+
 TSession TSessionCookieStore::find(const QByteArray &id)
 {
     TSession session(id);
@@ -85,7 +96,7 @@ TSession TSessionCookieStore::find(const QByteArray &id)
                 return session;
             }
 
-            ba = Tf::lz4Uncompress(ba);
+            ba = uncompress(ba);
             QDataStream ds(&ba, QIODevice::ReadOnly);
             ds >> *static_cast<QVariantMap *>(&session);
 
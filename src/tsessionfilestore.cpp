@@ -5,6 +5,7 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclock.h"
 #include "tsessionfilestore.h"
 #include "tfcore.h"
 #include "tsystemglobal.h"
@@ -44,7 +45,7 @@ bool TSessionFileStore::store(TSession &session)
         QByteArray buffer;
         QDataStream dsbuf(&buffer, QIODevice::WriteOnly);
         dsbuf << *static_cast<const QVariantMap *>(&session);
-        buffer = Tf::lz4Compress(buffer);  // compress
+        buffer = compress(buffer);  // compress
 
         file.resize(0);  // truncate
         QDataStream ds(&file);
@@ -60,10 +61,29 @@ bool TSessionFileStore::store(TSession &session)
 }
 
 
+/*!
+  Updates the modification time of the file of the \a session.
+ */
+bool TSessionFileStore::touch(TSession &session)
+{
+#if QT_VERSION >= 0x050a00  // 5.10.0
+    QReadLocker locker(&rwLock);  // lock for threads
+    QFile file(sessionDirPath() + session.id());
+    if (file.exists() && file.open(QIODevice::ReadWrite)) {
+        if (file.setFileTime(TClock::currentDateTime(), QFileDevice::FileModificationTime)) {
+            return true;
+        }
+        file.close();
+    }
+#endif
+    return store(session);
+}
+
+
 TSession TSessionFileStore::find(const QByteArray &id)
 {
     QFileInfo fi(sessionDirPath() + id);
-    QDateTime modified = QDateTime::currentDateTime().addSecs(-lifeTimeSecs());
+    QDateTime modified = TClock::currentDateTime().addSecs(-lifeTimeSecs());
 
     if (fi.exists() && fi.lastModified() >= modified) {
         QReadLocker locker(&rwLock);  // lock for threads
@@ -80,7 +100,7 @@ TSession TSessionFileStore::find(const QByteArray &id)
             QByteArray buffer;
             ds >> buffer;
             file.close();
-            buffer = Tf::lz4Uncompress(buffer);
+            buffer = uncompress(buffer);
             TSession result(id);
 
             if (buffer.isEmpty()) {
@@ -7,6 +7,7 @@ public:
     QString key() const { return QStringLiteral("file"); }
     TSession find(const QByteArray &id) override;
     bool store(TSession &session) override;
+    bool touch(TSession &session) override;
     bool remove(const QByteArray &id) override;
     int gc(const QDateTime &expire) override;
 
@@ -5,8 +5,10 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclock.h"
 #include "tsessionmanager.h"
 #include "tsessionstorefactory.h"
+#include "tsettingssnapshot.h"
 #include "tsystemglobal.h"
 #include <QCoreApplication>
 #include <QCryptographicHash>
@@ -33,6 +35,36 @@ static QByteArray createHash()
     return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
 }
 
+namespace {
+
+// Session store for one call. The built-in stores are static in the
+// factory; a plugin store is destroyed when the call returns, while
+// the plugin is still loaded.
+class SessionStore {
+public:
+    SessionStore(const QString &type) :
+        type(type),
+        store(TSessionStoreFactory::create(type))
+    {
+        if (Q_UNLIKELY(!store)) {
+            tSystemError("Session store not found: %s", qPrintable(type));
+        }
+    }
+    ~SessionStore() { TSessionStoreFactory::destroy(type, store); }
+
+    TSessionStore *operator->() const { return store; }
+    explicit operator bool() const { return store; }
+
+private:
+    const QString type;
+    TSessionStore *store {nullptr};
+
+    T_DISABLE_COPY(SessionStore)
+    T_DISABLE_MOVE(SessionStore)
+};
+
+}  // namespace
+
 
 TSessionManager::TSessionManager()
 {
@@ -49,12 +81,9 @@ TSession TSessionManager::findSession(const QByteArray &id)
     TSession session;
 
     if (!id.isEmpty()) {
-        TSessionStore *store = TSessionStoreFactory::create(storeType());
+        SessionStore store(storeType());
         if (Q_LIKELY(store)) {
             session = store->find(id);
-            TSessionStoreFactory::destroy(storeType(), store);
-        } else {
-            tSystemError("Session store not found: %s", qPrintable(storeType()));
         }
     }
     return session;
@@ -69,12 +98,10 @@ bool TSessionManager::store(TSession &session)
     }
 
     bool res = false;
-    TSessionStore *store = TSessionStoreFactory::create(storeType());
+    SessionStore store(storeType());
     if (Q_LIKELY(store)) {
-        res = store->store(session);
-        TSessionStoreFactory::destroy(storeType(), store);
-    } else {
-        tSystemError("Session store not found: %s", qPrintable(storeType()));
+        // Writes the items only if modified
+        res = session.isModified() ? store->store(session) : store->touch(session);
     }
     return res;
 }
@@ -83,13 +110,9 @@ bool TSessionManager::store(TSession &session)
 bool TSessionManager::remove(const QByteArray &id)
 {
     if (!id.isEmpty()) {
-        TSessionStore *store = TSessionStoreFactory::create(storeType());
+        SessionStore store(storeType());
         if (Q_LIKELY(store)) {
-            bool ret = store->remove(id);
-            TSessionStoreFactory::destroy(storeType(), store);
-            return ret;
-        } else {
-            tSystemError("Session store not found: %s", qPrintable(storeType()));
+            return store->remove(id);
         }
     }
     return false;
@@ -98,8 +121,7 @@ bool TSessionManager::remove(const QByteArray &id)
 
 QString TSessionManager::storeType() const
 {
-    static QString type = Tf::appSettings()->value(Tf::SessionStoreType).toString().toLower();
-    return type;
+    return TSettingsSnapshot::current().session.storeType;
 }
 
 
@@ -122,7 +144,8 @@ QByteArray TSessionManager::generateId()
 
 void TSessionManager::collectGarbage()
 {
-    static const int prob = Tf::appSettings()->value(Tf::SessionGcProbability).toInt();
+    const auto &settings = TSettingsSnapshot::current().session;
+    const int prob = settings.gcProbability;
 
     if (prob > 0) {
         int r = Tf::random(0, prob - 1);
@@ -131,12 +154,11 @@ void TSessionManager::collectGarbage()
         if (r == 0) {
             tSystemDebug("Session garbage collector started");
 
-            TSessionStore *store = TSessionStoreFactory::create(storeType());
+            SessionStore store(storeType());
             if (store) {
-                int gclifetime = Tf::appSettings()->value(Tf::SessionGcMaxLifeTime).toInt();
-                QDateTime expire = QDateTime::currentDateTime().addSecs(-gclifetime);
+                int gclifetime = settings.gcMaxLifeTime;
+                QDateTime expire = TClock::currentDateTime().addSecs(-gclifetime);
                 store->gc(expire);
-                TSessionStoreFactory::destroy(storeType(), store);
             }
         }
     }
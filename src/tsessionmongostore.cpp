@@ -5,6 +5,7 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclock.h"
 #include "tsessionmongostore.h"
 #include "tsessionmongoobject.h"
 #include <TCriteria>
@@ -55,9 +56,23 @@ bool TSessionMongoStore::store(TSession &session)
 }
 
 
+/*!
+  Updates the updatedAt field of the \a session only.
+ */
+bool TSessionMongoStore::touch(TSession &session)
+{
+    TMongoODMapper<TSessionMongoObject> mapper;
+    TCriteria cri(TSessionMongoObject::SessionId, TMongo::Equal, QString::fromUtf8(session.id()));
+    if (mapper.updateAll(cri, TSessionMongoObject::UpdatedAt, TClock::currentDateTime()) > 0) {
+        return true;
+    }
+    return store(session);  // removed meanwhile
+}
+
+
 TSession TSessionMongoStore::find(const QByteArray &id)
 {
-    QDateTime modified = QDateTime::currentDateTime().addSecs(-lifeTimeSecs());
+    QDateTime modified = TClock::currentDateTime().addSecs(-lifeTimeSecs());
     TMongoODMapper<TSessionMongoObject> mapper;
     TCriteria cri;
     cri.add(TSessionMongoObject::SessionId, TMongo::Equal, QString::fromUtf8(id));
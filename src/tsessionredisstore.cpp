@@ -22,7 +22,7 @@ bool TSessionRedisStore::store(TSession &session)
     QByteArray data;
     QDataStream ds(&data, QIODevice::WriteOnly);
     ds << *static_cast<const QVariantMap *>(&session);
-    data = Tf::lz4Compress(data);
+    data = compress(data);
 
 #ifndef TF_NO_DEBUG
     {
@@ -45,6 +45,16 @@ bool TSessionRedisStore::store(TSession &session)
 }
 
 
+/*!
+  Resets the timeout of the \a session.
+ */
+bool TSessionRedisStore::touch(TSession &session)
+{
+    TRedis redis;
+    return redis.expire('_' + session.id(), lifeTimeSecs()) || store(session);
+}
+
+
 TSession TSessionRedisStore::find(const QByteArray &id)
 {
     TRedis redis;
@@ -54,7 +64,7 @@ TSession TSessionRedisStore::find(const QByteArray &id)
         return TSession();
     }
 
-    data = Tf::lz4Uncompress(data);
+    data = uncompress(data);
     QDataStream ds(data);
     TSession session(id);
     ds >> *static_cast<QVariantMap *>(&session);
@@ -5,12 +5,27 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tclock.h"
 #include "tsessionsqlobjectstore.h"
 #include "tsessionobject.h"
 #include <TCriteria>
 #include <TSqlORMapper>
 #include <mutex>
 
+constexpr qint64 MAX_TOUCH_INTERVAL = 60;  // secs
+
+namespace {
+
+// Session found last by the thread, as the store is shared by threads
+struct FoundSession {
+    QByteArray id;
+    QDateTime updatedAt;
+};
+
+thread_local FoundSession foundSession;
+
+}  // namespace
+
 
 static void createSessionTable()
 {
@@ -63,7 +78,7 @@ bool TSessionSqlObjectStore::store(TSession &session)
     QByteArray data;
     QDataStream ds(&data, QIODevice::WriteOnly);
     ds << *static_cast<const QVariantMap *>(&session);
-    so.data = QString::fromLatin1(Tf::lz4Compress(data).toBase64());
+    so.data = QString::fromLatin1(compress(data).toBase64());
 
     if (ds.status() != QDataStream::Ok) {
         tSystemError("Failed to store session. Must set objects that can be serialized.");
@@ -78,23 +93,53 @@ bool TSessionSqlObjectStore::store(TSession &session)
 }
 
 
+/*!
+  Updates the updated_at column of the \a session only. The update is
+  skipped if the session found by find() was updated less than a tenth
+  of the session lifetime ago, up to MAX_TOUCH_INTERVAL seconds, which
+  shortens the lifetime by that interval at most.
+ */
+bool TSessionSqlObjectStore::touch(TSession &session)
+{
+    createSessionTable();
+
+    const QDateTime now = TClock::currentDateTime();
+    const qint64 interval = qMin(MAX_TOUCH_INTERVAL, lifeTimeSecs() / 10);
+    if (session.id() == foundSession.id && foundSession.updatedAt.isValid() && foundSession.updatedAt.secsTo(now) < interval) {
+        return true;
+    }
+
+    TSqlQuery query;
+    query.prepare(QStringLiteral("UPDATE %1 SET updated_at=? WHERE id=?").arg(TSessionObject().tableName()));
+    query.addBind(now).addBind(QString::fromLatin1(session.id()));
+    if (query.exec() && query.numRowsAffected() > 0) {
+        foundSession.id = session.id();
+        foundSession.updatedAt = now;
+        return true;
+    }
+    return store(session);  // removed meanwhile
+}
+
+
 TSession TSessionSqlObjectStore::find(const QByteArray &id)
 {
     createSessionTable();
 
-    QDateTime modified = QDateTime::currentDateTime().addSecs(-lifeTimeSecs());
+    QDateTime modified = TClock::currentDateTime().addSecs(-lifeTimeSecs());
     TSqlORMapper<TSessionObject> mapper;
     TCriteria cri;
     cri.add(TSessionObject::Id, TSql::Equal, id);
     cri.add(TSessionObject::UpdatedAt, TSql::GreaterEqual, modified);
 
     TSessionObject so = mapper.findFirst(cri);
+    foundSession.id = so.isNull() ? QByteArray() : id;
+    foundSession.updatedAt = so.updated_at;
     if (so.isNull()) {
         return TSession();
     }
 
     TSession session(id);
-    QByteArray data = Tf::lz4Uncompress(QByteArray::fromBase64(so.data.toLatin1()));
+    QByteArray data = uncompress(QByteArray::fromBase64(so.data.toLatin1()));
     QDataStream ds(&data, QIODevice::ReadOnly);
     ds >> *static_cast<QVariantMap *>(&session);
 
@@ -2,11 +2,12 @@
 #include <TSessionStore>
 
 
-class TSessionSqlObjectStore : public TSessionStore {
+class T_CORE_EXPORT TSessionSqlObjectStore : public TSessionStore {
 public:
     QString key() const { return "sqlobject"; }
     TSession find(const QByteArray &id) override;
     bool store(TSession &session) override;
+    bool touch(TSession &session) override;
     bool remove(const QByteArray &id) override;
     int gc(const QDateTime &expire) override;
 };
@@ -5,8 +5,11 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tlz4compressor.h"
+#include <QFileInfo>
 #include <TAppSettings>
 #include <TSessionStore>
+#include <TWebApplication>
 
 
 qint64 TSessionStore::lifeTimeSecs()
@@ -22,6 +25,37 @@ qint64 TSessionStore::lifeTimeSecs()
 }
 
 
+static const TLz4Compressor &compressor()
+{
+    static const TLz4Compressor lz4 = []() {
+        TLz4Compressor lz4(Tf::appSettings()->value(Tf::SessionCompressionThreshold, 64).toInt());
+        QString path = Tf::appSettings()->value(Tf::SessionCompressionDictionary).toString().trimmed();
+        if (!path.isEmpty()) {
+            lz4.loadDictionary(QFileInfo(path).isRelative() ? Tf::app()->configPath() + path : path);
+        }
+        return lz4;
+    }();
+    return lz4;
+}
+
+/*!
+  Compresses the serialized session \a data to be stored; the session
+  stores call this.
+ */
+QByteArray TSessionStore::compress(const QByteArray &data)
+{
+    return compressor().compress(data);
+}
+
+/*!
+  Uncompresses the \a data compressed by compress().
+ */
+QByteArray TSessionStore::uncompress(const QByteArray &data)
+{
+    return compressor().uncompress(data);
+}
+
+
 /*!
   \class TSessionStore
   \brief The TSessionStore is an abstract class that stores HTTP sessions.
@@ -47,6 +81,14 @@ qint64 TSessionStore::lifeTimeSecs()
   This function should be called from any reimplementations of store().
 */
 
+/*!
+  \fn virtual bool TSessionStore::touch(TSession &session)
+  Extends the expiration of the \a session, which has not been modified
+  since it was found, without writing its items. The default
+  implementation calls store(); reimplement it if the store can do this
+  at lower cost.
+*/
+
 /*!
   \fn virtual bool TSessionStore::remove(const QDateTime &expiration)
   Removes all sessions older than the \a expiration datetime.
@@ -11,9 +11,12 @@ public:
     virtual ~TSessionStore() { }
     virtual TSession find(const QByteArray &id) = 0;
     virtual bool store(TSession &sesion) = 0;
+    virtual bool touch(TSession &session) { return store(session); }
     virtual bool remove(const QByteArray &id) = 0;
     virtual int gc(const QDateTime &expire) = 0;
 
     static qint64 lifeTimeSecs();
+    static QByteArray compress(const QByteArray &data);
+    static QByteArray uncompress(const QByteArray &data);
 };
 
@@ -0,0 +1,132 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tsettingssnapshot.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <TAppSettings>
+#include <TWebApplication>
+
+/*!
+  \class TSettingsSnapshot
+  \brief The TSettingsSnapshot class holds the typed, immutable settings
+  read on the request path, so that no QVariant conversion nor string-keyed
+  lookup is needed per request.
+
+  The snapshot is built when first used and is never modified once
+  published; reload() builds a new one and swaps it in atomically.
+  Superseded snapshots are retained, because readers hold plain
+  references to them.
+*/
+
+std::atomic<const TSettingsSnapshot *> TSettingsSnapshot::snapshot {nullptr};
+
+
+TSettingsSnapshot *TSettingsSnapshot::load()
+{
+    auto *snap = new TSettingsSnapshot;
+
+    // SQL databases
+    for (int i = 0; i < Tf::app()->sqlDatabaseSettingsCount(); ++i) {
+        const QVariantMap &settings = Tf::app()->sqlDatabaseSettings(i);
+        TSqlDatabaseSettings db;
+
+        db.driverType = settings.value("DriverType").toString().trimmed();
+        db.databaseName = settings.value("DatabaseName").toString().trimmed();
+        db.hostName = settings.value("HostName").toString().trimmed();
+        db.port = settings.value("Port").toInt();
+        db.userName = settings.value("UserName").toString().trimmed();
+        db.password = settings.value("Password").toString().trimmed();
+        db.connectOptions = settings.value("ConnectOptions").toString().trimmed();
+        db.postOpenStatements = settings.value("PostOpenStatements").toString().trimmed().split(";", QString::SkipEmptyParts);
+        db.enableUpsert = settings.value("EnableUpsert", false).toBool();
+        db.statementCacheSize = settings.value("StatementCacheSize", 32).toInt();
+        db.commonNameHeader = settings.value("commonName").toByteArray().trimmed();
+        db.userCertificateHeader = settings.value("userCertificate").toByteArray().trimmed();
+        db.certDir = settings.value("certDir").toString().trimmed();
+        db.userConnectionCacheSize = settings.value("UserConnectionCacheSize", 0).toInt();
+        db.userConnectionIdleTimeout = settings.value("UserConnectionIdleTimeout", 60).toInt();
+
+        // Replicas: "host[:port]" each, with optional database names in the same order
+        const QStringList hosts = settings.value("ReplicaHostNames").toString().split(",", QString::SkipEmptyParts);
+        const QStringList dbnames = settings.value("ReplicaDatabaseNames").toString().split(",", QString::SkipEmptyParts);
+        for (int j = 0; j < qMax(hosts.count(), dbnames.count()); ++j) {
+            TSqlReplicaSettings replica;
+            if (j < hosts.count()) {
+                const QString host = hosts[j].trimmed();
+                int idx = host.lastIndexOf(':');
+                replica.hostName = (idx > 0) ? host.left(idx) : host;
+                replica.port = (idx > 0) ? host.mid(idx + 1).toInt() : db.port;
+            } else {
+                replica.hostName = db.hostName;
+                replica.port = db.port;
+            }
+            replica.databaseName = (j < dbnames.count()) ? dbnames[j].trimmed() : db.databaseName;
+            db.replicas << replica;
+        }
+        QString selection = settings.value("ReplicaSelection").toString().trimmed();
+        db.replicaSelection = (selection.compare("LeastLoaded", Qt::CaseInsensitive) == 0) ? TSqlDatabaseSettings::LeastLoaded : TSqlDatabaseSettings::RoundRobin;
+        snap->sqlDatabases << db;
+    }
+
+    // Session
+    auto *appSettings = Tf::appSettings();
+    snap->session.name = appSettings->value(Tf::SessionName).toByteArray();
+    snap->session.storeType = appSettings->value(Tf::SessionStoreType).toString().toLower();
+    snap->session.autoIdRegeneration = appSettings->value(Tf::SessionAutoIdRegeneration).toBool();
+    snap->session.cookiePath = appSettings->value(Tf::SessionCookiePath).toString().trimmed();
+    snap->session.cookieDomain = appSettings->value(Tf::SessionCookieDomain).toString().trimmed();
+    snap->session.cookieSameSite = appSettings->value(Tf::SessionCookieSameSite).toByteArray().trimmed();
+    snap->session.lifeTime = appSettings->value(Tf::SessionLifeTime).toInt();
+    QString maxagestr = appSettings->value(Tf::SessionCookieMaxAge).toString().trimmed();
+    snap->session.cookieMaxAge = (maxagestr.isEmpty()) ? snap->session.lifeTime : maxagestr.toInt();
+    snap->session.gcProbability = appSettings->value(Tf::SessionGcProbability).toInt();
+    snap->session.gcMaxLifeTime = appSettings->value(Tf::SessionGcMaxLifeTime).toInt();
+
+    // Cache
+    snap->cache.gcProbability = appSettings->value(Tf::CacheGcProbability, 0).toInt();
+    snap->cache.enableCompression = appSettings->value(Tf::CacheEnableCompression, true).toBool();
+    snap->cache.compressionThreshold = appSettings->value(Tf::CacheCompressionThreshold, 128).toInt();
+    snap->cache.compressionHcThreshold = appSettings->value(Tf::CacheCompressionHcThreshold, 65536).toInt();
+    return snap;
+}
+
+namespace {
+
+QMutex snapshotMutex;
+QVector<const TSettingsSnapshot *> retiredSnapshots;
+
+}  // namespace
+
+/*!
+  Builds and publishes the snapshot unless another thread has done so.
+*/
+const TSettingsSnapshot *TSettingsSnapshot::init()
+{
+    QMutexLocker locker(&snapshotMutex);
+    const TSettingsSnapshot *ptr = snapshot.load(std::memory_order_acquire);
+    if (!ptr) {
+        ptr = load();
+        snapshot.store(ptr, std::memory_order_release);
+    }
+    return ptr;
+}
+
+/*!
+  Builds a new snapshot from the current settings of the application
+  and publishes it. Requests in progress keep the snapshot they started
+  with. The cache stores read whether to compress when they open, so
+  clear the cache after changing Cache.EnableCompression.
+*/
+void TSettingsSnapshot::reload()
+{
+    QMutexLocker locker(&snapshotMutex);
+    const TSettingsSnapshot *old = snapshot.exchange(load(), std::memory_order_acq_rel);
+    if (old) {
+        retiredSnapshots << old;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <TGlobal>
+#include <atomic>
+
+
+class T_CORE_EXPORT TSqlReplicaSettings {
+public:
+    QString hostName;
+    int port {0};
+    QString databaseName;
+};
+
+
+class T_CORE_EXPORT TSqlDatabaseSettings {
+public:
+    enum ReplicaSelection {
+        RoundRobin = 0,
+        LeastLoaded,
+    };
+
+    QString driverType;
+    QString databaseName;
+    QString hostName;
+    int port {0};
+    QString userName;
+    QString password;
+    QString connectOptions;
+    QStringList postOpenStatements;
+    bool enableUpsert {false};
+    int statementCacheSize {32};
+
+    // Read replicas
+    QVector<TSqlReplicaSettings> replicas;
+    ReplicaSelection replicaSelection {RoundRobin};
+
+    // Certificate authentication
+    QByteArray commonNameHeader;
+    QByteArray userCertificateHeader;
+    QString certDir;
+    int userConnectionCacheSize {0};  // 0: number of threads per server
+    int userConnectionIdleTimeout {60};  // seconds
+
+    bool isCertAuthEnabled() const { return !commonNameHeader.isEmpty(); }
+};
+
+
+class T_CORE_EXPORT TSessionSettings {
+public:
+    QByteArray name;
+    QString storeType;
+    bool autoIdRegeneration {false};
+    QString cookiePath;
+    QString cookieDomain;
+    QByteArray cookieSameSite;
+    int cookieMaxAge {0};
+    int lifeTime {0};
+    int gcProbability {0};
+    int gcMaxLifeTime {0};
+};
+
+
+class T_CORE_EXPORT TCacheSettings {
+public:
+    int gcProbability {0};
+    bool enableCompression {true};
+    int compressionThreshold {128};  // bytes
+    int compressionHcThreshold {65536};  // bytes
+};
+
+
+class T_CORE_EXPORT TSettingsSnapshot {
+public:
+    QVector<TSqlDatabaseSettings> sqlDatabases;
+    TSessionSettings session;
+    TCacheSettings cache;
+
+    const TSqlDatabaseSettings &sqlDatabase(int databaseId) const;
+
+    static const TSettingsSnapshot &current();
+    static void reload();
+
+private:
+    TSettingsSnapshot() { }
+    static TSettingsSnapshot *load();
+    static const TSettingsSnapshot *init();
+    static std::atomic<const TSettingsSnapshot *> snapshot;
+
+    T_DISABLE_COPY(TSettingsSnapshot)
+    T_DISABLE_MOVE(TSettingsSnapshot)
+};
+
+
+inline const TSqlDatabaseSettings &TSettingsSnapshot::sqlDatabase(int databaseId) const
+{
+    static const TSqlDatabaseSettings invalidSettings;
+    return (databaseId >= 0 && databaseId < sqlDatabases.count()) ? sqlDatabases[databaseId] : invalidSettings;
+}
+
+/*!
+  Returns the snapshot in effect; a single atomic load. The reference
+  stays valid for the lifetime of the process.
+*/
+inline const TSettingsSnapshot &TSettingsSnapshot::current()
+{
+    const TSettingsSnapshot *ptr = snapshot.load(std::memory_order_acquire);
+    if (Q_UNLIKELY(!ptr)) {
+        ptr = init();
+    }
+    return *ptr;
+}
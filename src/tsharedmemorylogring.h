@@ -0,0 +1,52 @@
+#pragma once
+#include <QtGlobal>
+#include <atomic>
+
+// Layout of the log ring of TSharedMemoryLogStream in the shared memory
+namespace TSharedMemoryLogRing {
+
+constexpr quint32 MAGIC = 0x544C5234;  // "TLR4"
+constexpr int SLOT_SIZE = 512;
+
+// Fixed-size slot holding one log. The sequence tells whether the slot
+// is free for position N (== N) or published for position N (== N + 1).
+struct Slot {
+    std::atomic<quint64> sequence;
+    qint64 timestamp;  // msecs since epoch
+    qint64 pid;
+    quint64 threadId;
+    qint32 priority;
+    qint32 length;
+    std::atomic<qint64> owner;  // PID of the reserving process, 0 if free
+};
+
+constexpr int SLOT_DATA_SIZE = SLOT_SIZE - (int)sizeof(Slot);
+
+
+struct alignas(64) Header {
+    quint32 magic;
+    quint32 slotCount;
+    std::atomic<quint64> reserveIndex;  // next position for producers
+    quint64 drainIndex;  // next position to drain, guarded by the shared memory lock
+};
+
+
+inline Header *header(void *data)
+{
+    return reinterpret_cast<Header *>(data);
+}
+
+
+inline Slot *slotAt(Header *header, quint64 pos)
+{
+    char *slots = reinterpret_cast<char *>(header) + sizeof(Header);
+    return reinterpret_cast<Slot *>(slots + (pos % header->slotCount) * SLOT_SIZE);
+}
+
+
+inline char *slotData(Slot *slot)
+{
+    return reinterpret_cast<char *>(slot) + sizeof(Slot);
+}
+
+}  // namespace TSharedMemoryLogRing
@@ -5,12 +5,25 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tprocessinfo.h"
+#include "tsharedmemorylogring.h"
 #include "tsharedmemorylogstream.h"
+#include <QCoreApplication>
 #include <QSharedMemory>
 #include <TSystemGlobal>
+#include <atomic>
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <signal.h>
+#endif
 
 constexpr auto CREATE_KEY = "TreeFrogLogStream";
 
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "lock-free 64-bit atomics required for shared memory");
+
+using namespace TSharedMemoryLogRing;
+
+namespace {
 
 class TSharedMemoryLocker {
 public:
@@ -22,27 +35,45 @@ private:
     QSharedMemory *sm;
 };
 
+}  // namespace
+
+/*!
+  \class TSharedMemoryLogStream
+  \brief The TSharedMemoryLogStream class provides a log stream buffered
+  in a multi-producer ring of fixed-size slots in shared memory.
+
+  Processes reserve a slot with an atomic operation and copy the log into
+  it without taking any lock; a process holding the shared memory lock
+  drains the published slots to the loggers periodically.
+
+  A slot reserved by a process that has died before publishing it is
+  skipped so that draining goes on. A slot of a process alive is waited
+  for however slow the process is, as it still writes into the slot.
+*/
 
 TSharedMemoryLogStream::TSharedMemoryLogStream(const QList<TLogger *> loggers, int size, QObject *parent) :
     TAbstractLogStream(loggers, parent),
     shareMem(new QSharedMemory(CREATE_KEY))
 {
-    if (size < dataSizeOf(QList<TLog>())) {
-        tSystemError("Shared memory size not enough: %d (bytes)", shareMem->size());
+    if (size < (int)sizeof(Header) + SLOT_SIZE) {
+        tSystemError("Shared memory size not enough: %d (bytes)", size);
         return;
     }
 
-    if (shareMem->create(size)) {
-        TSharedMemoryLocker locker(shareMem);
-        clearBuffer();
-    } else {
+    if (!shareMem->create(size)) {
         if (shareMem->error() != QSharedMemory::AlreadyExists) {
             tSystemError("Shared memory create error: %s", qPrintable(shareMem->errorString()));
-        } else {
-            if (!shareMem->attach()) {
-                tSystemError("Shared memory attach error: %s", qPrintable(shareMem->errorString()));
-            }
+            return;
         }
+        if (!shareMem->attach()) {
+            tSystemError("Shared memory attach error: %s", qPrintable(shareMem->errorString()));
+            return;
+        }
+    }
+
+    ringAvailable = setupRing();
+    if (ringAvailable) {
+        timer.start(200, this);
     }
 }
 
@@ -53,120 +84,205 @@ TSharedMemoryLogStream::~TSharedMemoryLogStream()
     delete shareMem;
 }
 
-
-void TSharedMemoryLogStream::writeLog(const TLog &log)
+/*!
+  Initializes the ring if no process has done yet, or verifies the
+  layout of the existing one.
+*/
+bool TSharedMemoryLogStream::setupRing()
 {
     TSharedMemoryLocker locker(shareMem);
-    if (isNonBufferingMode()) {
-        QList<TLog> logs;
-        logs << log;
-        loggerWriteLog(logs);
-        return;
+    auto *header = TSharedMemoryLogRing::header(shareMem->data());
+    if (!header) {
+        tSystemError("Shared memory not attached");
+        return false;
+    }
+
+    quint32 slotCount = (shareMem->size() - sizeof(Header)) / SLOT_SIZE;
+
+    if (header->magic == MAGIC) {
+        if (header->slotCount != slotCount) {
+            tSystemError("Shared memory log ring mismatch: %u slots (expected %u)", header->slotCount, slotCount);
+            return false;
+        }
+        return true;
     }
 
-    QList<TLog> logList = smRead();
-    logList << log;
-    if (smWrite(logList)) {
-        if (!timer.isActive())
-            timer.start(200, this);
-    } else {
-        loggerWriteLog(logList);
-        clearBuffer();
+    header->slotCount = slotCount;
+    header->reserveIndex.store(0);
+    header->drainIndex = 0;
+    for (quint32 i = 0; i < slotCount; ++i) {
+        slotAt(header, i)->sequence.store(i);
+        slotAt(header, i)->owner.store(0);
     }
+    header->magic = MAGIC;
+    return true;
 }
 
-
-void TSharedMemoryLogStream::flush()
+/*!
+  Copies the \a log into a free slot. Returns false if the ring is full or
+  the message does not fit into a slot.
+*/
+bool TSharedMemoryLogStream::enqueue(const TLog &log)
 {
-    if (isNonBufferingMode())
-        return;
+    if (log.message.length() > SLOT_DATA_SIZE) {
+        return false;
+    }
 
-    TSharedMemoryLocker locker(shareMem);
-    loggerWriteLog(smRead());
-    clearBuffer();
-}
+    auto *header = TSharedMemoryLogRing::header(shareMem->data());
+    quint64 pos = header->reserveIndex.load(std::memory_order_relaxed);
+    Slot *slot;
 
+    for (;;) {
+        slot = slotAt(header, pos);
+        qint64 diff = (qint64)(slot->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (header->reserveIndex.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // full
+        } else {
+            pos = header->reserveIndex.load(std::memory_order_relaxed);
+        }
+    }
 
-QString TSharedMemoryLogStream::errorString() const
-{
-    return shareMem->errorString();
+    slot->owner.store(QCoreApplication::applicationPid(), std::memory_order_relaxed);
+    slot->timestamp = log.timestamp.toMSecsSinceEpoch();
+    slot->pid = log.pid;
+    slot->threadId = log.threadId;
+    slot->priority = log.priority;
+    slot->length = log.message.length();
+    memcpy(slotData(slot), log.message.constData(), log.message.length());
+
+    // Publishes, unless the drainer has skipped the slot meanwhile
+    quint64 expected = pos;
+    return slot->sequence.compare_exchange_strong(expected, pos + 1, std::memory_order_release);
 }
 
-
-void TSharedMemoryLogStream::loggerWriteLog(const QList<TLog> &logs)
+/*!
+  Returns true if the process of the \a pid is running.
+*/
+static bool isProcessAlive(qint64 pid)
 {
-    loggerOpen();
-    loggerWrite(logs);
-    loggerFlush();
-    loggerClose(MultiProcessUnsafe);
+#ifdef Q_OS_UNIX
+    return ::kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#else
+    return TProcessInfo(pid).exists();
+#endif
 }
 
+/*!
+  Returns true if the \a slot, reserved but not published, is to be
+  skipped because the process reserving it has died. The owner is not
+  known until the producer records it just after the reservation, so
+  the slot is waited for meanwhile.
+*/
+static bool isStaleReservation(Slot *slot)
+{
+    qint64 owner = slot->owner.load(std::memory_order_relaxed);
+    return owner > 0 && owner != QCoreApplication::applicationPid() && !isProcessAlive(owner);
+}
 
-void TSharedMemoryLogStream::clearBuffer()
+/*!
+  Takes all the published logs out of the ring. The shared memory lock
+  must be held by the caller.
+*/
+QList<TLog> TSharedMemoryLogStream::dequeueAll()
 {
-    smWrite(QList<TLog>());
-    timer.stop();
+    QList<TLog> logs;
+    if (!ringAvailable) {
+        return logs;
+    }
+
+    auto *header = TSharedMemoryLogRing::header(shareMem->data());
+    for (;;) {
+        quint64 pos = header->drainIndex;
+        Slot *slot = slotAt(header, pos);
+        quint64 seq = slot->sequence.load(std::memory_order_acquire);
+        if (seq != pos + 1) {
+            if (seq != pos || header->reserveIndex.load() <= pos || !isStaleReservation(slot)) {
+                break;  // not published yet
+            }
+
+            // Skips the reservation of the dead process
+            quint64 expected = pos;
+            qint64 owner = slot->owner.exchange(0, std::memory_order_relaxed);
+            if (slot->sequence.compare_exchange_strong(expected, pos + header->slotCount, std::memory_order_release)) {
+                tSystemWarn("Log slot skipped: reserved by PID %lld and not written", owner);
+                header->drainIndex = pos + 1;
+            }
+            continue;
+        }
+
+        TLog log;
+        log.timestamp = QDateTime::fromMSecsSinceEpoch(slot->timestamp);
+        log.priority = slot->priority;
+        log.pid = slot->pid;
+        log.threadId = slot->threadId;
+        log.message = QByteArray(slotData(slot), slot->length);
+        logs << log;
+
+        slot->owner.store(0, std::memory_order_relaxed);
+        slot->sequence.store(pos + header->slotCount, std::memory_order_release);  // frees
+        header->drainIndex = pos + 1;
+    }
+    return logs;
 }
 
 
-void TSharedMemoryLogStream::setNonBufferingMode()
+void TSharedMemoryLogStream::writeLog(const TLog &log)
 {
-    tSystemDebug("TSharedMemoryLogStream::setNonBufferingMode()");
-    if (!isNonBufferingMode()) {
-        flush();
-        shareMem->detach();
+    if (!isNonBufferingMode() && ringAvailable && enqueue(log)) {
+        return;
     }
-    TAbstractLogStream::setNonBufferingMode();
+
+    // Writes directly, after the buffered logs
+    TSharedMemoryLocker locker(shareMem);
+    QList<TLog> logs = dequeueAll();
+    logs << log;
+    loggerWriteLog(logs);
 }
 
 
-QList<TLog> TSharedMemoryLogStream::smRead()
+void TSharedMemoryLogStream::flush()
 {
-    QList<TLog> logs;
-    if (!shareMem->data()) {
-        tSystemError("Shared memory not attached");
-        return logs;
+    if (isNonBufferingMode()) {
+        return;
     }
 
-    QByteArray buffer((char *)shareMem->data(), shareMem->size());
-    QDataStream ds(&buffer, QIODevice::ReadOnly);
-    ds >> logs;
-    if (ds.status() != QDataStream::Ok) {
-        tSystemError("Shared memory read error");
-        clearBuffer();
-        return QList<TLog>();
+    TSharedMemoryLocker locker(shareMem);
+    QList<TLog> logs = dequeueAll();
+    if (!logs.isEmpty()) {
+        loggerWriteLog(logs);
     }
-    return logs;
 }
 
 
-bool TSharedMemoryLogStream::smWrite(const QList<TLog> &logs)
+QString TSharedMemoryLogStream::errorString() const
 {
-    QByteArray buffer;
-    QDataStream ds(&buffer, QIODevice::WriteOnly);
-    ds << logs;
-
-    if (buffer.size() > shareMem->size()) {
-        // over the shared memory size
-        return false;
-    }
+    return shareMem->errorString();
+}
 
-    if (!shareMem->data()) {
-        tSystemError("Shared memory not attached");
-        return false;
-    }
 
-    memcpy(shareMem->data(), buffer.constData(), buffer.size());
-    return true;
+void TSharedMemoryLogStream::loggerWriteLog(const QList<TLog> &logs)
+{
+    loggerOpen();
+    loggerWrite(logs);
+    loggerFlush();
+    loggerClose(MultiProcessUnsafe);
 }
 
 
-int TSharedMemoryLogStream::dataSizeOf(const QList<TLog> &logs)
+void TSharedMemoryLogStream::setNonBufferingMode()
 {
-    QByteArray ba;
-    QDataStream ds(&ba, QIODevice::WriteOnly);
-    ds << logs;
-    return ba.size();
+    tSystemDebug("TSharedMemoryLogStream::setNonBufferingMode()");
+    if (!isNonBufferingMode()) {
+        flush();
+        timer.stop();
+        ringAvailable = false;
+        shareMem->detach();
+    }
+    TAbstractLogStream::setNonBufferingMode();
 }
 
 
@@ -178,5 +294,4 @@ void TSharedMemoryLogStream::timerEvent(QTimerEvent *event)
     }
 
     flush();
-    timer.stop();
 }
@@ -7,7 +7,7 @@ class QSharedMemory;
 
 class T_CORE_EXPORT TSharedMemoryLogStream : public TAbstractLogStream {
 public:
-    TSharedMemoryLogStream(const QList<TLogger *> loggers, int size = 4096, QObject *parent = 0);
+    TSharedMemoryLogStream(const QList<TLogger *> loggers, int size = 256 * 1024, QObject *parent = 0);
     ~TSharedMemoryLogStream();
 
     void writeLog(const TLog &);
@@ -17,17 +17,16 @@ public:
 
 protected:
     void loggerWriteLog(const QList<TLog> &logs);
-    void clearBuffer();
-    QList<TLog> smRead();
-    bool smWrite(const QList<TLog> &logs);
-    static int dataSizeOf(const QList<TLog> &logs);
+    bool setupRing();
+    bool enqueue(const TLog &log);
+    QList<TLog> dequeueAll();
     void timerEvent(QTimerEvent *event);
 
 private:
     QSharedMemory *shareMem;
     QBasicTimer timer;
+    bool ringAvailable {false};
 
     T_DISABLE_COPY(TSharedMemoryLogStream)
     T_DISABLE_MOVE(TSharedMemoryLogStream)
 };
-
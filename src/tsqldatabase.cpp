@@ -96,7 +96,7 @@ void TSqlDatabase::setDriverExtension(TSqlDriverExtension *extension)
 const TSqlDatabase &TSqlDatabase::database(const QString &connectionName)
 {
     pid_t tid = gettid();
-    tSystemDebug("TSqlDatabase::database tid: %d connectionName: %s", tid, connectionName.toStdString().c_str());
+    tSystemDebug("TSqlDatabase::database tid: %d connectionName: %s", tid, qPrintable(connectionName));
 
     static TSqlDatabase defaultDatabase;
     defaultDatabase._tid = tid;
@@ -129,7 +129,7 @@ const TSqlDatabase &TSqlDatabase::database(const QString &connectionName)
 void TSqlDatabase::setInuse(const QString &connectionName)
 {
     pid_t tid = gettid();
-    tSystemDebug("TSqlDatabase::wait tid: %d connectionName: %s", tid, connectionName.toStdString().c_str());
+    tSystemDebug("TSqlDatabase::wait tid: %d connectionName: %s", tid, qPrintable(connectionName));
 
     auto *dict = dbDict();
     QReadLocker locker(&dict->xlock);
@@ -159,7 +159,7 @@ void TSqlDatabase::setInuse(const QString &connectionName)
 TSqlDatabase &TSqlDatabase::addDatabase(const QString &driver, const QString &connectionName)
 {
     pid_t tid = gettid();
-    tSystemDebug("TSqlDatabase::addDatabase tid: %d connectionName: %s", tid, connectionName.toStdString().c_str());
+    tSystemDebug("TSqlDatabase::addDatabase tid: %d connectionName: %s", tid, qPrintable(connectionName));
 
     auto *dict = dbDict();
     QWriteLocker locker(&dict->xlock);
@@ -176,7 +176,7 @@ TSqlDatabase &TSqlDatabase::addDatabase(const QString &driver, const QString &co
 const TSqlDatabase &TSqlDatabase::unsetInuse(const QString &connectionName)
 {
     pid_t tid = gettid();
-    tSystemDebug("TSqlDatabase::unsetInuse: %s tid: %d", connectionName.toStdString().c_str(), tid);
+    tSystemDebug("TSqlDatabase::unsetInuse: %s tid: %d", qPrintable(connectionName), tid);
     static TSqlDatabase defaultDatabase;
     auto *dict = dbDict();
     QReadLocker locker(&dict->xlock);
@@ -211,6 +211,15 @@ bool TSqlDatabase::contains(const QString &connectionName)
 }
 
 
+bool TSqlDatabase::isInuse(const QString &connectionName)
+{
+    auto *dict = dbDict();
+    QReadLocker locker(&dict->xlock);
+    auto it = dict->constFind(connectionName);
+    return it != dict->constEnd() && it->_tid.loadAcquire() != 0;
+}
+
+
 bool TSqlDatabase::isUpsertSupported() const
 {
     return _driverExtension && _driverExtension->isUpsertSupported();
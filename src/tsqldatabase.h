@@ -64,6 +64,7 @@ public:
     static TSqlDatabase &addDatabase(const QString &driver, const QString &connectionName = QLatin1String(defaultConnection));
     static void removeDatabase(const QString &connectionName = QLatin1String(defaultConnection));
     static bool contains(const QString &connectionName = QLatin1String(defaultConnection));
+    static bool isInuse(const QString &connectionName);
 
 private:
     QSqlDatabase _sqlDatabase;
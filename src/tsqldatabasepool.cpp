@@ -6,19 +6,23 @@
  */
 
 #include "tsqldatabasepool.h"
+#include "tclientcertificatecache.h"
+#include "tclock.h"
 #include "tsqldatabase.h"
+#include "tsettingssnapshot.h"
 #include "tsqldriverextensionfactory.h"
+#include "tsqlstatementcache.h"
+#include "tsqluserconnectioncache.h"
 #include "tsystemglobal.h"
 #include <QDir>
 #include <QFileInfo>
-#include <QMutexLocker>
 #include <TAppSettings>
 #include <TSqlQuery>
 #include <TWebApplication>
-#include <ctime>
 
 constexpr auto CONN_NAME_FORMAT = "rdb%02d_%d";
 constexpr auto CONN_COMMONNAME_FORMAT = "udb%02d_%s";
+constexpr auto CONN_REPLICA_NAME_FORMAT = "rpl%02d_%d_%d";
 
 
 TSqlDatabasePool *TSqlDatabasePool::instance()
@@ -45,10 +49,13 @@ TSqlDatabasePool::~TSqlDatabasePool()
     timer.stop();
 
     for (int j = 0; j < Tf::app()->sqlDatabaseSettingsCount(); ++j) {
+        delete userConnections[j];
+
         auto &cache = cachedDatabase[j];
         QString name;
         while (cache.pop(name)) {
             QSqlDatabase db = TSqlDatabase::database(name).sqlDatabase();
+            TSqlStatementCache::invalidate(name);
             db.close();
             TSqlDatabase::removeDatabase(name);
         }
@@ -57,22 +64,36 @@ TSqlDatabasePool::~TSqlDatabasePool()
         while (stack.pop(name)) {
             TSqlDatabase::removeDatabase(name);
         }
+
+        for (auto *replica : (const QVector<ReplicaPool *> &)replicaPools[j]) {
+            while (replica->cachedDatabase.pop(name)) {
+                QSqlDatabase db = TSqlDatabase::database(name).sqlDatabase();
+                TSqlStatementCache::invalidate(name);
+                db.close();
+                TSqlDatabase::removeDatabase(name);
+            }
+            while (replica->availableNames.pop(name)) {
+                TSqlDatabase::removeDatabase(name);
+            }
+            delete replica;
+        }
     }
 
+    delete[] userConnections;
     delete[] cachedDatabase;
     delete[] lastCachedTime;
     delete[] availableNames;
+    delete[] replicaPools;
+    delete[] replicaCursor;
 }
 
 
 static QString driverType(int databaseId)
 {
-    auto settings = Tf::app()->sqlDatabaseSettings(databaseId);
-    QString key = QLatin1String("DriverType");
-    QString type = settings.value(key).toString().trimmed();
+    const QString &type = TSettingsSnapshot::current().sqlDatabase(databaseId).driverType;
 
     if (type.isEmpty()) {
-        tWarn() << "Empty parameter: " << key << " databaseId:" << databaseId;
+        tWarn() << "Empty parameter: DriverType  databaseId:" << databaseId;
     }
     return type;
 }
@@ -86,25 +107,28 @@ void TSqlDatabasePool::init()
     }
 
     tSystemDebug("+++ SQL database is available");
-    userDbCache = new TLruCache(3);   // TODO: allocate for each database
-
+    userConnections = new TSqlUserConnectionCache *[Tf::app()->sqlDatabaseSettingsCount()]();
     cachedDatabase = new TStack<QString>[Tf::app()->sqlDatabaseSettingsCount()];
-    lastCachedTime = new TAtomic<uint>[Tf::app()->sqlDatabaseSettingsCount()];
+    lastCachedTime = new TAtomic<qint64>[Tf::app()->sqlDatabaseSettingsCount()]();
     availableNames = new TStack<QString>[Tf::app()->sqlDatabaseSettingsCount()];
+    replicaPools = new QVector<ReplicaPool *>[Tf::app()->sqlDatabaseSettingsCount()];
+    replicaCursor = new TAtomic<uint>[Tf::app()->sqlDatabaseSettingsCount()];
     bool aval = false;
     tSystemDebug("SQL database available");
 
     // Adds databases previously
     for (int j = 0; j < Tf::app()->sqlDatabaseSettingsCount(); ++j) {
-        auto settings = Tf::app()->sqlDatabaseSettings(j);
-
         QString type = driverType(j);
         if (type.isEmpty()) {
             continue;
         }
         aval = true;
 
-        if (!settings.value("commonName").isNull()) {
+        const auto &settings = TSettingsSnapshot::current().sqlDatabase(j);
+        if (settings.isCertAuthEnabled()) {
+            int capacity = (settings.userConnectionCacheSize > 0) ? settings.userConnectionCacheSize : maxConnects;
+            userConnections[j] = new TSqlUserConnectionCache(capacity);
+            tSystemDebug("User connection cache: databaseId:%d capacity:%d", j, capacity);
             continue;
         }
 
@@ -120,6 +144,23 @@ void TSqlDatabasePool::init()
             stack.push(db.connectionName());  // push onto stack
             tSystemDebug("Add Database successfully. name:%s", qPrintable(db.connectionName()));
         }
+
+        // Read replicas
+        for (int r = 0; r < settings.replicas.count(); ++r) {
+            auto *replica = new ReplicaPool;
+            replicaPools[j] << replica;
+
+            for (int i = 0; i < maxConnects; ++i) {
+                TSqlDatabase &db = TSqlDatabase::addDatabase(type, QString().sprintf(CONN_REPLICA_NAME_FORMAT, j, r, i));
+                if (!db.isValid()) {
+                    break;
+                }
+
+                setDatabaseSettings(db, j, r);
+                replica->availableNames.push(db.connectionName());
+            }
+            tSystemDebug("Add replica database: databaseId:%d replica:%d host:%s", j, r, qPrintable(settings.replicas[r].hostName));
+        }
     }
 
     if (aval) {
@@ -139,105 +180,196 @@ QSqlDatabase TSqlDatabasePool::x_database(int databaseId, const QString &commonN
     }
 
     if (!commonName.isEmpty()) {
-        tSystemDebug("*** Ooooweee");
+        auto *userCache = userConnections[databaseId];
+        if (Q_UNLIKELY(!userCache)) {
+            tSystemError("Certificate authentication not enabled: %d", databaseId);
+            return QSqlDatabase();
+        }
 
         QString type = driverType(databaseId);
         if (type.isEmpty()) {
             tSystemError("SQL database database type is null: %d", databaseId);
             return QSqlDatabase();
         }
-        tSystemDebug("SQL database database type: %s", type.toStdString().c_str());
 
         auto dbName = QString().sprintf(CONN_COMMONNAME_FORMAT, databaseId, commonName.toLatin1().constData());
-        tSystemDebug("Connection name: %s", dbName.toStdString().c_str());
+        tSystemDebug("Connection name: %s", qPrintable(dbName));
 
-        mutex.lock();
-        TSqlDatabase xdb = TSqlDatabase::database(dbName);
-        if (xdb.connectionName().isEmpty()) {
-            tSystemDebug("Adding Database. Name: %s", dbName.toStdString().c_str());
-            xdb = TSqlDatabase::addDatabase(type, dbName);
+        bool cached = userCache->checkout(dbName, [&]() {
+            if (TSqlDatabase::contains(dbName)) {
+                return true;
+            }
+            tSystemDebug("Adding Database. Name: %s", qPrintable(dbName));
+            TSqlDatabase &xdb = TSqlDatabase::addDatabase(type, dbName);
             if (!setCertAuthSettings(xdb, databaseId, commonName)) {
                 tSystemError("setCertAuthSettings failed");
-                return QSqlDatabase();
+                TSqlDatabase::removeDatabase(dbName);
+                return false;
             }
-            tSystemDebug("Add Database successfully. Name: %s", xdb.connectionName().toStdString().c_str());
+            return true;
+        });
+        if (!cached) {
+            return QSqlDatabase();
         }
 
-        if (Q_UNLIKELY(!xdb.sqlDatabase().open())) {
-            tError("Database open error. Invalid database settings, or maximum number of SQL connection exceeded.");
-            tSystemError("SQL database open error: %s %s", qPrintable(xdb.sqlDatabase().connectionName()),
-                         qPrintable(xdb.sqlDatabase().lastError().text()));
-            return QSqlDatabase();
-        } else {
-            tSystemDebug("SQL database opened successfully (env:%s)", qPrintable(Tf::app()->databaseEnvironment()));
+        // Takes the connection for this thread; opens it outside of any
+        // lock, while the cache keeps it pinned
+        TSqlDatabase xdb;
+        try {
+            xdb = TSqlDatabase::database(dbName);
+        } catch (...) {
+            userCache->release(dbName);
+            throw;
         }
-        mutex.unlock();
 
-        tSystemDebug("Caching %s", dbName.toStdString().c_str());
-        userDbCache->cache(dbName);
+        if (!xdb.sqlDatabase().isOpen()) {
+            // The driver reads the client certificate from the file
+            QString certPath = TClientCertificateCache::certificatePath(TSettingsSnapshot::current().sqlDatabase(databaseId).certDir, commonName);
+            if (Q_UNLIKELY(!TClientCertificateCache::instance().writeFile(certPath))) {
+                tSystemError("Client certificate not available: %s", qPrintable(certPath));
+                TSqlDatabase::unsetInuse(dbName);
+                userCache->release(dbName);
+                return QSqlDatabase();
+            }
+
+            if (Q_UNLIKELY(!xdb.sqlDatabase().open())) {
+                tError("Database open error. Invalid database settings, or maximum number of SQL connection exceeded.");
+                tSystemError("SQL database open error: %s %s", qPrintable(xdb.sqlDatabase().connectionName()),
+                    qPrintable(xdb.sqlDatabase().lastError().text()));
+                TSqlDatabase::unsetInuse(dbName);
+                userCache->release(dbName);
+                return QSqlDatabase();
+            }
+            tSystemDebug("SQL database opened successfully (env:%s)", qPrintable(Tf::app()->databaseEnvironment()));
+
+            // Executes setup-queries
+            if (!xdb.postOpenStatements().isEmpty()) {
+                TSqlQuery query(xdb.sqlDatabase());
+                for (QString st : xdb.postOpenStatements()) {
+                    st = st.trimmed();
+                    query.exec(st);
+                }
+            }
+        }
 
         tSystemDebug("Gets database: %s", qPrintable(xdb.sqlDatabase().connectionName()));
         return xdb.sqlDatabase();
     } else {
-        auto &cache = cachedDatabase[databaseId];
-        auto &stack = availableNames[databaseId];
-
-        for (;;) {
-            QString name;
-            if (cache.pop(name)) {
-                auto tdb = TSqlDatabase::database(name);
-                if (Q_LIKELY(tdb.sqlDatabase().isOpen())) {
-                    tSystemDebug("Gets cached database: %s", qPrintable(tdb.connectionName()));
-                    return tdb.sqlDatabase();
-                } else {
-                    tSystemError("Pooled database is not open: %s  [%s:%d]", qPrintable(tdb.connectionName()),
-                                 __FILE__, __LINE__);
+        return checkout(cachedDatabase[databaseId], availableNames[databaseId]);
+    }
+}
+
+/*!
+  Takes a connection out of \a cache, the stack of the pooled connections,
+  or opens one of \a stack, the stack of the closed connections.
+ */
+QSqlDatabase TSqlDatabasePool::checkout(TStack<QString> &cache, TStack<QString> &stack)
+{
+    for (;;) {
+        QString name;
+        if (cache.pop(name)) {
+            auto tdb = TSqlDatabase::database(name);
+            if (Q_LIKELY(tdb.sqlDatabase().isOpen())) {
+                tSystemDebug("Gets cached database: %s", qPrintable(tdb.connectionName()));
+                return tdb.sqlDatabase();
+            } else {
+                tSystemError("Pooled database is not open: %s  [%s:%d]", qPrintable(tdb.connectionName()),
+                             __FILE__, __LINE__);
+                stack.push(name);
+                continue;
+            }
+        }
+
+        if (Q_LIKELY(stack.pop(name))) {
+            auto tdb = TSqlDatabase::database(name);
+            if (Q_UNLIKELY(tdb.sqlDatabase().isOpen())) {
+                tSystemWarn("Gets a opend database: %s", qPrintable(tdb.connectionName()));
+                return tdb.sqlDatabase();
+            } else {
+                if (Q_UNLIKELY(!tdb.sqlDatabase().open())) {
+                    tError("Database open error. Invalid database settings, or maximum number of SQL connection exceeded.");
+                    tSystemError("SQL database open error: %s", qPrintable(tdb.sqlDatabase().connectionName()));
+                    TSqlDatabase::unsetInuse(name);
                     stack.push(name);
-                    continue;
+                    return QSqlDatabase();
                 }
-            }
 
-            if (Q_LIKELY(stack.pop(name))) {
-                auto tdb = TSqlDatabase::database(name);
-                if (Q_UNLIKELY(tdb.sqlDatabase().isOpen())) {
-                    tSystemWarn("Gets a opend database: %s", qPrintable(tdb.connectionName()));
-                    return tdb.sqlDatabase();
-                } else {
-                    if (Q_UNLIKELY(!tdb.sqlDatabase().open())) {
-                        tError("Database open error. Invalid database settings, or maximum number of SQL connection exceeded.");
-                        tSystemError("SQL database open error: %s", qPrintable(tdb.sqlDatabase().connectionName()));
-                        stack.push(name);
-                        return QSqlDatabase();
-                    }
+                tSystemDebug("SQL database opened successfully (env:%s)",
+                             qPrintable(Tf::app()->databaseEnvironment()));
+                tSystemDebug("Gets database: %s", qPrintable(tdb.sqlDatabase().connectionName()));
 
-                    tSystemDebug("SQL database opened successfully (env:%s)",
-                                 qPrintable(Tf::app()->databaseEnvironment()));
-                    tSystemDebug("Gets database: %s", qPrintable(tdb.sqlDatabase().connectionName()));
-
-                    // Executes setup-queries
-                    if (!tdb.postOpenStatements().isEmpty()) {
-                        TSqlQuery query(tdb.sqlDatabase());
-                        for (QString st : tdb.postOpenStatements()) {
-                            st = st.trimmed();
-                            query.exec(st);
-                        }
+                // Executes setup-queries
+                if (!tdb.postOpenStatements().isEmpty()) {
+                    TSqlQuery query(tdb.sqlDatabase());
+                    for (QString st : tdb.postOpenStatements()) {
+                        st = st.trimmed();
+                        query.exec(st);
                     }
-                    return tdb.sqlDatabase();
                 }
+                return tdb.sqlDatabase();
             }
         }
     }
 }
 
+/*!
+  Returns a connection to a read replica of the database \a databaseId,
+  selected in round-robin or least-loaded order. If the replica can not
+  be connected, the others are tried in turn. Returns an invalid database
+  if no replica is available.
+ */
+QSqlDatabase TSqlDatabasePool::replicaDatabase(int databaseId)
+{
+    if (!hasReplicas(databaseId)) {
+        return QSqlDatabase();
+    }
+
+    const auto &replicas = replicaPools[databaseId];
+    int first = 0;
+    if (TSettingsSnapshot::current().sqlDatabase(databaseId).replicaSelection == TSqlDatabaseSettings::LeastLoaded) {
+        int load = replicas[0]->checkedOut.load();
+        for (int r = 1; r < replicas.count(); ++r) {
+            if (replicas[r]->checkedOut.load() < load) {
+                load = replicas[r]->checkedOut.load();
+                first = r;
+            }
+        }
+    } else {
+        first = replicaCursor[databaseId]++ % replicas.count();
+    }
+
+    for (int i = 0; i < replicas.count(); ++i) {
+        auto *replica = replicas[(first + i) % replicas.count()];
+        QSqlDatabase db = checkout(replica->cachedDatabase, replica->availableNames);
+        if (Q_LIKELY(db.isValid())) {
+            replica->checkedOut++;
+            return db;
+        }
+    }
+
+    tSystemError("No replica available: databaseId:%d", databaseId);
+    return QSqlDatabase();
+}
+
+/*!
+  Returns true if read replicas are configured for the database
+  \a databaseId.
+ */
+bool TSqlDatabasePool::hasReplicas(int databaseId) const
+{
+    return replicaPools && databaseId >= 0 && databaseId < Tf::app()->sqlDatabaseSettingsCount()
+        && !replicaPools[databaseId].isEmpty();
+}
+
 
 bool TSqlDatabasePool::setCertAuthSettings(TSqlDatabase &database, int databaseId, const QString &commonName)
 {
     tSystemDebug("TSqlDatabasePool::setCertAuthSettings");
     // Initiates database
-    auto settings = Tf::app()->sqlDatabaseSettings(databaseId);
+    const auto &settings = TSettingsSnapshot::current().sqlDatabase(databaseId);
 
-    QString databaseName = settings.value("DatabaseName").toString().trimmed();
-    tSystemDebug("databaseName: |%s|", databaseName.toStdString().c_str());
+    QString databaseName = settings.databaseName;
+    tSystemDebug("databaseName: |%s|", qPrintable(databaseName));
     if (databaseName.isEmpty()) {
         tError("Database name empty string");
         return false;
@@ -254,19 +386,19 @@ bool TSqlDatabasePool::setCertAuthSettings(TSqlDatabase &database, int databaseI
         }
     }
     database.sqlDatabase().setDatabaseName(databaseName);
-    tSystemDebug("Database databaseName: |%s|", database.sqlDatabase().databaseName().toStdString().c_str());
+    tSystemDebug("Database databaseName: |%s|", qPrintable(database.sqlDatabase().databaseName()));
 
-    QString hostName = settings.value("HostName").toString().trimmed();
+    const QString &hostName = settings.hostName;
     if (!hostName.isEmpty()) {
         database.sqlDatabase().setHostName(hostName);
-        tSystemDebug("Database hostName: %s", database.sqlDatabase().hostName().toStdString().c_str());
+        tSystemDebug("Database hostName: %s", qPrintable(database.sqlDatabase().hostName()));
     }
     else {
         tError("Hostname empty string");
         return false;
     }
 
-    int port = settings.value("Port").toInt();
+    int port = settings.port;
     if (port > 0) {
         tSystemDebug("Database Port: %d", port);
         database.sqlDatabase().setPort(port);
@@ -274,25 +406,25 @@ bool TSqlDatabasePool::setCertAuthSettings(TSqlDatabase &database, int databaseI
 
     if (!commonName.isEmpty()) {
         database.sqlDatabase().setUserName(commonName);
-        tSystemDebug("Database userName: %s", database.sqlDatabase().userName().toStdString().c_str());
+        tSystemDebug("Database userName: %s", qPrintable(database.sqlDatabase().userName()));
     }
 
     QString connectOptions = QString("sslmode=verify-full;"
                              "sslrootcert=/certs/ca.crt;"
                              "sslcert=%1/%2_crt.pem;"
-                             "sslkey=%1/%2_key.pem").arg(settings.value("certDir").toString(), commonName);
+                             "sslkey=%1/%2_key.pem").arg(settings.certDir, commonName);
     if (!connectOptions.isEmpty()) {
         database.sqlDatabase().setConnectOptions(connectOptions);
-        tSystemDebug("Database connectOptions: %s", database.sqlDatabase().connectOptions().toStdString().c_str());
+        tSystemDebug("Database connectOptions: %s", qPrintable(database.sqlDatabase().connectOptions()));
     }
 
-    QStringList postOpenStatements = settings.value("PostOpenStatements").toString().trimmed().split(";", QString::SkipEmptyParts);
+    const QStringList &postOpenStatements = settings.postOpenStatements;
     tSystemDebug("Database postOpenStatements: %s", qPrintable(postOpenStatements.join(";")));
     if (!postOpenStatements.isEmpty()) {
         database.setPostOpenStatements(postOpenStatements);
     }
 
-    bool enableUpsert = settings.value("EnableUpsert", false).toBool();
+    bool enableUpsert = settings.enableUpsert;
     tSystemDebug("Database enableUpsert: %d", enableUpsert);
     database.setUpsertEnabled(enableUpsert);
 
@@ -303,12 +435,18 @@ bool TSqlDatabasePool::setCertAuthSettings(TSqlDatabase &database, int databaseI
 }
 
 
-bool TSqlDatabasePool::setDatabaseSettings(TSqlDatabase &database, int databaseId)
+bool TSqlDatabasePool::setDatabaseSettings(TSqlDatabase &database, int databaseId, int replica)
 {
     // Initiates database
-    auto settings = Tf::app()->sqlDatabaseSettings(databaseId);
+    const auto &settings = TSettingsSnapshot::current().sqlDatabase(databaseId);
 
-    QString databaseName = settings.value("DatabaseName").toString().trimmed();
+    // A replica differs from the primary in the host, port and database name
+    TSqlReplicaSettings location {settings.hostName, settings.port, settings.databaseName};
+    if (replica >= 0 && replica < settings.replicas.count()) {
+        location = settings.replicas[replica];
+    }
+
+    QString databaseName = location.databaseName;
     if (databaseName.isEmpty()) {
         tError("Database name empty string");
         return false;
@@ -325,43 +463,43 @@ bool TSqlDatabasePool::setDatabaseSettings(TSqlDatabase &database, int databaseI
     }
     database.sqlDatabase().setDatabaseName(databaseName);
 
-    QString hostName = settings.value("HostName").toString().trimmed();
+    const QString &hostName = location.hostName;
     tSystemDebug("Database HostName: %s", qPrintable(hostName));
     if (!hostName.isEmpty()) {
         database.sqlDatabase().setHostName(hostName);
     }
 
-    int port = settings.value("Port").toInt();
+    int port = location.port;
     tSystemDebug("Database Port: %d", port);
     if (port > 0) {
         database.sqlDatabase().setPort(port);
     }
 
-    QString userName = settings.value("UserName").toString().trimmed();
+    const QString &userName = settings.userName;
     tSystemDebug("Database UserName: %s", qPrintable(userName));
     if (!userName.isEmpty()) {
         database.sqlDatabase().setUserName(userName);
     }
 
-    QString password = settings.value("Password").toString().trimmed();
+    const QString &password = settings.password;
     tSystemDebug("Database Password: %s", qPrintable(password));
     if (!password.isEmpty()) {
         database.sqlDatabase().setPassword(password);
     }
 
-    QString connectOptions = settings.value("ConnectOptions").toString().trimmed();
+    const QString &connectOptions = settings.connectOptions;
     tSystemDebug("Database ConnectOptions: %s", qPrintable(connectOptions));
     if (!connectOptions.isEmpty()) {
         database.sqlDatabase().setConnectOptions(connectOptions);
     }
 
-    QStringList postOpenStatements = settings.value("PostOpenStatements").toString().trimmed().split(";", QString::SkipEmptyParts);
+    const QStringList &postOpenStatements = settings.postOpenStatements;
     tSystemDebug("Database postOpenStatements: %s", qPrintable(postOpenStatements.join(";")));
     if (!postOpenStatements.isEmpty()) {
         database.setPostOpenStatements(postOpenStatements);
     }
 
-    bool enableUpsert = settings.value("EnableUpsert", false).toBool();
+    bool enableUpsert = settings.enableUpsert;
     tSystemDebug("Database enableUpsert: %d", enableUpsert);
     database.setUpsertEnabled(enableUpsert);
 
@@ -380,20 +518,33 @@ void TSqlDatabasePool::pool(QSqlDatabase &database, bool forceClose)
         tSystemDebug("Pooled datbase id: %d", databaseId);
 
         if (Q_LIKELY(databaseId >= 0 && databaseId < Tf::app()->sqlDatabaseSettingsCount())) {
-            auto commonName = Tf::app()->sqlDatabaseSettings(databaseId).value("commonName").toString();
-            tSystemDebug("Pooling commonName: %s", commonName.toStdString().c_str());
-            if (!commonName.isNull()) {
-                tSystemDebug("--- Ooooweee");
-                tSystemDebug("Pooling connection: %s", database.connectionName().toStdString().c_str());
-                TSqlDatabase xdb = TSqlDatabase::unsetInuse(database.connectionName());
+            if (userConnections[databaseId]) {
+                tSystemDebug("Pooling connection: %s", qPrintable(database.connectionName()));
+                if (forceClose) {
+                    TSqlStatementCache::invalidate(database.connectionName());
+                    database.close();
+                }
+                userConnections[databaseId]->release(database.connectionName());
+                TSqlDatabase::unsetInuse(database.connectionName());
             } else {
+                int replica = getReplicaIndex(database.connectionName());
+                if (replica >= 0) {
+                    replicaPools[databaseId][replica]->checkedOut--;
+                    TSqlDatabase::unsetInuse(database.connectionName());
+                }
+
                 if (forceClose) {
                     tSystemWarn("Force close database: %s", qPrintable(database.connectionName()));
                     closeDatabase(database);
+                } else if (replica >= 0) {
+                    auto *replicaPool = replicaPools[databaseId][replica];
+                    replicaPool->cachedDatabase.push(database.connectionName());
+                    replicaPool->lastCachedTime.store(TClock::monotonicSecs());
+                    tSystemDebug("Pooled replica database: %s", qPrintable(database.connectionName()));
                 } else {
                     // pool
                     cachedDatabase[databaseId].push(database.connectionName());
-                    lastCachedTime[databaseId].store((uint)std::time(nullptr));
+                    lastCachedTime[databaseId].store(TClock::monotonicSecs());
                     tSystemDebug("Pooled database: %s", qPrintable(database.connectionName()));
                 }
             }
@@ -413,22 +564,26 @@ void TSqlDatabasePool::timerEvent(QTimerEvent *event)
 
         // Closes extra-connection
         for (int i = 0; i < Tf::app()->sqlDatabaseSettingsCount(); ++i) {
-            auto commonName = Tf::app()->sqlDatabaseSettings(i).value("commonName").toString();
-//            tSystemDebug("Pooling commonName: %s", commonName.toStdString().c_str());
-            if (!commonName.isNull()) {
-//                tSystemDebug("--- timerEvent");
-                userDbCache->expire();
-            }
-            else {
-            auto &cache = cachedDatabase[i];
-            if (cache.count() == 0) {
+            if (userConnections[i]) {
+                auto *userCache = userConnections[i];
+                userCache->expire(TSettingsSnapshot::current().sqlDatabase(i).userConnectionIdleTimeout);
+                tSystemDebug("User connection cache: databaseId:%d count:%d hits:%llu misses:%llu evictions:%llu",
+                    i, userCache->count(), userCache->hitCount(), userCache->missCount(), userCache->evictionCount());
                 continue;
             }
 
-            while (lastCachedTime[i].load() < (uint)std::time(nullptr) - 30
+            auto &cache = cachedDatabase[i];
+            while (cache.count() > 0 && TClock::monotonicSecs() - lastCachedTime[i].load() > 30
                 && cache.pop(name)) {
                 QSqlDatabase db = TSqlDatabase::database(name).sqlDatabase();
                 closeDatabase(db);
+            }
+
+            for (auto *replica : (const QVector<ReplicaPool *> &)replicaPools[i]) {
+                while (replica->cachedDatabase.count() > 0 && TClock::monotonicSecs() - replica->lastCachedTime.load() > 30
+                    && replica->cachedDatabase.pop(name)) {
+                    QSqlDatabase db = TSqlDatabase::database(name).sqlDatabase();
+                    closeDatabase(db);
                 }
             }
         }
@@ -442,19 +597,62 @@ void TSqlDatabasePool::closeDatabase(QSqlDatabase &database)
 {
     int id = getDatabaseId(database);
     QString name = database.connectionName();
+    TSqlStatementCache::invalidate(name);
     database.close();
     tSystemDebug("Closed database connection, name: %s", qPrintable(name));
-    availableNames[id].push(name);
+
+    int replica = getReplicaIndex(name);
+    if (replica >= 0) {
+        TSqlDatabase::unsetInuse(name);
+        replicaPools[id][replica]->availableNames.push(name);
+    } else {
+        availableNames[id].push(name);
+    }
+}
+
+
+/*!
+  Returns the cache of the certificate-authenticated connections for the
+  database \a databaseId, or nullptr if the database does not use
+  certificate authentication.
+*/
+const TSqlUserConnectionCache *TSqlDatabasePool::userConnectionCache(int databaseId) const
+{
+    if (databaseId < 0 || databaseId >= Tf::app()->sqlDatabaseSettingsCount() || !userConnections) {
+        return nullptr;
+    }
+    return userConnections[databaseId];
 }
 
 
 int TSqlDatabasePool::getDatabaseId(const QSqlDatabase &database)
+{
+    return getDatabaseId(database.connectionName());
+}
+
+
+int TSqlDatabasePool::getDatabaseId(const QString &connectionName)
 {
     bool ok;
-    int id = database.connectionName().mid(3, 2).toInt(&ok);
+    int id = connectionName.midRef(3, 2).toInt(&ok);
 
     if (Q_LIKELY(ok && id >= 0)) {
         return id;
     }
     return -1;
 }
+
+/*!
+  Returns the index of the replica of the connection \a connectionName,
+  or -1 if it is a connection to the primary.
+ */
+int TSqlDatabasePool::getReplicaIndex(const QString &connectionName)
+{
+    if (!connectionName.startsWith(QLatin1String("rpl"))) {
+        return -1;
+    }
+
+    bool ok;
+    int replica = connectionName.section(QLatin1Char('_'), 1, 1).toInt(&ok);
+    return (ok && replica >= 0) ? replica : -1;
+}
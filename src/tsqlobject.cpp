@@ -7,8 +7,11 @@
 
 #include "tsqldatabase.h"
 #include "tsqldriverextension.h"
+#include "tsqlschemacache.h"
 #include <QCoreApplication>
 #include <QMetaObject>
+#include <QReadWriteLock>
+#include <QVersionNumber>
 #include <QtSql>
 #include <TSqlObject>
 #include <TSqlQuery>
@@ -52,11 +55,30 @@ TSqlObject &TSqlObject::operator=(const TSqlObject &other)
     return *this;
 }
 
+namespace {
+// Columns are in the order of the fields unless the table was altered
+inline int fieldIndex(const QSqlRecord &record, int hint, const char *name)
+{
+    return (hint < record.count() && record.fieldName(hint) == QLatin1String(name)) ? hint : record.indexOf(QLatin1String(name));
+}
+
+QReadWriteLock tableNameLock;
+QHash<const QMetaObject *, QString> tableNames;
+}
+
 /*
   Returns the table name, which is generated from the class name.
 */
 QString TSqlObject::tableName() const
 {
+    {
+        QReadLocker locker(&tableNameLock);
+        auto it = tableNames.constFind(metaObject());
+        if (Q_LIKELY(it != tableNames.constEnd())) {
+            return it.value();
+        }
+    }
+
     static const QString ObjectStr = "Object";
     QString tblName;
     QString clsname(metaObject()->className());
@@ -72,6 +94,9 @@ QString TSqlObject::tableName() const
         }
         tblName += clsname.at(i).toLower();
     }
+
+    QWriteLocker locker(&tableNameLock);
+    tableNames.insert(metaObject(), tblName);
     return tblName;
 }
 
@@ -138,17 +163,25 @@ bool TSqlObject::create()
     }
 
     QSqlDatabase &database = Tf::currentSqlDatabase(databaseId());
-    QString ins = database.driver()->sqlStatement(QSqlDriver::InsertStatement, tableName(), record, false);
-    ins += " RETURNING *";
+    QString ins = database.driver()->sqlStatement(QSqlDriver::InsertStatement, tableName(), record, true);
     if (Q_UNLIKELY(ins.isEmpty())) {
         sqlError = QSqlError(QLatin1String("No fields to insert"),
             QString(), QSqlError::StatementError);
         tWarn("SQL statement error, no fields to insert");
         return false;
     }
+    ins += " RETURNING *";
 
+    // Binds the values so that the statement is reused for each object
     TSqlQuery query(database);
-    bool ret = query.exec(ins);
+    query.setStatementCacheEnabled(true);
+    query.prepare(ins);
+    for (int i = 0; i < record.count(); ++i) {
+        if (record.isGenerated(i)) {
+            query.addBind(record.value(i));
+        }
+    }
+    bool ret = query.exec();
     sqlError = query.lastError();
 
     if (ret && query.next()) {
@@ -193,14 +226,14 @@ bool TSqlObject::update()
         return false;
     }
 
-    QVariant::Type pkType = metaProp.type();
     QVariant origpkval = value(pkName);
     where.append(QLatin1String(pkName));
-    where.append(QLatin1Char('=')).append(TSqlQuery::formatValue(origpkval, pkType, database));
+    where.append(QLatin1String("=?"));
     // Restore the value of primary key
     QObject::setProperty(pkName, origpkval);
 
     QList<int> *list = omitColumns();
+    QVariantList values;
 
     for (int i = offset; i < metaObject()->propertyCount(); ++i) {
         metaProp = metaObject()->property(i);
@@ -213,9 +246,8 @@ bool TSqlObject::update()
             tSystemDebug("Column %d not omitted", i - offset);
 
             upd.append(QLatin1String(propName));
-            upd.append(QLatin1Char('='));
-            upd.append(TSqlQuery::formatValue(newval, metaProp.type(), database));
-            upd.append(QLatin1Char(','));
+            upd.append(QLatin1String("=?,"));
+            values << newval;
         } else {
             tSystemDebug("Column %d omitted", i - offset);
         }
@@ -232,7 +264,13 @@ bool TSqlObject::update()
     upd.append(QLatin1String(" RETURNING *"));
 
     TSqlQuery query(database);
-    bool ret = query.exec(upd);
+    query.setStatementCacheEnabled(true);
+    query.prepare(upd);
+    for (auto &val : values) {
+        query.addBind(val);
+    }
+    query.addBind(origpkval);
+    bool ret = query.exec();
     sqlError = query.lastError();
 
     if (ret && query.next()) {
@@ -315,6 +353,272 @@ bool TSqlObject::update()
 //    return ret;
 //}
 
+/*
+  Returns true if INSERT statements on \a database can return the rows
+  with RETURNING.
+*/
+static bool supportsReturning(QSqlDatabase &database)
+{
+    switch (database.driver()->dbmsType()) {
+    case QSqlDriver::PostgreSQL:
+        return true;
+
+    case QSqlDriver::SQLite: {
+        // As of SQLite 3.35; one library per process
+        static const bool supported = [&database]() {
+            TSqlQuery query(database);
+            if (!query.exec(QStringLiteral("SELECT sqlite_version()")) || !query.next()) {
+                return false;
+            }
+            return QVersionNumber::fromString(query.value(0).toString()) >= QVersionNumber(3, 35);
+        }();
+        return supported;
+    }
+
+    default:
+        return false;
+    }
+}
+
+/*
+  Returns the key to match the row \a rec on, made of the values of the
+  fields \a names. The values are compared as strings, as the driver may
+  return another type than the one bound.
+*/
+static QString returnedRowKey(const QSqlRecord &rec, const QStringList &names)
+{
+    QString key;
+    for (auto &name : names) {
+        const QVariant val = rec.value(name);
+        key += (val.isNull() ? QString(QChar(0)) : val.toString());
+        key += QChar(0x1f);  // unit separator
+    }
+    return key;
+}
+
+/*
+  Updates the \a objects of a chunk with the rows \a query returned.
+  The order of the rows returned by RETURNING is not guaranteed, so a
+  row is matched by its primary key if it was inserted, or else by the
+  values of the inserted \a columns; objects with the same values are
+  interchangeable. A row that matches no object is assigned to the
+  first one not updated yet.
+*/
+static void setReturnedRows(const QVector<TSqlObject *> &objects, TSqlQuery &query, const QVector<int> &columns, int pkidx)
+{
+    const QSqlRecord &first = *objects.first();
+    QStringList names;
+    if (pkidx >= 0 && columns.contains(pkidx)) {
+        names << first.fieldName(pkidx);
+    } else {
+        for (int c : columns) {
+            names << first.fieldName(c);
+        }
+    }
+
+    // Built once per chunk
+    QMultiHash<QString, int> index;
+    index.reserve(objects.count());
+    for (int k = 0; k < objects.count(); ++k) {
+        index.insert(returnedRowKey(*objects[k], names), k);
+    }
+
+    QVector<bool> updated(objects.count(), false);
+    int remaining = objects.count();
+    int next = 0;  // first object possibly not updated
+    int unmatched = 0;
+
+    while (remaining > 0 && query.next()) {
+        const QSqlRecord returned = query.record();
+        const QString key = returnedRowKey(returned, names);
+        int k = -1;
+        auto it = index.find(key);
+        while (it != index.end() && it.key() == key) {
+            int j = it.value();
+            it = index.erase(it);
+            if (!updated[j]) {
+                k = j;
+                break;
+            }
+        }
+
+        if (k < 0) {
+            while (updated[next]) {
+                ++next;
+            }
+            k = next;
+            ++unmatched;
+        }
+
+        objects[k]->setRecord(returned, QSqlError());
+        updated[k] = true;
+        --remaining;
+    }
+
+    if (unmatched > 0) {
+        tSystemWarn("%d returned rows matched no inserted object; assigned in order", unmatched);
+    }
+}
+
+/*!
+  Inserts the records of \a objects, which must be of the same class,
+  with multi-row INSERT statements. If \a upsert is true, rows whose
+  primary key already exists are updated instead. The rows are sent in
+  chunks within the bind value limit of the driver. On PostgreSQL and
+  SQLite 3.35 or later the objects are updated with the inserted rows,
+  including generated keys.
+  Returns the number of rows affected, or -1 if an error occurred.
+  This function is for internal use only; see TSqlORMapper::insertAll().
+*/
+int TSqlObject::insertAll(const QList<TSqlObject *> &objects, bool upsert)
+{
+    if (objects.isEmpty()) {
+        return 0;
+    }
+
+    TSqlObject *first = objects.first();
+    QSqlDatabase &database = Tf::currentSqlDatabase(first->databaseId());
+    const QSqlDriver *driver = database.driver();
+    const auto dbms = driver->dbmsType();
+    const int pkidx = first->primaryKeyIndex();
+
+    if (upsert && (pkidx < 0 || (dbms != QSqlDriver::PostgreSQL && dbms != QSqlDriver::MySqlServer && dbms != QSqlDriver::SQLite))) {
+        QString msg = QLatin1String("Upsert not supported for table ") + first->tableName();
+        first->sqlError = QSqlError(msg, QString(), QSqlError::StatementError);
+        tError("%s", qPrintable(msg));
+        return -1;
+    }
+
+    // Value proposed for insertion, referred to in the update clause
+    auto excluded = [dbms](const QString &name) -> QString {
+        switch (dbms) {
+        case QSqlDriver::PostgreSQL:
+            return QLatin1String("EXCLUDED.") + name;
+        case QSqlDriver::SQLite:
+            return QLatin1String("excluded.") + name;
+        default:
+            return QLatin1String("VALUES(") + name + QLatin1Char(')');
+        }
+    };
+
+    // Columns to insert; the primary key is needed to detect conflicts
+    first->syncToSqlRecord();
+    const QSqlRecord record = *first;
+    QList<int> *list = first->omitColumns();
+    QVector<int> columns;
+    QString names, updates;
+
+    for (int i = 0; i < record.count(); ++i) {
+        if (list->contains(i) && !(upsert && i == pkidx)) {
+            continue;
+        }
+        columns << i;
+
+        const QString name = TSqlQuery::escapeIdentifier(record.fieldName(i), QSqlDriver::FieldName, driver);
+        names.append(name).append(QLatin1Char(','));
+
+        QByteArray prop = record.fieldName(i).toLatin1().toLower();
+        if (i == pkidx || prop == CreatedAt || prop == LockRevision) {
+            continue;
+        }
+        updates.append(name).append(QLatin1Char('=')).append(excluded(name)).append(QLatin1Char(','));
+    }
+
+    if (Q_UNLIKELY(columns.isEmpty())) {
+        first->sqlError = QSqlError(QLatin1String("No fields to insert"), QString(), QSqlError::StatementError);
+        tWarn("SQL statement error, no fields to insert");
+        return -1;
+    }
+    names.chop(1);
+
+    if (upsert && updates.isEmpty()) {
+        // Updates the key with itself so that the row is still returned
+        const QString pk = TSqlQuery::escapeIdentifier(record.fieldName(pkidx), QSqlDriver::FieldName, driver);
+        updates.append(pk).append(QLatin1Char('=')).append(excluded(pk)).append(QLatin1Char(','));
+    }
+
+    int revidx = record.indexOf(QLatin1String(LockRevision));
+    if (upsert && revidx >= 0) {
+        const QString rev = TSqlQuery::escapeIdentifier(record.fieldName(revidx), QSqlDriver::FieldName, driver);
+        updates.append(rev).append(QLatin1String("=1+"));
+        if (dbms == QSqlDriver::PostgreSQL) {
+            updates.append(QLatin1String("t0."));
+        }
+        updates.append(rev).append(QLatin1Char(','));
+    }
+    updates.chop(1);
+
+    const bool returning = supportsReturning(database);
+    QString head = QLatin1String("INSERT INTO ") + TSqlQuery::escapeIdentifier(first->tableName(), QSqlDriver::TableName, driver);
+    if (dbms == QSqlDriver::PostgreSQL) {
+        head += QLatin1String(" AS t0");
+    }
+    head += QLatin1String(" (") + names + QLatin1String(") VALUES ");
+
+    QString tail;
+    if (upsert) {
+        if (dbms == QSqlDriver::MySqlServer) {
+            tail = QLatin1String(" ON DUPLICATE KEY UPDATE ") + updates;
+        } else {
+            tail = QLatin1String(" ON CONFLICT (") + TSqlQuery::escapeIdentifier(record.fieldName(pkidx), QSqlDriver::FieldName, driver) + QLatin1String(") DO UPDATE SET ") + updates;
+        }
+    }
+    if (returning) {
+        tail += QLatin1String(" RETURNING *");
+    }
+
+    // Bind value limit per statement
+    const int maxBindValues = (dbms == QSqlDriver::PostgreSQL || dbms == QSqlDriver::MySqlServer) ? 65535 : 999;
+    const int chunkSize = qMax(1, maxBindValues / columns.count());
+
+    QString row = QLatin1String("(?");
+    for (int c = 1; c < columns.count(); ++c) {
+        row += QLatin1String(",?");
+    }
+    row += QLatin1Char(')');
+
+    int total = 0;
+    for (int start = 0; start < objects.count(); start += chunkSize) {
+        const int count = qMin(chunkSize, objects.count() - start);
+
+        // Full chunks share the statement, which is prepared once
+        QString sql;
+        sql.reserve(head.length() + (row.length() + 1) * count + tail.length());
+        sql += head;
+        for (int j = 0; j < count; ++j) {
+            if (j > 0) {
+                sql += QLatin1Char(',');
+            }
+            sql += row;
+        }
+        sql += tail;
+
+        TSqlQuery query(database);
+        query.setStatementCacheEnabled(true);
+        query.prepare(sql);
+        for (int j = start; j < start + count; ++j) {
+            TSqlObject *obj = objects[j];
+            if (obj != first) {
+                obj->syncToSqlRecord();
+            }
+            for (int c : columns) {
+                query.addBind(obj->QSqlRecord::value(c));
+            }
+        }
+
+        if (!query.exec()) {
+            first->sqlError = query.lastError();
+            return -1;
+        }
+        total += query.numRowsAffected();
+
+        if (returning) {
+            setReturnedRows(objects.mid(start, count).toVector(), query, columns, pkidx);
+        }
+    }
+    return total;
+}
+
 /*!
   Deletes the record with this primary key from the database.
 */
@@ -337,6 +641,7 @@ bool TSqlObject::remove()
 
     del.append(QLatin1String(" WHERE "));
     int revIndex = -1;
+    QVariantList values;
 
     for (int i = metaObject()->propertyOffset(); i < metaObject()->propertyCount(); ++i) {
         const char *propName = metaObject()->property(i).name();
@@ -353,8 +658,8 @@ bool TSqlObject::remove()
             }
 
             del.append(QLatin1String(propName));
-            del.append(QLatin1Char('=')).append(TSqlQuery::formatValue(revision, QVariant::Uuid, database));
-            del.append(QLatin1String(" AND "));
+            del.append(QLatin1String("=? AND "));
+            values << QVariant(revision);
 
             revIndex = i;
             break;
@@ -370,10 +675,16 @@ bool TSqlObject::remove()
         return false;
     }
     del.append(QLatin1String(pkName));
-    del.append(QLatin1Char('=')).append(TSqlQuery::formatValue(value(pkName), metaProp.type(), database));
+    del.append(QLatin1String("=?"));
+    values << value(pkName);
 
     TSqlQuery query(database);
-    bool ret = query.exec(del);
+    query.setStatementCacheEnabled(true);
+    query.prepare(del);
+    for (auto &val : values) {
+        query.addBind(val);
+    }
+    bool ret = query.exec();
     sqlError = query.lastError();
     if (ret) {
         // Optimistic lock check
@@ -429,6 +740,17 @@ bool TSqlObject::isModified() const
 */
 void TSqlObject::syncToObject()
 {
+    const TModelField *fields = modelFields();
+    if (fields) {
+        for (int i = 0; fields->name; ++i, ++fields) {
+            int idx = fieldIndex(*this, i, fields->name);
+            if (idx >= 0) {
+                fields->set(this, QSqlRecord::value(idx));
+            }
+        }
+        return;
+    }
+
     int offset = metaObject()->propertyOffset();
     for (int i = 0; i < QSqlRecord::count(); ++i) {
         QString propertyName = field(i).name();
@@ -446,7 +768,21 @@ void TSqlObject::syncToObject()
 */
 void TSqlObject::syncToSqlRecord()
 {
-    QSqlRecord::operator=(Tf::currentSqlDatabase(databaseId()).record(tableName()));
+    QSqlRecord::operator=(TSqlSchemaCache::record(Tf::currentSqlDatabase(databaseId()), tableName()));
+
+    const TModelField *fields = modelFields();
+    if (fields) {
+        for (int i = 0; fields->name; ++i, ++fields) {
+            int idx = fieldIndex(*this, i, fields->name);
+            if (idx >= 0) {
+                QSqlRecord::setValue(idx, fields->get(this));
+            } else {
+                tWarn("invalid name: %s", fields->name);
+            }
+        }
+        return;
+    }
+
     const QMetaObject *metaObj = metaObject();
     for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
         const char *propName = metaObj->property(i).name();
@@ -33,6 +33,8 @@ public:
     void clear() override { QSqlRecord::clear(); }
     QSqlError error() const { return sqlError; }
 
+    static int insertAll(const QList<TSqlObject *> &objects, bool upsert = false);
+
 protected:
     void syncToSqlRecord();
     void syncToObject();
@@ -1,4 +1,5 @@
 #pragma once
+#include "tsqlschemacache.h"
 #include "tsystemglobal.h"
 #include <QList>
 #include <QMap>
@@ -9,6 +10,7 @@
 #include <TSqlJoin>
 #include <TSqlObject>
 #include <TSqlQuery>
+#include <functional>
 
 /*!
   \class TSqlORMapper
@@ -37,7 +39,7 @@ template <class T>
 class TSqlORMapper : public virtual TSqlORMapperBase
 {
 public:
-    TSqlORMapper();
+    TSqlORMapper(Tf::ReadPreference preference = Tf::ReadAuto);
     virtual ~TSqlORMapper();
 
     // Method chaining
@@ -54,6 +56,7 @@ public:
     void setSortOrder(const QString &column, Tf::SortOrder order = Tf::AscendingOrder);
     template <class C>
     void setJoin(int column, const TSqlJoin<C> &join);
+    void setReadPreference(Tf::ReadPreference preference);
     void reset();
 
     T findFirst(const TCriteria &cri = TCriteria());
@@ -62,7 +65,11 @@ public:
     int find(const TCriteria &cri = TCriteria());
     int findBy(int column, const QVariant &value);
     int findIn(int column, const QVariantList &values);
+    int findEach(const TCriteria &cri, const std::function<bool(const T &)> &callback);
     int rowCount() const;
+    using QSqlTableModel::record;
+    QSqlRecord record() const { return tableRecord; }
+    QString tableName() const { return staticTableName(); }
     T first() const;
     T last() const;
     T value(int i) const;
@@ -72,6 +79,8 @@ public:
     int updateAll(const TCriteria &cri, int column, const QVariant &value);
     int updateAll(const TCriteria &cri, const QMap<int, QVariant> &values);
     int removeAll(const TCriteria &cri = TCriteria());
+    int insertAll(QList<T> &objects);
+    int upsertAll(QList<T> &objects);
 
     class ConstIterator;
     inline ConstIterator begin() const { return ConstIterator(this, 0); }
@@ -125,8 +134,11 @@ public:
         friend class TSqlORMapper;
     };
 
+    bool select() override;
+
 protected:
     void setFilter(const QString &filter);
+    void setFilter(const QString &filter, const QVariantList &values);
     QString orderBy() const;
     virtual QString orderByClause() const { return QString(); }
     virtual void clear();
@@ -134,26 +146,44 @@ protected:
     virtual int rowCount(const QModelIndex &parent) const;
 
 private:
+    static const QString &staticTableName();
+    static int staticDatabaseId();
+
+    void bindFilterValues(TSqlQuery &query) const;
+    QSqlDatabase readDatabase() const;
+    void setSchema();
+
+    QSqlRecord tableRecord;  // from the schema cache
+    TSqlQuery selectQuery;  // holds the result of select()
     QString queryFilter;
+    QVariantList filterValues;  // bound to the placeholders of the filter
     QList<QPair<QString, Tf::SortOrder>> sortColumns;
     int queryLimit {0};
     int queryOffset {0};
     int joinCount {0};
     QStringList joinClauses;
     QStringList joinWhereClauses;
+    QVariantList joinWhereValues;
+    Tf::ReadPreference readPreference {Tf::ReadAuto};
 
     T_DISABLE_COPY(TSqlORMapper)
     T_DISABLE_MOVE(TSqlORMapper)
 };
 
 /*!
-  Constructor.
+  Constructor. The table schema is read on the connection routed by the
+  read \a preference, as SELECT statements are; each query chooses its
+  connection when executed. A mapper used only for updateAll() and
+  removeAll() can be constructed with Tf::ReadPrimary, so that it does
+  not check out a read replica.
 */
 template <class T>
-inline TSqlORMapper<T>::TSqlORMapper() :
-    QSqlTableModel(0, Tf::currentSqlDatabase(T().databaseId()))
+inline TSqlORMapper<T>::TSqlORMapper(Tf::ReadPreference preference) :
+    QSqlTableModel(0, Tf::currentReadSqlDatabase(staticDatabaseId(), preference)),
+    selectQuery(QSqlTableModel::database()),
+    readPreference(preference)
 {
-    setTable(T().tableName());
+    setSchema();
 }
 
 /*!
@@ -173,7 +203,9 @@ inline T TSqlORMapper<T>::findFirst(const TCriteria &cri)
 {
     if (!cri.isEmpty()) {
         TCriteriaConverter<T> conv(cri, database(), QStringLiteral("t0"));
-        setFilter(conv.toString());
+        QVariantList values;
+        QString filter = conv.toString(values);
+        setFilter(filter, values);
     } else {
         setFilter(QString());
     }
@@ -181,7 +213,6 @@ inline T TSqlORMapper<T>::findFirst(const TCriteria &cri)
     int oldLimit = queryLimit;
     queryLimit = 1;
     bool ret = select();
-    Tf::writeQueryLog(query().lastQuery(), ret, lastError());
     queryLimit = oldLimit;
 
     //tSystemDebug("findFirst() rowCount: %d", rowCount());
@@ -207,7 +238,7 @@ inline T TSqlORMapper<T>::findByPrimaryKey(const QVariant &pk)
 {
     int idx = T().primaryKeyIndex();
     if (idx < 0) {
-        tSystemDebug("Primary key not found, table name: %s", qPrintable(T().tableName()));
+        tSystemDebug("Primary key not found, table name: %s", qPrintable(staticTableName()));
         return T();
     }
 
@@ -225,7 +256,9 @@ inline int TSqlORMapper<T>::find(const TCriteria &cri)
 {
     if (!cri.isEmpty()) {
         TCriteriaConverter<T> conv(cri, database(), QStringLiteral("t0"));
-        setFilter(conv.toString());
+        QVariantList values;
+        QString filter = conv.toString(values);
+        setFilter(filter, values);
     } else {
         setFilter(QString());
     }
@@ -234,7 +267,6 @@ inline int TSqlORMapper<T>::find(const TCriteria &cri)
     while (canFetchMore()) {  // For SQLite, not report back the size of a query
         fetchMore();
     }
-    Tf::writeQueryLog(query().lastQuery(), ret, lastError());
     //tSystemDebug("find() rowCount: %d", rowCount());
     return ret ? rowCount() : -1;
 }
@@ -263,6 +295,80 @@ inline int TSqlORMapper<T>::findIn(int column, const QVariantList &values)
     return find(TCriteria(column, TSql::In, values));
 }
 
+/*!
+  Retrieves with the criteria \a cri from the table and calls \a callback
+  with each ORM object in turn, until it returns false. Returns the number
+  of the ORM objects passed to \a callback, or -1 if an error occurred.
+  Unlike find(), the rows are read with a forward-only query and not kept
+  in the mapper, so that any number of rows can be processed with constant
+  memory. The object passed to \a callback is reused for the next row.
+*/
+template <class T>
+inline int TSqlORMapper<T>::findEach(const TCriteria &cri, const std::function<bool(const T &)> &callback)
+{
+    if (!cri.isEmpty()) {
+        TCriteriaConverter<T> conv(cri, database(), QStringLiteral("t0"));
+        QVariantList values;
+        QString filter = conv.toString(values);
+        setFilter(filter, values);
+    } else {
+        setFilter(QString());
+    }
+
+    TSqlQuery query(readDatabase());
+    query.setForwardOnly(true);
+    query.setStatementCacheEnabled(true);
+    query.prepare(selectStatement());
+    bindFilterValues(query);
+    if (!query.exec()) {
+        return -1;
+    }
+
+    T obj;
+    QSqlRecord &rec = obj;
+    rec = query.record();
+
+    // Resolves the fields or properties of the columns once
+    const TModelField *fields = obj.modelFields();
+    const QMetaObject *metaObj = obj.metaObject();
+    QVector<QPair<int, const TModelField *>> columnFields;
+    QVector<QPair<int, QMetaProperty>> columns;
+    for (int i = 0; i < rec.count(); ++i) {
+        const QByteArray name = rec.fieldName(i).toLatin1();
+        if (fields) {
+            for (const TModelField *f = fields; f->name; ++f) {
+                if (name == f->name) {
+                    columnFields << qMakePair(i, f);
+                    break;
+                }
+            }
+        } else {
+            int index = metaObj->indexOfProperty(name.constData());
+            if (index >= metaObj->propertyOffset()) {
+                columns << qMakePair(i, metaObj->property(index));
+            }
+        }
+    }
+
+    int cnt = 0;
+    while (query.next()) {
+        for (int i = 0; i < rec.count(); ++i) {
+            rec.setValue(i, query.value(i));
+        }
+        for (auto &col : (const QVector<QPair<int, const TModelField *>> &)columnFields) {
+            col.second->set(&obj, rec.value(col.first));
+        }
+        for (auto &col : (const QVector<QPair<int, QMetaProperty>> &)columns) {
+            col.second.write(&obj, rec.value(col.first));
+        }
+        ++cnt;
+        if (!callback(obj)) {
+            break;
+        }
+    }
+    return cnt;
+}
+
 /*!
   Returns the number of rows of the current query.
  */
@@ -421,6 +527,62 @@ template <class T>
 inline void TSqlORMapper<T>::setFilter(const QString &filter)
 {
     queryFilter = filter;
+    filterValues.clear();
+}
+
+/*!
+  Sets the current filter to \a filter with placeholders, to which the
+  \a values are bound when the query is executed.
+*/
+template <class T>
+inline void TSqlORMapper<T>::setFilter(const QString &filter, const QVariantList &values)
+{
+    queryFilter = filter;
+    filterValues = values;
+}
+
+/*!
+  Binds the values of the filter and the JOIN criteria to \a query,
+  which is prepared with selectStatement().
+*/
+template <class T>
+inline void TSqlORMapper<T>::bindFilterValues(TSqlQuery &query) const
+{
+    for (auto &val : filterValues) {
+        query.addBind(val);
+    }
+    for (auto &val : joinWhereValues) {
+        query.addBind(val);
+    }
+}
+
+/*!
+  Executes the SELECT statement generated from the specified parameters,
+  binding the values of the criteria, and populates the mapper with the
+  result. Returns true if successful.
+*/
+template <class T>
+inline bool TSqlORMapper<T>::select()
+{
+    const QString sql = selectStatement();
+    if (sql.isEmpty()) {
+        return false;
+    }
+
+    // Reads from the replica or the primary as of now
+    QSqlDatabase db = readDatabase();
+    if (selectQuery.driver() != db.driver()) {
+        selectQuery = TSqlQuery(db);
+    }
+
+    // The model shares the result only until selectQuery is prepared
+    // again or destroyed, when the statement goes back to the cache
+    selectQuery.setStatementCacheEnabled(true);
+    selectQuery.prepare(sql);
+    bindFilterValues(selectQuery);
+    bool ret = selectQuery.exec();
+    setQuery(selectQuery);
+    return ret && !lastError().isValid();
 }
 
 /*!
@@ -502,8 +664,10 @@ template <class T>
 inline int TSqlORMapper<T>::findCount(const TCriteria &cri)
 {
     if (!cri.isEmpty()) {
-        TCriteriaConverter<T> conv(cri, database(), "t0");
-        setFilter(conv.toString());
+        TCriteriaConverter<T> conv(cri, database(), QStringLiteral("t0"));
+        QVariantList values;
+        QString filter = conv.toString(values);
+        setFilter(filter, values);
     } else {
         setFilter(QString());
     }
@@ -515,8 +679,11 @@ inline int TSqlORMapper<T>::findCount(const TCriteria &cri)
     query += QLatin1String(") t");
 
     int cnt = -1;
-    TSqlQuery q(database());
-    bool res = q.exec(query);
+    TSqlQuery q(readDatabase());
+    q.setStatementCacheEnabled(true);
+    q.prepare(query);
+    bindFilterValues(q);
+    bool res = q.exec();
     if (res) {
         q.next();
         cnt = q.value(0).toInt();
@@ -549,9 +716,11 @@ int TSqlORMapper<T>::updateAll(const TCriteria &cri, const QMap<int, QVariant> &
     upd.reserve(256);
     upd.append(QLatin1String("UPDATE ")).append(tableName()).append(QLatin1String(" SET "));
 
-    QSqlDatabase db = database();
+    QSqlDatabase db = Tf::currentSqlDatabase(staticDatabaseId());  // primary
     TCriteriaConverter<T> conv(cri, db);
-    QString where = conv.toString();
+    QVariantList bindValues;  // of the SET clause, followed by the WHERE clause
+    QVariantList whereValues;
+    QString where = conv.toString(whereValues);
 
     if (values.isEmpty()) {
         tSystemError("Update Parameter Error");
@@ -564,9 +733,8 @@ int TSqlORMapper<T>::updateAll(const TCriteria &cri, const QMap<int, QVariant> &
         QByteArray prop = QByteArray(propName).toLower();
         if (prop == UpdatedAt || prop == ModifiedAt) {
             upd += propName;
-            upd += QLatin1Char('=');
-            upd += TSqlQuery::formatValue(QDateTime::currentDateTime(), QVariant::DateTime, db);
-            upd += QLatin1Char(',');
+            upd += QLatin1String("=?,");
+            bindValues << QDateTime::currentDateTime();
             break;
         }
     }
@@ -574,8 +742,8 @@ int TSqlORMapper<T>::updateAll(const TCriteria &cri, const QMap<int, QVariant> &
     auto it = values.begin();
     while (true) {
         upd += conv.propertyName(it.key(), db.driver());
-        upd += QLatin1Char('=');
-        upd += TSqlQuery::formatValue(it.value(), conv.variantType(it.key()), db);
+        upd += QLatin1String("=?");
+        bindValues << it.value();
 
         if (++it == values.end()) {
             break;
@@ -585,10 +753,16 @@ int TSqlORMapper<T>::updateAll(const TCriteria &cri, const QMap<int, QVariant> &
 
     if (!where.isEmpty()) {
         upd.append(QLatin1String(" WHERE ")).append(where);
+        bindValues += whereValues;
     }
 
     TSqlQuery sqlQuery(db);
-    bool res = sqlQuery.exec(upd);
+    sqlQuery.setStatementCacheEnabled(true);
+    sqlQuery.prepare(upd);
+    for (auto &val : bindValues) {
+        sqlQuery.addBind(val);
+    }
+    bool res = sqlQuery.exec();
     return res ? sqlQuery.numRowsAffected() : -1;
 }
 
@@ -611,11 +785,12 @@ inline int TSqlORMapper<T>::updateAll(const TCriteria &cri, int column, const QV
 template <class T>
 inline int TSqlORMapper<T>::removeAll(const TCriteria &cri)
 {
-    QSqlDatabase db = database();
+    QSqlDatabase db = Tf::currentSqlDatabase(staticDatabaseId());  // primary
     QString del = db.driver()->sqlStatement(QSqlDriver::DeleteStatement,
-        T().tableName(), QSqlRecord(), false);
+        staticTableName(), QSqlRecord(), false);
     TCriteriaConverter<T> conv(cri, db);
-    QString where = conv.toString();
+    QVariantList whereValues;
+    QString where = conv.toString(whereValues);
 
     if (del.isEmpty()) {
         tSystemError("Statement Error");
@@ -626,10 +801,49 @@ inline int TSqlORMapper<T>::removeAll(const TCriteria &cri)
     }
 
     TSqlQuery sqlQuery(db);
-    bool res = sqlQuery.exec(del);
+    sqlQuery.setStatementCacheEnabled(true);
+    sqlQuery.prepare(del);
+    for (auto &val : whereValues) {
+        sqlQuery.addBind(val);
+    }
+    bool res = sqlQuery.exec();
     return res ? sqlQuery.numRowsAffected() : -1;
 }
 
+/*!
+  Inserts the ORM objects \a objects into the table with multi-row INSERT
+  statements and returns the number of the rows affected, or -1 if an
+  error occurred. Where the driver returns the inserted rows (PostgreSQL),
+  \a objects are updated with them, including generated keys.
+*/
+template <class T>
+inline int TSqlORMapper<T>::insertAll(QList<T> &objects)
+{
+    QList<TSqlObject *> list;
+    list.reserve(objects.count());
+    for (auto &obj : objects) {
+        list << &obj;
+    }
+    return TSqlObject::insertAll(list, false);
+}
+
+/*!
+  Inserts the ORM objects \a objects into the table, or updates the rows
+  with the same primary keys, with multi-row INSERT ... ON CONFLICT (or
+  ON DUPLICATE KEY UPDATE) statements. Returns the number of the rows
+  affected, or -1 if an error occurred or the driver does not support it.
+*/
+template <class T>
+inline int TSqlORMapper<T>::upsertAll(QList<T> &objects)
+{
+    QList<TSqlObject *> list;
+    list.reserve(objects.count());
+    for (auto &obj : objects) {
+        list << &obj;
+    }
+    return TSqlObject::insertAll(list, true);
+}
+
 /*!
   Sets a JOIN clause for \a column to \a join.
  */
@@ -675,7 +889,7 @@ inline void TSqlORMapper<T>::setJoin(int column, const TSqlJoin<C> &join)
 
     if (!join.criteria().isEmpty()) {
         TCriteriaConverter<C> conv(join.criteria(), db, alias);
-        joinWhereClauses << conv.toString();
+        joinWhereClauses << conv.toString(joinWhereValues);
     }
 }
 
@@ -687,13 +901,57 @@ inline TSqlORMapper<T> &TSqlORMapper<T>::join(int column, const TSqlJoin<C> &j)
     return *this;
 }
 
+/*!
+  Sets the preference of the database for reading to \a preference.
+  By default, the reads go to a read replica if configured, until the
+  primary is used in the request. Tf::ReadPrimary is for the reads that
+  must see the latest data; Tf::ReadReplica is for those that tolerate
+  the replication lag even after a write.
+*/
+template <class T>
+inline void TSqlORMapper<T>::setReadPreference(Tf::ReadPreference preference)
+{
+    readPreference = preference;
+}
+
+/*!
+  Returns the connection to execute SELECT statements on, as routed by
+  the read preference.
+*/
+template <class T>
+inline QSqlDatabase TSqlORMapper<T>::readDatabase() const
+{
+    return Tf::currentReadSqlDatabase(staticDatabaseId(), readPreference);
+}
+
 /*!
   Reset the internal state of the mapper object.
 */
 template <class T>
 inline void TSqlORMapper<T>::reset()
 {
-    setTable(tableName());
+    clear();
+    setSchema();
+}
+
+/*!
+  Takes the columns and the primary key of the table from the schema
+  cache instead of setTable(), which queries the database catalog every
+  time. The tableName() and record() of the QSqlTableModel base class
+  are left empty then; call them on the mapper. Falls back to setTable()
+  if the schema is not available, so that lastError() reports it.
+*/
+template <class T>
+inline void TSqlORMapper<T>::setSchema()
+{
+    TSqlTableSchema schema = TSqlSchemaCache::schema(database(), staticTableName());
+    if (Q_LIKELY(schema.isValid())) {
+        tableRecord = schema.record;
+        setPrimaryKey(schema.primaryIndex);
+    } else {
+        setTable(staticTableName());
+        tableRecord = QSqlTableModel::record();
+    }
 }
 
 /*!
@@ -710,6 +968,8 @@ inline void TSqlORMapper<T>::clear()
     joinCount = 0;
     joinClauses.clear();
     joinWhereClauses.clear();
+    joinWhereValues.clear();
+    filterValues.clear();
 
     // Don't call the setTable() here,
     // or it causes a segmentation fault.
@@ -736,3 +996,23 @@ inline QString TSqlORMapper<T>::orderBy() const
     return str;
 }
 
+/*!
+  Returns the table name of the ORM object class, which is the same
+  for every object of the class.
+*/
+template <class T>
+inline const QString &TSqlORMapper<T>::staticTableName()
+{
+    static const QString name = T().tableName();
+    return name;
+}
+
+/*!
+  Returns the database ID of the ORM object class.
+*/
+template <class T>
+inline int TSqlORMapper<T>::staticDatabaseId()
+{
+    static const int id = T().databaseId();
+    return id;
+}
@@ -5,6 +5,7 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include "tsqlstatementcache.h"
 #include "tsystemglobal.h"
 #include <QMap>
 #include <QMutex>
@@ -29,16 +30,48 @@ QMutex cacheMutex;
   Constructs a TSqlQuery object using the database \a databaseId.
 */
 TSqlQuery::TSqlQuery(int databaseId) :
-    QSqlQuery(QString(), Tf::currentSqlDatabase(databaseId))
+    TSqlQuery(Tf::currentSqlDatabase(databaseId))
 {
 }
 
 
 TSqlQuery::TSqlQuery(QSqlDatabase db) :
-    QSqlQuery(db)
+    QSqlQuery(db),
+    _connectionName(db.connectionName())
 {
 }
 
+/*!
+  Copy constructor. The copy shares the result with \a other, so neither
+  of them puts the statement back into the statement cache.
+*/
+TSqlQuery::TSqlQuery(const TSqlQuery &other) :
+    QSqlQuery(other),
+    _connectionName(other._connectionName)
+{
+    other._statement.clear();
+}
+
+/*!
+  Destructor. Puts the prepared statement back into the statement cache.
+*/
+TSqlQuery::~TSqlQuery()
+{
+    releaseStatement();
+}
+
+
+TSqlQuery &TSqlQuery::operator=(const TSqlQuery &other)
+{
+    if (this != &other) {
+        releaseStatement();
+        QSqlQuery::operator=(other);
+        _connectionName = other._connectionName;
+        other._statement.clear();  // shared
+    }
+    return *this;
+}
+
 
 /*!
   Loads a query from the given file \a filename.
@@ -49,7 +82,7 @@ bool TSqlQuery::load(const QString &filename)
 
     QString query = queryCache.value(filename);
     if (!query.isEmpty()) {
-        return QSqlQuery::prepare(query);
+        return prepareStatement(query);
     }
 
     QDir dir(queryDirPath());
@@ -63,7 +96,7 @@ bool TSqlQuery::load(const QString &filename)
     }
 
     query = QObject::tr(file.readAll().constData());
-    bool res = QSqlQuery::prepare(query);
+    bool res = prepareStatement(query);
     if (res) {
         // Caches the query-string
         queryCache.insert(filename, query);
@@ -152,19 +185,80 @@ QString TSqlQuery::formatValue(const QVariant &val, const QSqlDatabase &database
 */
 TSqlQuery &TSqlQuery::prepare(const QString &query)
 {
-    bool ret = QSqlQuery::prepare(query);
+    bool ret = prepareStatement(query);
     if (!ret) {
         Tf::writeQueryLog(QLatin1String("(Query prepare) ") + query, ret, lastError());
     }
     return *this;
 }
 
+/*!
+  \fn bool TSqlQuery::isStatementCacheEnabled() const
+  Returns true if the query reuses prepared statements of the statement
+  cache; otherwise returns false. The default is false, while
+  TSqlQueryORMapper and the queries TSqlORMapper and TSqlObject run
+  internally enable it.
+*/
+
+/*!
+  \fn void TSqlQuery::setStatementCacheEnabled(bool enable)
+  Enables the statement cache for this query if \a enable is true.
+  prepare() then takes the statement prepared before on the same
+  connection out of the cache, and the statement goes back into it when
+  the query is destroyed or prepared again.
+  Enable it only for a query whose result is not shared: copying it into
+  a QSqlQuery, e.g. with QSqlQueryModel::setQuery(), cannot be detected,
+  and the copy would read a statement finished and handed to another
+  query. Copies made as TSqlQuery are detected and not cached.
+*/
+
+/*!
+  Prepares the SQL \a query, reusing the statement prepared before on
+  the same connection if the statement cache is enabled and has it.
+*/
+bool TSqlQuery::prepareStatement(const QString &query)
+{
+    releaseStatement();
+    if (!_statementCacheEnabled || _connectionName.isEmpty()) {
+        return QSqlQuery::prepare(query);
+    }
+
+    QSqlQuery cached;
+    if (TSqlStatementCache::take(_connectionName, query, cached, _generation)) {
+        bool forwardOnly = isForwardOnly();
+        auto precisionPolicy = numericalPrecisionPolicy();
+        QSqlQuery::operator=(cached);
+        setForwardOnly(forwardOnly);
+        setNumericalPrecisionPolicy(precisionPolicy);
+        _statement = query;
+        return true;
+    }
+
+    bool ret = QSqlQuery::prepare(query);  // detaches from a released statement
+    if (ret) {
+        _statement = query;
+    }
+    return ret;
+}
+
+/*!
+  Puts the prepared statement back into the statement cache.
+*/
+void TSqlQuery::releaseStatement()
+{
+    if (!_statement.isEmpty()) {
+        TSqlStatementCache::put(_connectionName, _statement, *this, _generation);
+        _statement.clear();
+    }
+}
+
 /*!
   Executes the SQL in \a query. Returns true and sets the query state to
   active if the query was successful; otherwise returns false.
 */
 bool TSqlQuery::exec(const QString &query)
 {
+    releaseStatement();
     bool ret = QSqlQuery::exec(query);
     Tf::writeQueryLog(query, ret, lastError());
     return ret;
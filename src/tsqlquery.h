@@ -7,8 +7,13 @@ class T_CORE_EXPORT TSqlQuery : public QSqlQuery {
 public:
     TSqlQuery(int databaseId = 0);
     TSqlQuery(QSqlDatabase db);
+    TSqlQuery(const TSqlQuery &other);
+    ~TSqlQuery();
+    TSqlQuery &operator=(const TSqlQuery &other);
 
     TSqlQuery &prepare(const QString &query);
+    bool isStatementCacheEnabled() const { return _statementCacheEnabled; }
+    void setStatementCacheEnabled(bool enable) { _statementCacheEnabled = enable; }
     bool load(const QString &filename);
     TSqlQuery &bind(const QString &placeholder, const QVariant &val);
     TSqlQuery &bind(int pos, const QVariant &val);
@@ -29,6 +34,15 @@ public:
     static QString formatValue(const QVariant &val, QVariant::Type type = QVariant::Invalid, int databaseId = 0);
     static QString formatValue(const QVariant &val, QVariant::Type type, const QSqlDatabase &database);
     static QString formatValue(const QVariant &val, const QSqlDatabase &database);
+
+private:
+    bool prepareStatement(const QString &query);
+    void releaseStatement();
+
+    QString _connectionName;
+    bool _statementCacheEnabled {false};
+    mutable QString _statement;  // prepared statement taken from the statement cache
+    quint64 _generation {0};
 };
 
 
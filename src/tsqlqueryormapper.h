@@ -17,7 +17,7 @@
 template <class T>
 class TSqlQueryORMapper : public TSqlQuery {
 public:
-    TSqlQueryORMapper(int databaseId = 0);
+    TSqlQueryORMapper(int databaseId = 0, Tf::ReadPreference preference = Tf::ReadPrimary);
 
     TSqlQueryORMapper<T> &prepare(const QString &query);
     bool load(const QString &filename);
@@ -78,10 +78,17 @@ public:
 };
 
 
+/*!
+  Constructor. The statements are executed on the primary of the database
+  \a databaseId, or on a read replica if \a preference allows; pass
+  Tf::ReadAuto or Tf::ReadReplica only for SELECT statements.
+  The prepared statements are reused through the statement cache.
+*/
 template <class T>
-inline TSqlQueryORMapper<T>::TSqlQueryORMapper(int databaseId) :
-    TSqlQuery(databaseId)
+inline TSqlQueryORMapper<T>::TSqlQueryORMapper(int databaseId, Tf::ReadPreference preference) :
+    TSqlQuery(Tf::currentReadSqlDatabase(databaseId, preference))
 {
+    setStatementCacheEnabled(true);
 }
 
 
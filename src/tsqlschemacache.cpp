@@ -0,0 +1,94 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tsqlschemacache.h"
+#include "tsqldatabasepool.h"
+#include "tsystemglobal.h"
+
+/*!
+  \class TSqlSchemaCache
+  \brief The TSqlSchemaCache class keeps the columns and the primary key
+  of each table, so that the driver is asked for them only once per
+  process instead of once per ORM mapper or object.
+
+  The connections of a database share the entries. Call invalidate()
+  when the schema of a table changes while the application is running.
+*/
+
+QReadWriteLock TSqlSchemaCache::lock;
+QHash<TSqlSchemaCache::Key, TSqlTableSchema> TSqlSchemaCache::schemas;
+
+/*!
+  Returns the schema of the table \a tableName in the database of the
+  connection \a database. The driver is queried on the first call only.
+ */
+TSqlTableSchema TSqlSchemaCache::schema(const QSqlDatabase &database, const QString &tableName)
+{
+    const Key key(TSqlDatabasePool::getDatabaseId(database), tableName);
+    {
+        QReadLocker locker(&lock);
+        auto it = schemas.constFind(key);
+        if (Q_LIKELY(it != schemas.constEnd())) {
+            return it.value();
+        }
+    }
+
+    // Queries the catalog outside of the lock
+    TSqlTableSchema schema;
+    schema.record = database.record(tableName);
+    schema.primaryIndex = database.primaryIndex(tableName);
+
+    if (Q_UNLIKELY(!schema.isValid())) {
+        // Not cached; the table may be created later
+        tSystemWarn("Unable to get the schema of table: %s", qPrintable(tableName));
+        return schema;
+    }
+
+    QWriteLocker locker(&lock);
+    schemas.insert(key, schema);
+    tSystemDebug("Schema cached: %s (%d columns)", qPrintable(tableName), schema.record.count());
+    return schema;
+}
+
+/*!
+  Returns the record of the table \a tableName, which holds the fields
+  of the columns without values.
+ */
+QSqlRecord TSqlSchemaCache::record(const QSqlDatabase &database, const QString &tableName)
+{
+    return schema(database, tableName).record;
+}
+
+/*!
+  Discards the schema of the table \a tableName in the database
+  \a databaseId, or of all the tables in it if \a tableName is empty.
+ */
+void TSqlSchemaCache::invalidate(int databaseId, const QString &tableName)
+{
+    QWriteLocker locker(&lock);
+    if (!tableName.isEmpty()) {
+        schemas.remove(Key(databaseId, tableName));
+        return;
+    }
+
+    for (auto it = schemas.begin(); it != schemas.end();) {
+        if (it.key().first == databaseId) {
+            it = schemas.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/*!
+  Discards all the schemas.
+ */
+void TSqlSchemaCache::clear()
+{
+    QWriteLocker locker(&lock);
+    schemas.clear();
+}
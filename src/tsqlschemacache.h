@@ -0,0 +1,35 @@
+#pragma once
+#include <QHash>
+#include <QPair>
+#include <QReadWriteLock>
+#include <QSqlDatabase>
+#include <QSqlIndex>
+#include <QSqlRecord>
+#include <QString>
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TSqlTableSchema {
+public:
+    QSqlRecord record;  // columns and their types
+    QSqlIndex primaryIndex;
+
+    bool isValid() const { return !record.isEmpty(); }
+};
+
+
+class T_CORE_EXPORT TSqlSchemaCache {
+public:
+    static TSqlTableSchema schema(const QSqlDatabase &database, const QString &tableName);
+    static QSqlRecord record(const QSqlDatabase &database, const QString &tableName);
+    static void invalidate(int databaseId, const QString &tableName = QString());
+    static void clear();
+
+private:
+    using Key = QPair<int, QString>;  // database ID and table name
+
+    static QReadWriteLock lock;
+    static QHash<Key, TSqlTableSchema> schemas;
+
+    TSqlSchemaCache() = delete;
+};
@@ -0,0 +1,106 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tsqlstatementcache.h"
+#include "tsettingssnapshot.h"
+#include "tsqldatabasepool.h"
+#include <QMutexLocker>
+
+/*!
+  \class TSqlStatementCache
+  \brief The TSqlStatementCache class keeps prepared statements of each
+  pooled connection in LRU order, keyed by the SQL text.
+
+  A statement is taken out of the cache while it is used, so no two
+  queries share it, and put back when the query is done with it.
+  The statements of a connection are invalidated before the pool closes
+  the connection; statements put back afterwards are discarded by
+  comparing the generation.
+*/
+
+namespace {
+QMutex mutex;
+}
+
+
+TSqlStatementCache::Statements &TSqlStatementCache::statements(const QString &connectionName)
+{
+    static QHash<QString, Statements> connections;
+
+    auto it = connections.find(connectionName);
+    if (it == connections.end()) {
+        it = connections.insert(connectionName, Statements());
+        int databaseId = TSqlDatabasePool::getDatabaseId(connectionName);
+        it->capacity = TSettingsSnapshot::current().sqlDatabase(databaseId).statementCacheSize;
+    }
+    return it.value();
+}
+
+/*!
+  Takes the prepared statement of the SQL \a statement for the connection
+  \a connectionName out of the cache into \a query. Returns false if not
+  cached. \a generation is set to the current generation of the connection.
+ */
+bool TSqlStatementCache::take(const QString &connectionName, const QString &statement, QSqlQuery &query, quint64 &generation)
+{
+    QMutexLocker locker(&mutex);
+    auto &stmts = statements(connectionName);
+    generation = stmts.generation;
+
+    auto it = stmts.index.find(statement);
+    if (it == stmts.index.end()) {
+        return false;
+    }
+
+    query = it.value()->second;
+    stmts.lru.erase(it.value());
+    stmts.index.erase(it);
+    return true;
+}
+
+/*!
+  Puts the prepared statement \a query of the SQL \a statement back into
+  the cache, evicting the least recently used one if the cache is full.
+  The statement is discarded if the connection has been invalidated since
+  \a generation.
+ */
+void TSqlStatementCache::put(const QString &connectionName, const QString &statement, QSqlQuery &query, quint64 generation)
+{
+    query.finish();  // releases the result set; the statement stays prepared
+
+    std::list<std::pair<QString, QSqlQuery>> evicted;  // destroyed after unlocking
+    QMutexLocker locker(&mutex);
+    auto &stmts = statements(connectionName);
+    if (generation != stmts.generation || stmts.capacity <= 0 || stmts.index.contains(statement)) {
+        return;
+    }
+
+    stmts.lru.emplace_front(statement, query);
+    stmts.index.insert(statement, stmts.lru.begin());
+
+    if ((int)stmts.lru.size() > stmts.capacity) {
+        stmts.index.remove(stmts.lru.back().first);
+        evicted.splice(evicted.begin(), stmts.lru, std::prev(stmts.lru.end()));
+    }
+}
+
+/*!
+  Discards all the statements of the connection \a connectionName.
+  Must be called before the connection is closed or reopened.
+ */
+void TSqlStatementCache::invalidate(const QString &connectionName)
+{
+    std::list<std::pair<QString, QSqlQuery>> discarded;
+    {
+        QMutexLocker locker(&mutex);
+        auto &stmts = statements(connectionName);
+        stmts.generation++;
+        stmts.index.clear();
+        discarded.swap(stmts.lru);
+    }
+    // Deallocates the statements outside of the lock
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <QHash>
+#include <QMutex>
+#include <QSqlQuery>
+#include <QString>
+#include <TGlobal>
+#include <list>
+
+
+class T_CORE_EXPORT TSqlStatementCache {
+public:
+    static bool take(const QString &connectionName, const QString &statement, QSqlQuery &query, quint64 &generation);
+    static void put(const QString &connectionName, const QString &statement, QSqlQuery &query, quint64 generation);
+    static void invalidate(const QString &connectionName);
+
+private:
+    struct Statements {
+        quint64 generation {1};
+        int capacity {0};
+        std::list<std::pair<QString, QSqlQuery>> lru;  // most recently used first
+        QHash<QString, std::list<std::pair<QString, QSqlQuery>>::iterator> index;
+    };
+
+    static Statements &statements(const QString &connectionName);
+
+    TSqlStatementCache() = delete;
+};
@@ -34,8 +34,7 @@ TSqlTransaction::~TSqlTransaction()
 
 bool TSqlTransaction::begin()
 {
-    pid_t tid = gettid();
-    tSystemDebug("TSqlTransaction::begin tid: %d connectionName: %s", tid, tdatabase().sqlDatabase().connectionName().toStdString().c_str());
+    tSystemDebug("TSqlTransaction::begin tid: %d connectionName: %s", (int)gettid(), qPrintable(tdatabase().sqlDatabase().connectionName()));
 
     TSqlDatabase::setInuse(tdatabase().sqlDatabase().connectionName());
 
@@ -126,7 +125,7 @@ bool TSqlTransaction::rollback()
 
 void TSqlTransaction::setCommonName(const QString &commonName)
 {
-    tSystemDebug("TSqlTransaction::setCommonName: %s", commonName.toStdString().c_str());
+    tSystemDebug("TSqlTransaction::setCommonName: %s", qPrintable(commonName));
     _commonName = commonName;
 }
 
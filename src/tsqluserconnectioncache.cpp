@@ -0,0 +1,177 @@
+/* Copyright (c) 2019, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include "tsqluserconnectioncache.h"
+#include "tclock.h"
+#include "tsqldatabase.h"
+#include "tsqlstatementcache.h"
+#include "tsystemglobal.h"
+#include <QMutexLocker>
+
+constexpr int MIN_ENTRIES_PER_SHARD = 8;
+constexpr int MAX_SHARD_COUNT = 16;
+
+/*!
+  \class TSqlUserConnectionCache
+  \brief The TSqlUserConnectionCache class keeps the connections of
+  certificate-authenticated users of a database in LRU order, so that
+  a returning user does not pay for a new handshake.
+
+  Connections are spread over shards, each with its own lock and LRU list.
+  A connection is pinned from checkout() until release(), so that it is
+  never evicted while in use, even before the caller has taken it; a shard
+  may exceed its capacity while all of its connections are pinned.
+*/
+
+TSqlUserConnectionCache::TSqlUserConnectionCache(int capacity) :
+    _capacity(qMax(capacity, 1))
+{
+    _shardCount = qBound(1, _capacity / MIN_ENTRIES_PER_SHARD, MAX_SHARD_COUNT);
+    _shardCapacity = (_capacity + _shardCount - 1) / _shardCount;
+    _shards = new Shard[_shardCount];
+}
+
+
+TSqlUserConnectionCache::~TSqlUserConnectionCache()
+{
+    clear();
+    delete[] _shards;
+}
+
+/*!
+  Marks the connection \a connectionName as most recently used and pins
+  it until release() is called. If it is not cached, calls \a create to
+  add the connection and caches it, evicting the least recently used idle
+  connections of the shard as needed. Returns false if \a create fails,
+  in which case nothing is pinned.
+ */
+bool TSqlUserConnectionCache::checkout(const QString &connectionName, const std::function<bool()> &create)
+{
+    auto &sh = shard(connectionName);
+    QMutexLocker locker(&sh.mutex);
+
+    auto it = sh.index.constFind(connectionName);
+    if (it != sh.index.constEnd()) {
+        sh.lru.splice(sh.lru.begin(), sh.lru, it.value());
+        sh.lru.front().lastUsed = TClock::monotonicSecs();
+        sh.lru.front().pins++;
+        _hits++;
+        return true;
+    }
+
+    _misses++;
+    if (!create()) {
+        return false;
+    }
+
+    sh.lru.push_front(Entry {connectionName, TClock::monotonicSecs(), 1});
+    sh.index.insert(connectionName, sh.lru.begin());
+
+    // Evicts idle connections from the tail
+    auto lit = std::prev(sh.lru.end());
+    while ((int)sh.lru.size() > _shardCapacity && lit != sh.lru.begin()) {
+        auto cur = lit--;
+        if (isEvictable(*cur)) {
+            evict(sh, cur);
+            _evictions++;
+        }
+    }
+    return true;
+}
+
+/*!
+  Unpins the connection \a connectionName checked out, and restarts its
+  idle time.
+ */
+void TSqlUserConnectionCache::release(const QString &connectionName)
+{
+    auto &sh = shard(connectionName);
+    QMutexLocker locker(&sh.mutex);
+
+    auto it = sh.index.constFind(connectionName);
+    if (it != sh.index.constEnd()) {
+        it.value()->lastUsed = TClock::monotonicSecs();
+        if (it.value()->pins > 0) {
+            it.value()->pins--;
+        }
+    }
+}
+
+/*!
+  Closes the connections that have been idle for more than \a idleSecs
+  seconds.
+ */
+void TSqlUserConnectionCache::expire(uint idleSecs)
+{
+    const qint64 now = TClock::monotonicSecs();
+
+    for (int i = 0; i < _shardCount; ++i) {
+        auto &sh = _shards[i];
+        QMutexLocker locker(&sh.mutex);
+
+        for (auto it = sh.lru.begin(); it != sh.lru.end();) {
+            auto cur = it++;
+            if (now - cur->lastUsed > idleSecs && isEvictable(*cur)) {
+                tSystemDebug("Has expired: %s", qPrintable(cur->name));
+                evict(sh, cur);
+                _evictions++;
+            }
+        }
+    }
+}
+
+/*!
+  Closes all the cached connections.
+ */
+void TSqlUserConnectionCache::clear()
+{
+    for (int i = 0; i < _shardCount; ++i) {
+        auto &sh = _shards[i];
+        QMutexLocker locker(&sh.mutex);
+
+        while (!sh.lru.empty()) {
+            evict(sh, sh.lru.begin());
+        }
+    }
+}
+
+
+int TSqlUserConnectionCache::count() const
+{
+    int cnt = 0;
+    for (int i = 0; i < _shardCount; ++i) {
+        QMutexLocker locker(&_shards[i].mutex);
+        cnt += (int)_shards[i].lru.size();
+    }
+    return cnt;
+}
+
+/*!
+  Returns true if the connection of the \a entry is neither pinned nor
+  in use by any thread.
+ */
+bool TSqlUserConnectionCache::isEvictable(const Entry &entry)
+{
+    return entry.pins == 0 && !TSqlDatabase::isInuse(entry.name);
+}
+
+/*!
+  Closes and removes the connection at \a it. The shard lock must be held.
+ */
+void TSqlUserConnectionCache::evict(Shard &shard, std::list<Entry>::iterator it)
+{
+    const QString name = it->name;
+    shard.index.remove(name);
+    shard.lru.erase(it);
+
+    if (TSqlDatabase::contains(name)) {
+        tSystemDebug("Closing db: %s", qPrintable(name));
+        TSqlStatementCache::invalidate(name);
+        QSqlDatabase::database(name, false).close();
+        TSqlDatabase::removeDatabase(name);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <TAtomic>
+#include <TGlobal>
+#include <functional>
+#include <list>
+
+
+class T_CORE_EXPORT TSqlUserConnectionCache {
+public:
+    explicit TSqlUserConnectionCache(int capacity);
+    ~TSqlUserConnectionCache();
+
+    bool checkout(const QString &connectionName, const std::function<bool()> &create);
+    void release(const QString &connectionName);
+    void expire(uint idleSecs);
+    void clear();
+
+    int capacity() const { return _capacity; }
+    int count() const;
+    quint64 hitCount() const { return _hits.load(); }
+    quint64 missCount() const { return _misses.load(); }
+    quint64 evictionCount() const { return _evictions.load(); }
+
+private:
+    struct Entry {
+        QString name;
+        qint64 lastUsed {0};
+        int pins {0};  // checkouts not released yet
+    };
+
+    struct Shard {
+        mutable QMutex mutex;
+        std::list<Entry> lru;  // most recently used first
+        QHash<QString, std::list<Entry>::iterator> index;
+    };
+
+    Shard &shard(const QString &connectionName) const { return _shards[qHash(connectionName) % _shardCount]; }
+    void evict(Shard &shard, std::list<Entry>::iterator it);
+    static bool isEvictable(const Entry &entry);
+
+    int _capacity {0};
+    int _shardCapacity {0};
+    int _shardCount {0};
+    Shard *_shards {nullptr};
+    TAtomic<quint64> _hits {0};
+    TAtomic<quint64> _misses {0};
+    TAtomic<quint64> _evictions {0};
+
+    T_DISABLE_COPY(TSqlUserConnectionCache)
+    T_DISABLE_MOVE(TSqlUserConnectionCache)
+};
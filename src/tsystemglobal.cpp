@@ -7,6 +7,7 @@
 
 #include "tsystemglobal.h"
 #include "taccesslogstream.h"
+#include "tclock.h"
 #include "tfileaiowriter.h"
 #include <QByteArray>
 #include <QDateTime>
@@ -21,6 +22,9 @@
 #include <TLogger>
 #include <TWebApplication>
 
+#undef tSystemDebug
+#undef tSystemTrace
+
 constexpr auto DEFAULT_SYSTEMLOG_LAYOUT = "%d %5P %m%n";
 constexpr auto DEFAULT_SYSTEMLOG_DATETIME_FORMAT = "yyyy-MM-ddThh:mm:ss";
 constexpr auto DEFAULT_ACCESSLOG_LAYOUT = "%h %d \"%r\" %s %O%n";
@@ -39,6 +43,9 @@ QByteArray accessLogDateTimeFormat;
 void tSystemMessage(int priority, const char *msg, va_list ap)
 {
     TLog log(priority, QString().vsprintf(msg, ap).toLocal8Bit());
+    if (syslogDateTimeFormat.contains('z')) {
+        log.timestamp = TClock::currentDateTimeMSecs();
+    }
     QByteArray buf = TLogger::logToByteArray(log, syslogLayout, syslogDateTimeFormat);
     systemLog.write(buf.data(), buf.length());
 }
@@ -101,6 +108,15 @@ bool Tf::isAccessLoggerAvailable()
     return (bool)accesslogstrm;
 }
 
+/*!
+  Returns the current date and time for the access log, with the
+  milliseconds only if its date-time format shows them.
+*/
+QDateTime Tf::accessLogTimestamp()
+{
+    return accessLogDateTimeFormat.contains('z') ? TClock::currentDateTimeMSecs() : TClock::currentDateTime();
+}
+
 
 void Tf::setupQueryLogger()
 {
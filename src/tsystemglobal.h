@@ -1,4 +1,5 @@
 #pragma once
+#include <QDateTime>
 #include <QMap>
 #include <QSettings>
 #include <QVariant>
@@ -13,6 +14,7 @@ T_CORE_EXPORT void releaseSystemLogger();  // internal use
 T_CORE_EXPORT void setupAccessLogger();  // internal use
 T_CORE_EXPORT void releaseAccessLogger();  // internal use
 T_CORE_EXPORT bool isAccessLoggerAvailable();  // internal use
+T_CORE_EXPORT QDateTime accessLogTimestamp();  // internal use
 T_CORE_EXPORT void setupQueryLogger();  // internal use
 T_CORE_EXPORT void releaseQueryLogger();  // internal use
 T_CORE_EXPORT void writeAccessLog(const TAccessLog &log);  // write access log
@@ -29,7 +31,8 @@ enum SystemOpCode {
     WebSocketSendBinary = 0x02,
     WebSocketPublishText = 0x03,
     WebSocketPublishBinary = 0x04,
-    MaxOpCode = 0x04,
+    CacheInvalidate = 0x05,
+    MaxOpCode = 0x05,
 };
 
 T_CORE_EXPORT QMap<QString, QVariant> settingsToMap(QSettings &settings, const QString &env = QString());
@@ -65,3 +68,20 @@ T_CORE_EXPORT void tSystemTrace(const char *, ...)  // system trace message
 #endif
     ;
 
+
+namespace Tf {
+// Least severe priority written to the system log; debug and trace
+// messages are compiled out of release builds.
+#ifdef TF_NO_DEBUG
+constexpr int SystemLogMaxPriority = Tf::InfoLevel;
+#else
+constexpr int SystemLogMaxPriority = Tf::TraceLevel;
+#endif
+}
+
+// The arguments are not evaluated unless the priority is written
+#define tSystemDebug(...) \
+    ((Tf::DebugLevel <= Tf::SystemLogMaxPriority) ? tSystemDebug(__VA_ARGS__) : (void)0)
+
+#define tSystemTrace(...) \
+    ((Tf::TraceLevel <= Tf::SystemLogMaxPriority) ? tSystemTrace(__VA_ARGS__) : (void)0)
@@ -168,6 +168,7 @@ TWebApplication::TWebApplication(int &argc, char **argv) :
                 }
             }
 
+            _cacheSettings = settings;
             if (TCacheFactory::dbType(backend) == TCacheStore::SQL) {
                 _sqlSettings.append(settings);
                 _cacheSqlDbIndex = _sqlSettings.count() - 1;
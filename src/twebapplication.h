@@ -53,6 +53,7 @@ public:
     bool cacheEnabled() const;
     QString cacheBackend() const;
     int databaseIdForCache() const;
+    const QVariantMap &cacheSettings() const { return _cacheSettings; }
     const QVariantMap &loggerSettings() const { return _loggerSetting; }
     const QVariantMap &validationSettings() const { return _validationSetting; }
     QString validationErrorMessage(int rule) const;
@@ -105,6 +106,7 @@ private:
     mutable MultiProcessingModule _mpm {Invalid};
     QMap<QString, QVariantMap> _configMap;
     int _cacheSqlDbIndex {-1};
+    QVariantMap _cacheSettings;
 
     static void resetSignalNumber();
 
@@ -89,6 +89,7 @@ void TWebSocketWorker::execute(int opcode, const QByteArray &payload)
         endpoint->peerAddr = peerInfo.first;
         endpoint->peerPortNumber = peerInfo.second;
         // Database Transaction
+        resetReadRouting();
         for (int databaseId = 0; databaseId < Tf::app()->sqlDatabaseSettingsCount(); ++databaseId) {
             setTransactionEnabled(endpoint->transactionEnabled(), databaseId);
         }
@@ -34,6 +34,15 @@ constexpr auto MONGOOBJECT_HEADER_TEMPLATE = "#ifndef %1OBJECT_H\n"
                                              "    virtual QString objectId() const override { return _id; }\n"
                                              "    virtual QString &objectId() override { return _id; }\n"
                                              "\n"
+                                             "    const TModelField *modelFields() const override\n"
+                                             "    {\n"
+                                             "        static constexpr TModelField fields[] = {\n"
+                                             "%7"
+                                             "            {nullptr, nullptr, nullptr},\n"
+                                             "        };\n"
+                                             "        return fields;\n"
+                                             "    }\n"
+                                             "\n"
                                              "private:\n"
                                              "    Q_OBJECT\n"
                                              "%6"
@@ -52,6 +61,15 @@ constexpr auto MONGOOBJECT_HEADER_UPDATE_TEMPLATE = "%3\n"
                                                     "    virtual QString objectId() const override { return _id; }\n"
                                                     "    virtual QString &objectId() override { return _id; }\n"
                                                     "\n"
+                                                    "    const TModelField *modelFields() const override\n"
+                                                    "    {\n"
+                                                    "        static constexpr TModelField fields[] = {\n"
+                                                    "%7"
+                                                    "            {nullptr, nullptr, nullptr},\n"
+                                                    "        };\n"
+                                                    "        return fields;\n"
+                                                    "    }\n"
+                                                    "\n"
                                                     "private:\n"
                                                     "    Q_OBJECT\n"
                                                     "%6"
@@ -97,20 +115,21 @@ QString MongoObjGenerator::generate(const QString &dstDir)
 }
 
 
-static QStringList generateCode(const QList<QPair<QString, QVariant::Type>> &fieldList)
+static QStringList generateCode(const QString &modelName, const QList<QPair<QString, QVariant::Type>> &fieldList)
 {
-    QString params, enums, macros;
+    QString params, enums, macros, descriptors;
 
     for (QListIterator<QPair<QString, QVariant::Type>> it(fieldList); it.hasNext();) {
         const QPair<QString, QVariant::Type> &p = it.next();
         QString typeName = QVariant::typeToName(p.second);
         params += QString("    %1 %2;\n").arg(typeName, p.first);
         macros += QString(MONGOOBJECT_PROPERTY_TEMPLATE).arg(typeName, p.first);
+        descriptors += QString("            T_MODEL_FIELD(%1Object, %2, %3),\n").arg(modelName, typeName, p.first);
         QString estr = fieldNameToEnumName(p.first);
         enums += (enums.isEmpty()) ? QString("        %1 = 0,\n").arg(estr) : QString("        %1,\n").arg(estr);
     }
 
-    return QStringList() << params << enums << macros;
+    return QStringList() << params << enums << macros << descriptors;
 }
 
 
@@ -121,8 +140,8 @@ bool MongoObjGenerator::createMongoObject(const QString &path)
            << qMakePair(QString("updatedAt"), QVariant::DateTime)
            << qMakePair(QString("lockRevision"), QVariant::Int);
 
-    QStringList code = generateCode(fields);
-    QString output = QString(MONGOOBJECT_HEADER_TEMPLATE).arg(modelName.toUpper(), modelName, code[0], code[1], collectionName, code[2]);
+    QStringList code = generateCode(modelName, fields);
+    QString output = QString(MONGOOBJECT_HEADER_TEMPLATE).arg(modelName.toUpper(), modelName, code[0], code[1], collectionName, code[2], code[3]);
     // Writes to a file
     return FileWriter(path).write(output, false);
 }
@@ -179,8 +198,8 @@ bool MongoObjGenerator::updateMongoObject(const QString &path)
     }
 
     fields = getFieldList(path);
-    QStringList prop = generateCode(fields);
-    QString output = QString(MONGOOBJECT_HEADER_UPDATE_TEMPLATE).arg(modelName.toUpper(), collectionName, headerpart, prop[0], prop[1], prop[2]);
+    QStringList prop = generateCode(modelName, fields);
+    QString output = QString(MONGOOBJECT_HEADER_UPDATE_TEMPLATE).arg(modelName.toUpper(), collectionName, headerpart, prop[0], prop[1], prop[2], prop[3]);
     // Writes to a file
     return FileWriter(path).write(output, true);
 }
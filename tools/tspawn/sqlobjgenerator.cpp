@@ -162,6 +162,19 @@ QString SqlObjGenerator::generate(const QString &dstDir)
     output += tableSch->tableName();
     output += QLatin1String("\"); }\n\n");
 
+    // Field descriptors, used instead of the meta-object
+    output += QLatin1String("    const TModelField *modelFields() const override\n    {\n");
+    output += QLatin1String("        static constexpr TModelField fields[] = {\n");
+    it.toFront();
+    while (it.hasNext()) {
+        const QPair<QString, QString> &p = it.next();
+        output += QString("            T_MODEL_FIELD(%1Object, %2, %3),\n").arg(modelName, p.second, p.first);
+    }
+    output += QLatin1String("            {nullptr, nullptr, nullptr},\n");
+    output += QLatin1String("        };\n");
+    output += QLatin1String("        return fields;\n");
+    output += QLatin1String("    }\n\n");
+
     // Property macros part
     output += QLatin1String("private:    /*** Don't modify below this line ***/\n    Q_OBJECT\n");
     it.toFront();